@@ -12,6 +12,13 @@
 #define SIG_STRING_CHAR ((char)0x01)
 #define SIG_CHAR_CHAR ((char)0x02)
 
+#define MAX_FUNCTION_SLOTS 512
+#define MAX_FUNCTION_LOCALS 255
+#define MAX_CLASS_STATICS 512
+#define MAX_CLASS_POOL 4096
+#define MAX_BLOCK_DEPTH 256
+#define MAX_SWITCH_CASES 4096
+
 enum
 {
 	constant_not_absolute = 0,
@@ -54,6 +61,7 @@ struct data_compile_options_s
 	alignment_t alignment;
 	buffer_t *debugOut;
 	char **classpaths;
+	buffer_t *poolOut;
 };
 
 typedef struct compile_state_s compile_state_t;
@@ -68,6 +76,27 @@ struct compile_state_s
 	int srcline;
 	compile_error_t *back;
 	LSCUCONTEXT lscuctx;
+	unsigned int version;
+	line_t *line;
+
+	// Version 2+: arguments, "this", and locals of the current function in slot order
+	char *slots[MAX_FUNCTION_SLOTS];
+	byte_t slottypes[MAX_FUNCTION_SLOTS];
+	size_t slotcount;
+	int inFunction;
+	size_t bodySizeOffset;
+
+	// The commands opening the if, while and switch blocks which have not been ended yet
+	byte_t blocks[MAX_BLOCK_DEPTH];
+	size_t blockcount;
+
+	// Version 2+: static fields of the class in declaration order
+	char *statics[MAX_CLASS_STATICS];
+	size_t staticcount;
+
+	// Version 3+: the class's constant pool
+	char *pool[MAX_CLASS_POOL];
+	size_t poolcount;
 };
 
 static compile_error_t *compile_file(file_compile_options_t *options);
@@ -100,6 +129,25 @@ static void handle_call_cmd(compile_state_t *state);
 static void handle_math_cmd(compile_state_t *state);
 static void handle_unary_math_cmd(compile_state_t *state);
 static void handle_if_style_cmd(compile_state_t *state);
+static void handle_switch_cmd(compile_state_t *state);
+static void handle_case_cmd(compile_state_t *state);
+
+static void reset_slots(compile_state_t *state);
+static int add_slot(compile_state_t *state, const char *name, byte_t type);
+static int find_slot(compile_state_t *state, const char *name, size_t namelen);
+static void put_operand(compile_state_t *state, buffer_t *out, const char *name);
+static void put_function_locals(compile_state_t *state, byte_t execType);
+static void end_function_body(compile_state_t *state);
+static void find_statics(compile_state_t *state, line_t *first);
+static int find_static(compile_state_t *state, const char *name, size_t namelen);
+static void free_statics(compile_state_t *state);
+static void put_call_name(compile_state_t *state, buffer_t *out, const char *name);
+static void put_pool(compile_state_t *state, buffer_t *out);
+static void free_pool(compile_state_t *state);
+static void open_block(compile_state_t *state);
+static int find_switch_cases(compile_state_t *state, llong *cases, size_t *casecount);
+static int parse_case_value(const char *string, llong *value);
+static int compare_cases(const void *lhs, const void *rhs);
 
 compile_error_t *compile(compiler_options_t *options)
 {
@@ -115,7 +163,7 @@ compile_error_t *compile(compiler_options_t *options)
 	if (options->inFiles)
 	{
 		options->inFiles = options->inFiles->front;
-		if (options->version != 1)
+		if (options->version < LB_VERSION_NAMED || options->version > LB_VERSION_POOL)
 			return add_compile_error(errors, "", 0, error_error, "Unsupported compile standard.");
 
 		while (options->inFiles)
@@ -181,6 +229,7 @@ compile_error_t *compile_file(file_compile_options_t *options)
 
 	buffer_t *obuf = NEW_BUFFER(256);
 	buffer_t *dbuf = options->debug ? NEW_BUFFER(256) : NULL;
+	buffer_t *pbuf = options->version >= LB_VERSION_POOL ? NEW_BUFFER(256) : NULL;
 
 	data_compile_options_t dataCompileOptions = {
 		buf,
@@ -192,7 +241,8 @@ compile_error_t *compile_file(file_compile_options_t *options)
 		options->debug,
 		options->alignment,
 		dbuf,
-		options->classpaths
+		options->classpaths,
+		pbuf
 	};
 
 
@@ -253,6 +303,15 @@ compile_error_t *compile_file(file_compile_options_t *options)
 	fwrite(&options->version, sizeof(unsigned int), 1, out);
 	fwrite(obuf->buf, sizeof(char), (size_t)(obuf->cursor - obuf->buf), out);
 
+	if (pbuf)
+	{
+		// The pool's offset is written last so the loader can find it from the end of the class
+		dword_t poolOffset = (dword_t)(sizeof(char) + sizeof(unsigned int) + (size_t)(obuf->cursor - obuf->buf));
+		fwrite(pbuf->buf, sizeof(char), (size_t)(pbuf->cursor - pbuf->buf), out);
+		fwrite(&poolOffset, sizeof(dword_t), 1, out);
+		FREE_BUFFER(pbuf);
+	}
+
 	fclose(out);
 	FREE_BUFFER(obuf);
 
@@ -304,8 +363,15 @@ compile_error_t *compile_data(data_compile_options_t *options)
 	cs.out = options->out;
 	cs.srcfile = options->srcFile;
 	cs.package[0] = 0;
+	cs.version = options->version;
+	cs.slotcount = 0;
+	cs.inFunction = 0;
+	cs.blockcount = 0;
+	cs.staticcount = 0;
+	cs.poolcount = 0;
 
 	formatted = format_document(options->data, options->datalen);
+	find_statics(&cs, formatted);
 
 	cs.lscuctx = lscu_init();
 
@@ -336,6 +402,7 @@ compile_error_t *compile_data(data_compile_options_t *options)
 		if (*line != '#')
 		{
 			cs.srcline = curr->linenum;
+			cs.line = curr;
 
 			if (options->debug)
 			{
@@ -378,16 +445,19 @@ compile_error_t *compile_data(data_compile_options_t *options)
 				break;
 
 			case lb_global:
+				end_function_body(&cs);
 				alignAmount = options->alignment.globalAlignment - ((size_t)(cs.out->cursor - cs.out->buf) % (size_t)options->alignment.globalAlignment);
 				cs.out = PUT_BYTES(cs.out, lb_align, alignAmount);
 				handle_field_def(&cs);
 				break;
 			case lb_function:
+				end_function_body(&cs);
 				alignAmount = options->alignment.functionAlignment - ((size_t)(cs.out->cursor - cs.out->buf) % (size_t)options->alignment.functionAlignment);
 				cs.out = PUT_BYTES(cs.out, lb_align, alignAmount);
 				handle_function_def(&cs);
 				break;
 			case lb_constructor:
+				end_function_body(&cs);
 				alignAmount = options->alignment.functionAlignment - ((size_t)(cs.out->cursor - cs.out->buf) % (size_t)options->alignment.functionAlignment);
 				cs.out = PUT_BYTES(cs.out, lb_align, alignAmount);
 				handle_constructor_def(&cs);
@@ -421,7 +491,7 @@ compile_error_t *compile_data(data_compile_options_t *options)
 				if (cs.tokencount == 2)
 				{
 					cs.out = PUT_BYTE(cs.out, cs.cmd);
-					cs.out = PUT_STRING(cs.out, cs.tokens[1]);
+					put_operand(&cs, cs.out, cs.tokens[1]);
 				}
 				else if (cs.tokencount == 1)
 					cs.back = add_compile_error(cs.back, cs.srcfile, cs.srcline, error_error, "Missing variable name declaration");
@@ -435,7 +505,7 @@ compile_error_t *compile_data(data_compile_options_t *options)
 					if (lscu_resolve_class(cs.lscuctx, cs.tokens[1], NULL, 0))
 					{
 						cs.out = PUT_BYTE(cs.out, cs.cmd);
-						cs.out = PUT_STRING(cs.out, cs.tokens[2]);
+						put_operand(&cs, cs.out, cs.tokens[2]);
 					}
 					else
 						cs.back = add_compile_error(cs.back, cs.srcfile, cs.srcline, error_error, "Unresolved symbol \"%s\"", cs.tokens[1]);
@@ -516,8 +586,17 @@ compile_error_t *compile_data(data_compile_options_t *options)
 
 			case lb_if:
 			case lb_while:
+				open_block(&cs);
 				handle_if_style_cmd(&cs);
 				break;
+			case lb_switch:
+				open_block(&cs);
+				handle_switch_cmd(&cs);
+				break;
+			case lb_case:
+			case lb_default:
+				handle_case_cmd(&cs);
+				break;
 			case lb_else:
 				//out = put_byte(out, tokenCount > 1);
 				if (cs.tokencount > 1)
@@ -542,11 +621,13 @@ compile_error_t *compile_data(data_compile_options_t *options)
 				}
 				else
 				{
-					options->out = PUT_BYTE(options->out, lb_else);
-					options->out = PUT_LONG(options->out, -1);
+					cs.out = PUT_BYTE(cs.out, lb_else);
+					cs.out = PUT_LONG(cs.out, -1);
 				}
 				break;
 			case lb_end:
+				if (cs.blockcount)
+					cs.blockcount--;
 				cs.out = PUT_BYTE(cs.out, cs.cmd);
 				cs.out = PUT_LONG(cs.out, -1);
 				break;
@@ -561,6 +642,14 @@ compile_error_t *compile_data(data_compile_options_t *options)
 		curr = curr->next;
 	}
 
+	end_function_body(&cs);
+	reset_slots(&cs);
+	free_statics(&cs);
+
+	if (options->poolOut)
+		put_pool(&cs, options->poolOut);
+	free_pool(&cs);
+
 	free_formatted(formatted);
 
 	lscu_destroy(cs.lscuctx);
@@ -851,6 +940,12 @@ byte_t get_command_byte(const char *string)
 		return lb_while;
 	else if (!strcmp(string, "end"))
 		return lb_end;
+	else if (!strcmp(string, "switch"))
+		return lb_switch;
+	else if (!strcmp(string, "case"))
+		return lb_case;
+	else if (!strcmp(string, "default"))
+		return lb_default;
 
 	else if (!strcmp(string, "castc"))
 		return lb_castc;
@@ -1965,6 +2060,8 @@ void handle_function_def(compile_state_t *state)
 
 	buffer_t *build = NEW_BUFFER(64);
 
+	reset_slots(state);
+
 	byte_t argType;
 	char classname[MAX_PATH] = { 0 };
 	int writeClassname;
@@ -2019,6 +2116,7 @@ void handle_function_def(compile_state_t *state)
 		PUT_BYTE(build, argType);
 		if (writeClassname) PUT_STRING(build, classname);
 		PUT_STRING(build, argumentName);
+		add_slot(state, argumentName, argType);
 
 		// Require ',' separating arguments (exclude last argument)
 		if (i < state->tokencount - 2)
@@ -2041,6 +2139,10 @@ void handle_function_def(compile_state_t *state)
 	PUT_BYTE(state->out, argCount);
 	PUT_BUF(state->out, build);
 
+	if (!isStatic)
+		add_slot(state, "this", lb_object);
+	put_function_locals(state, execType);
+
 	FREE_BUFFER(build);
 }
 
@@ -2068,6 +2170,8 @@ void handle_constructor_def(compile_state_t *state)
 		return;
 	}
 
+	reset_slots(state);
+
 	byte_t argCount = 0;
 	for (size_t i = 2;; i++, argCount++)
 	{
@@ -2122,6 +2226,7 @@ void handle_constructor_def(compile_state_t *state)
 			PUT_BYTE(build, type);
 			PUT_STRING(build, fullname);
 			PUT_STRING(build, argName);
+			add_slot(state, argName, type);
 		}
 		else if (i == state->tokencount)
 		{
@@ -2135,6 +2240,7 @@ void handle_constructor_def(compile_state_t *state)
 
 			PUT_BYTE(build, type);
 			PUT_STRING(build, argName);
+			add_slot(state, argName, type);
 		}
 
 		// Require ',' separating arguments (exclude last argument)
@@ -2160,6 +2266,9 @@ void handle_constructor_def(compile_state_t *state)
 	PUT_BYTE(state->out, argCount);
 	PUT_BUF(state->out, build);
 
+	add_slot(state, "this", lb_object);
+	put_function_locals(state, lb_interp);
+
 	FREE_BUFFER(build);
 }
 
@@ -2189,9 +2298,9 @@ void handle_set_cmd(compile_state_t *state)
 	{
 	case lb_setv:
 		PUT_BYTE(state->out, lb_setv);
-		PUT_STRING(state->out, varname);
+		put_operand(state, state->out, varname);
 		//put_byte(out, lb_value);
-		PUT_STRING(state->out, state->tokens[2]);
+		put_operand(state, state->out, state->tokens[2]);
 		break;
 	case lb_seto:
 		if (!strcmp(state->tokens[2], "new"))
@@ -2228,7 +2337,7 @@ void handle_set_cmd(compile_state_t *state)
 			if (!strcmp(state->tokens[5], ")"))
 			{
 				PUT_BYTE(state->out, lb_seto);
-				PUT_STRING(state->out, varname);
+				put_operand(state, state->out, varname);
 				PUT_BYTE(state->out, lb_new);
 				PUT_STRING(state->out, fullname);
 
@@ -2363,7 +2472,7 @@ void handle_set_cmd(compile_state_t *state)
 						else
 						{
 							PUT_BYTE(argBuffer, lb_value);
-							PUT_STRING(argBuffer, state->tokens[i]);
+							put_operand(state, argBuffer, state->tokens[i]);
 						}
 					}
 					continue;
@@ -2420,7 +2529,7 @@ void handle_set_cmd(compile_state_t *state)
 			}
 
 			PUT_BYTE(state->out, lb_seto);
-			PUT_STRING(state->out, varname);
+			put_operand(state, state->out, varname);
 			PUT_BYTE(state->out, lb_new);
 			PUT_STRING(state->out, fullname);
 			PUT_STRING(state->out, qualifiedfuncname);
@@ -2431,19 +2540,19 @@ void handle_set_cmd(compile_state_t *state)
 		else if (!strcmp(state->tokens[2], "null"))
 		{
 			PUT_BYTE(state->out, lb_seto);
-			PUT_STRING(state->out, varname);
+			put_operand(state, state->out, varname);
 			PUT_BYTE(state->out, lb_null);
 		}
 		else if (get_primitive_type(state->tokens[2]))
 		{
 			PUT_BYTE(state->out, lb_seto);
-			PUT_STRING(state->out, varname);
+			put_operand(state, state->out, varname);
 			handle_array_creation(state);
 		}
 		else if (state->tokens[2][0] == SIG_STRING_CHAR)
 		{
 			PUT_BYTE(state->out, lb_seto);
-			PUT_STRING(state->out, varname);
+			put_operand(state, state->out, varname);
 			PUT_BYTE(state->out, lb_string);
 			PUT_STRING(state->out, state->tokens[2] + 1);
 		}
@@ -2456,7 +2565,7 @@ void handle_set_cmd(compile_state_t *state)
 		break;
 	case lb_setr:
 		PUT_BYTE(state->out, lb_setr);
-		PUT_STRING(state->out, varname);
+		put_operand(state, state->out, varname);
 		break;
 	default:
 		myType = state->cmd + (lb_byte - lb_setb);
@@ -2483,7 +2592,7 @@ void handle_set_cmd(compile_state_t *state)
 			state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_warning, "Value types do not match");
 
 		PUT_BYTE(state->out, state->cmd);
-		PUT_STRING(state->out, varname);
+		put_operand(state, state->out, varname);
 		//put_byte(out, myType);
 
 		switch (myType)
@@ -2538,8 +2647,8 @@ void handle_cast_cmd(compile_state_t *state)
 	}
 
 	PUT_CHAR(state->out, state->cmd);
-	PUT_STRING(state->out, state->tokens[1]);
-	PUT_STRING(state->out, state->tokens[2]);
+	put_operand(state, state->out, state->tokens[1]);
+	put_operand(state, state->out, state->tokens[2]);
 }
 
 void handle_array_creation(compile_state_t *state)
@@ -2567,7 +2676,7 @@ void handle_array_creation(compile_state_t *state)
 	if (argSize == 0)
 	{
 		PUT_BYTE(state->out, lb_value);
-		PUT_STRING(state->out, state->tokens[3]);
+		put_operand(state, state->out, state->tokens[3]);
 	}
 	else
 	{
@@ -2614,6 +2723,15 @@ void handle_ret_cmd(compile_state_t *state)
 		if (state->tokencount > 1)
 			state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_warning, "Unecessary arguments following function return");
 		break;
+	case lb_reto:
+		// An object return is either the null constant or a variable holding the object
+		if (state->tokencount >= 2 && !strcmp(state->tokens[1], "null"))
+		{
+			state->cmd = lb_retq;
+			valueRetDesSize = sizeof(qword_t);
+			valueRetDesType = lb_ulong;
+			goto handleValueRet;
+		}
 	case lb_retv:
 		if (state->tokencount < 2)
 		{
@@ -2622,7 +2740,7 @@ void handle_ret_cmd(compile_state_t *state)
 		}
 
 		PUT_BYTE(state->out, lb_retv);
-		PUT_STRING(state->out, state->tokens[1]);
+		put_operand(state, state->out, state->tokens[1]);
 
 		if (state->tokencount > 2)
 			state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_warning, "Unecessary arguments following function return");
@@ -2743,6 +2861,7 @@ void handle_call_cmd(compile_state_t *state)
 	char *functionName = state->tokens[1];
 	char unqualbuf[MAX_PATH];
 	char temp[MAX_PATH];
+	char receiver[MAX_PATH] = { 0 };
 
 	// If the first part of the function call is a class, replace with qualified name
 	char *dot = strchr(functionName, '.');
@@ -2770,15 +2889,32 @@ void handle_call_cmd(compile_state_t *state)
 	if (!strcmp(functionName, "<init>"))
 		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_warning, "Calling constructor as function");
 
+	if (state->cmd == lb_dynamic_call && state->version >= LB_VERSION_SLOTS)
+	{
+		// The object is written as its own operand, followed by the unqualified function name. A
+		// call without an object is made on this, as earlier versions resolved it.
+		dot = strrchr(functionName, '.');
+		if (dot)
+		{
+			*dot = 0;
+			strcpy_s(receiver, sizeof(receiver), functionName);
+			functionName = dot + 1;
+		}
+		else
+			strcpy_s(receiver, sizeof(receiver), "this");
+	}
+
 	if (!strcmp(state->tokens[3], ")"))
 	{
 		PUT_BYTE(state->out, state->cmd);
+		if (receiver[0])
+			put_operand(state, state->out, receiver);
 
 		char towrite[MAX_PATH];
 		strcpy_s(towrite, sizeof(towrite), functionName);
 		strcat_s(towrite, sizeof(towrite), "(");
 
-		PUT_STRING(state->out, towrite);
+		put_call_name(state, state->out, towrite);
 		return;
 	}
 
@@ -2901,7 +3037,7 @@ void handle_call_cmd(compile_state_t *state)
 				else
 				{
 					PUT_BYTE(argBuffer, lb_value);
-					PUT_STRING(argBuffer, state->tokens[i]);
+					put_operand(state, argBuffer, state->tokens[i]);
 				}
 			}
 			continue;
@@ -2958,7 +3094,9 @@ void handle_call_cmd(compile_state_t *state)
 	}
 
 	PUT_BYTE(state->out, state->cmd);
-	PUT_STRING(state->out, qualifiedfuncname);
+	if (receiver[0])
+		put_operand(state, state->out, receiver);
+	put_call_name(state, state->out, qualifiedfuncname);
 	PUT_BUF(state->out, argBuffer);
 
 	//qualifiedfuncname[length - 1] = ')';
@@ -3017,14 +3155,14 @@ void handle_math_cmd(compile_state_t *state)
 	}
 
 	PUT_BYTE(state->out, state->cmd);
-	PUT_STRING(state->out, dstVar);
-	PUT_STRING(state->out, srcVar);
+	put_operand(state, state->out, dstVar);
+	put_operand(state, state->out, srcVar);
 
 	if (argSize == 0)
 	{
 		const char *srcVar2 = state->tokens[3];
 		PUT_BYTE(state->out, lb_value);
-		PUT_STRING(state->out, srcVar2);
+		put_operand(state, state->out, srcVar2);
 	}
 	else
 	{
@@ -3090,8 +3228,8 @@ void handle_unary_math_cmd(compile_state_t *state)
 	const char *srcVar = state->tokens[2];
 
 	PUT_BYTE(state->out, state->cmd);
-	PUT_STRING(state->out, dstVar);
-	PUT_STRING(state->out, srcVar);
+	put_operand(state, state->out, dstVar);
+	put_operand(state, state->out, srcVar);
 
 	if (state->tokencount > 3)
 	{
@@ -3119,7 +3257,7 @@ void handle_if_style_cmd(compile_state_t *state)
 	if (lhsSize == 0 && !lhsIsAbsolute)
 	{
 		PUT_BYTE(temp, lb_value);
-		PUT_STRING(temp, state->tokens[1]);
+		put_operand(state, temp, state->tokens[1]);
 	}
 	else if (!lhsIsAbsolute)
 	{
@@ -3174,7 +3312,7 @@ void handle_if_style_cmd(compile_state_t *state)
 		if (rhsSize == 0 && !rhsIsAbsolute)
 		{
 			PUT_BYTE(temp, lb_value);
-			PUT_STRING(temp, state->tokens[3]);
+			put_operand(state, temp, state->tokens[3]);
 		}
 		else if (!rhsIsAbsolute)
 		{
@@ -3209,3 +3347,503 @@ void handle_if_style_cmd(compile_state_t *state)
 	PUT_LONG(state->out, -1);
 	FREE_BUFFER(temp);
 }
+
+void handle_switch_cmd(compile_state_t *state)
+{
+	llong *cases;
+	size_t casecount;
+	lulong range;
+	data_t data;
+	byte_t type;
+	int isAbsolute;
+	size_t i;
+
+	if (state->tokencount < 2)
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Expected variable name");
+		return;
+	}
+	else if (state->tokencount > 2)
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_warning, "Unecessary arguments following switch value");
+
+	if (evaluate_constant(state->tokens[1], &data, &type, &isAbsolute) || isAbsolute)
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "switch requires a variable");
+		return;
+	}
+
+	cases = (llong *)MALLOC(MAX_SWITCH_CASES * sizeof(llong));
+	if (!cases)
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Allocation failure.");
+		return;
+	}
+
+	// The table is written before the cases are compiled, so they are collected up front
+	if (!find_switch_cases(state, cases, &casecount))
+	{
+		FREE(cases);
+		return;
+	}
+
+	qsort(cases, casecount, sizeof(llong), &compare_cases);
+	for (i = 1; i < casecount; i++)
+	{
+		if (cases[i] == cases[i - 1])
+		{
+			state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Duplicate case %lld", cases[i]);
+			FREE(cases);
+			return;
+		}
+	}
+
+	PUT_BYTE(state->out, lb_switch);
+	put_operand(state, state->out, state->tokens[1]);
+
+	// A dense table is indexed directly, so it is used while at least half of its entries are cases
+	range = casecount ? (lulong)cases[casecount - 1] - (lulong)cases[0] + 1 : 0;
+	if (range && range <= 2 * (lulong)casecount)
+	{
+		PUT_BYTE(state->out, lb_dense);
+		PUT_LONG(state->out, cases[0]);
+		PUT_UINT(state->out, (dword_t)range);
+		PUT_LONG(state->out, -1); // Default target
+		for (lulong j = 0; j < range; j++)
+			PUT_LONG(state->out, -1);
+	}
+	else
+	{
+		PUT_BYTE(state->out, lb_sparse);
+		PUT_UINT(state->out, (dword_t)casecount);
+		PUT_LONG(state->out, -1); // Default target
+		for (i = 0; i < casecount; i++)
+		{
+			PUT_LONG(state->out, cases[i]);
+			PUT_LONG(state->out, -1);
+		}
+	}
+
+	FREE(cases);
+}
+
+void handle_case_cmd(compile_state_t *state)
+{
+	llong value;
+
+	if (!state->blockcount || state->blocks[state->blockcount - 1] != lb_switch)
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "%s outside of a switch", state->tokens[0]);
+		return;
+	}
+
+	if (state->cmd == lb_default)
+	{
+		if (state->tokencount > 1)
+			state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_warning, "Unecessary arguments following default");
+		PUT_BYTE(state->out, lb_default);
+		PUT_LONG(state->out, -1);
+		return;
+	}
+
+	if (state->tokencount < 2)
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Expected case value");
+		return;
+	}
+	else if (state->tokencount > 2)
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_warning, "Unecessary arguments following case value");
+
+	if (!parse_case_value(state->tokens[1], &value))
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Case value \"%s\" is not an integer", state->tokens[1]);
+		return;
+	}
+
+	PUT_BYTE(state->out, lb_case);
+	PUT_LONG(state->out, -1);
+	PUT_LONG(state->out, value);
+}
+
+void reset_slots(compile_state_t *state)
+{
+	for (size_t i = 0; i < state->slotcount; i++)
+		FREE(state->slots[i]);
+	state->slotcount = 0;
+}
+
+int add_slot(compile_state_t *state, const char *name, byte_t type)
+{
+	if (state->slotcount == MAX_FUNCTION_SLOTS)
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Too many variables in function");
+		return -1;
+	}
+
+	size_t size = strlen(name) + 1;
+	char *copy = (char *)MALLOC(size);
+	if (!copy)
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Allocation failure.");
+		return -1;
+	}
+	MEMCPY(copy, name, size);
+
+	state->slots[state->slotcount] = copy;
+	state->slottypes[state->slotcount] = type;
+	return (int)state->slotcount++;
+}
+
+int find_slot(compile_state_t *state, const char *name, size_t namelen)
+{
+	for (size_t i = 0; i < state->slotcount; i++)
+	{
+		if (!strncmp(state->slots[i], name, namelen) && !state->slots[i][namelen])
+			return (int)i;
+	}
+	return -1;
+}
+
+void put_operand(compile_state_t *state, buffer_t *out, const char *name)
+{
+	if (state->version >= LB_VERSION_SLOTS && state->inFunction)
+	{
+		// Array elements are split into the array and its index so neither is parsed at runtime
+		const char *bracket = strchr(name, '[');
+		size_t namelen = strlen(name);
+		if (bracket && bracket != name && name[namelen - 1] == ']' && !strchr(bracket + 1, '['))
+		{
+			char arrayName[MAX_PATH];
+			char index[MAX_PATH];
+			size_t arraylen = bracket - name;
+			size_t indexlen = namelen - arraylen - 2;
+			if (arraylen < sizeof(arrayName) && indexlen > 0 && indexlen < sizeof(index))
+			{
+				MEMCPY(arrayName, name, arraylen);
+				arrayName[arraylen] = 0;
+				MEMCPY(index, bracket + 1, indexlen);
+				index[indexlen] = 0;
+
+				PUT_BYTE(out, lb_element);
+				put_operand(state, out, arrayName);
+				if (strspn(index, "0123456789") == indexlen)
+				{
+					PUT_BYTE(out, lb_index);
+					PUT_UINT(out, (dword_t)strtoul(index, NULL, 10));
+				}
+				else
+					put_operand(state, out, index);
+				return;
+			}
+		}
+
+		// Only the leading variable is bound to a slot, fields and indices are still resolved by name
+		size_t headlen = strcspn(name, ".[");
+		int slot = find_slot(state, name, headlen);
+		if (slot != -1)
+		{
+			PUT_BYTE(out, lb_slot);
+			PUT_USHORT(out, slot);
+			PUT_STRING(out, name + headlen);
+			return;
+		}
+
+		// Locals shadow statics of the same name
+		slot = find_static(state, name, headlen);
+		if (slot != -1)
+		{
+			PUT_BYTE(out, lb_static_slot);
+			PUT_USHORT(out, slot);
+			PUT_STRING(out, name + headlen);
+			return;
+		}
+	}
+
+	PUT_STRING(out, name);
+}
+
+void put_function_locals(compile_state_t *state, byte_t execType)
+{
+	if (state->version < LB_VERSION_SLOTS)
+		return;
+
+	size_t firstLocal = state->slotcount;
+	line_t *curr;
+	char **tokens;
+	size_t tokencount;
+	byte_t type;
+	const char *name;
+	int slot;
+
+	// Locals may be declared anywhere in the body, so find them all before the body is compiled
+	for (curr = execType == lb_interp ? state->line->next : NULL; curr; curr = curr->next)
+	{
+		if (*curr->line == '#')
+			continue;
+
+		tokens = tokenize_string(curr->line, &tokencount);
+		type = get_command_byte(tokens[0]);
+
+		if (type == lb_function || type == lb_constructor || type == lb_global || type == lb_class)
+		{
+			free_tokenized_data(tokens, tokencount);
+			break;
+		}
+
+		name = NULL;
+		if (type == lb_object || type == lb_objectarray)
+			name = tokencount == 3 ? tokens[2] : NULL;
+		else if (type >= lb_char && type <= lb_doublearray)
+			name = tokencount == 2 ? tokens[1] : NULL;
+
+		if (name)
+		{
+			slot = find_slot(state, name, strlen(name));
+			if (slot == -1)
+			{
+				if (state->slotcount - firstLocal == MAX_FUNCTION_LOCALS)
+					state->back = add_compile_error(state->back, state->srcfile, curr->linenum, error_error, "Too many local variables in function");
+				else
+					add_slot(state, name, type);
+			}
+			else if ((size_t)slot < firstLocal)
+				state->back = add_compile_error(state->back, state->srcfile, curr->linenum, error_error, "Redeclaration of \"%s\"", name);
+			else if (state->slottypes[slot] != type)
+				state->back = add_compile_error(state->back, state->srcfile, curr->linenum, error_error, "Conflicting declarations of \"%s\"", name);
+		}
+
+		free_tokenized_data(tokens, tokencount);
+	}
+
+	PUT_BYTE(state->out, state->slotcount - firstLocal);
+	for (size_t i = firstLocal; i < state->slotcount; i++)
+	{
+		PUT_BYTE(state->out, state->slottypes[i]);
+		PUT_STRING(state->out, state->slots[i]);
+	}
+
+	// Placeholder for the body size, written once the end of the function is reached
+	state->bodySizeOffset = (size_t)(state->out->cursor - state->out->buf);
+	PUT_UINT(state->out, 0);
+	state->inFunction = 1;
+}
+
+void end_function_body(compile_state_t *state)
+{
+	if (!state->inFunction)
+		return;
+
+	size_t bodyStart = state->bodySizeOffset + sizeof(dword_t);
+	dword_t bodySize = (dword_t)((size_t)(state->out->cursor - state->out->buf) - bodyStart);
+	MEMCPY(state->out->buf + state->bodySizeOffset, &bodySize, sizeof(dword_t));
+
+	state->inFunction = 0;
+	state->blockcount = 0;
+}
+
+void find_statics(compile_state_t *state, line_t *first)
+{
+	line_t *curr;
+	char **tokens;
+	size_t tokencount;
+	size_t size;
+
+	if (state->version < LB_VERSION_SLOTS)
+		return;
+
+	// Statics may be declared after the functions using them, so find them all up front
+	for (curr = first; curr; curr = curr->next)
+	{
+		if (*curr->line == '#')
+			continue;
+
+		tokens = tokenize_string(curr->line, &tokencount);
+
+		// Every static the compiler emits is counted, so indices match the class loader's
+		if (tokencount >= 6 && get_command_byte(tokens[0]) == lb_global && !strcmp(tokens[1], "static"))
+		{
+			size = strlen(tokens[4]) + 1;
+			if (state->staticcount == MAX_CLASS_STATICS)
+				state->back = add_compile_error(state->back, state->srcfile, curr->linenum, error_error, "Too many static fields in class");
+			else if (!(state->statics[state->staticcount] = (char *)MALLOC(size)))
+				state->back = add_compile_error(state->back, state->srcfile, curr->linenum, error_error, "Allocation failure.");
+			else
+			{
+				MEMCPY(state->statics[state->staticcount], tokens[4], size);
+				state->staticcount++;
+			}
+		}
+
+		free_tokenized_data(tokens, tokencount);
+	}
+}
+
+int find_static(compile_state_t *state, const char *name, size_t namelen)
+{
+	for (size_t i = 0; i < state->staticcount; i++)
+	{
+		if (!strncmp(state->statics[i], name, namelen) && !state->statics[i][namelen])
+			return (int)i;
+	}
+	return -1;
+}
+
+void free_statics(compile_state_t *state)
+{
+	for (size_t i = 0; i < state->staticcount; i++)
+		FREE(state->statics[i]);
+	state->staticcount = 0;
+}
+
+void put_call_name(compile_state_t *state, buffer_t *out, const char *name)
+{
+	size_t i;
+	size_t size;
+
+	if (state->version < LB_VERSION_POOL)
+	{
+		PUT_STRING(out, name);
+		return;
+	}
+
+	// Every call to the same function shares one pool entry
+	for (i = 0; i < state->poolcount; i++)
+	{
+		if (!strcmp(state->pool[i], name))
+			break;
+	}
+
+	if (i == state->poolcount)
+	{
+		size = strlen(name) + 1;
+		if (state->poolcount == MAX_CLASS_POOL)
+		{
+			state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Too many constant pool entries in class");
+			return;
+		}
+		if (!(state->pool[i] = (char *)MALLOC(size)))
+		{
+			state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Allocation failure.");
+			return;
+		}
+		MEMCPY(state->pool[i], name, size);
+		state->poolcount++;
+	}
+
+	PUT_USHORT(out, (unsigned short)i);
+}
+
+void put_pool(compile_state_t *state, buffer_t *out)
+{
+	PUT_UINT(out, (unsigned int)state->poolcount);
+	for (size_t i = 0; i < state->poolcount; i++)
+		PUT_STRING(out, state->pool[i]);
+}
+
+void free_pool(compile_state_t *state)
+{
+	for (size_t i = 0; i < state->poolcount; i++)
+		FREE(state->pool[i]);
+	state->poolcount = 0;
+}
+
+void open_block(compile_state_t *state)
+{
+	if (state->blockcount == MAX_BLOCK_DEPTH)
+	{
+		state->back = add_compile_error(state->back, state->srcfile, state->srcline, error_error, "Blocks nested too deeply");
+		return;
+	}
+	state->blocks[state->blockcount] = state->cmd;
+	state->blockcount++;
+}
+
+int find_switch_cases(compile_state_t *state, llong *cases, size_t *casecount)
+{
+	line_t *curr;
+	char **tokens;
+	size_t tokencount;
+	size_t depth = 0;
+	int first = 1;
+	int result = 1;
+	byte_t cmd;
+	llong value;
+
+	*casecount = 0;
+	for (curr = state->line->next; curr; curr = curr->next)
+	{
+		if (*curr->line == '#')
+			continue;
+
+		tokens = tokenize_string(curr->line, &tokencount);
+		cmd = get_command_byte(tokens[0]);
+
+		// Nothing would ever jump to commands before the first label
+		if (first && cmd != lb_case && cmd != lb_default && cmd != lb_end)
+		{
+			state->back = add_compile_error(state->back, state->srcfile, curr->linenum, error_error, "Expected case or default after switch");
+			result = 0;
+		}
+		first = 0;
+
+		switch (cmd)
+		{
+		case lb_if:
+		case lb_while:
+		case lb_switch:
+			depth++;
+			break;
+		case lb_end:
+			if (depth == 0)
+			{
+				free_tokenized_data(tokens, tokencount);
+				return result;
+			}
+			depth--;
+			break;
+		case lb_case:
+			// Malformed values are reported when their own line is compiled
+			if (depth == 0 && tokencount > 1 && parse_case_value(tokens[1], &value))
+			{
+				if (*casecount == MAX_SWITCH_CASES)
+				{
+					state->back = add_compile_error(state->back, state->srcfile, curr->linenum, error_error, "Too many cases in switch");
+					result = 0;
+				}
+				else
+				{
+					cases[*casecount] = value;
+					(*casecount)++;
+				}
+			}
+			break;
+		case lb_class:
+		case lb_global:
+		case lb_function:
+		case lb_constructor:
+			// The switch is never ended, which the linker reports
+			free_tokenized_data(tokens, tokencount);
+			return result;
+		}
+
+		free_tokenized_data(tokens, tokencount);
+	}
+
+	return result;
+}
+
+int parse_case_value(const char *string, llong *value)
+{
+	char *end;
+
+	if (!*string)
+		return 0;
+	*value = strtoll(string, &end, 0);
+	return *end == 0;
+}
+
+int compare_cases(const void *lhs, const void *rhs)
+{
+	llong a = *((const llong *)lhs);
+	llong b = *((const llong *)rhs);
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
@@ -10,16 +10,24 @@ enum
 	search_end = 0x1,		// We want to search for an end command
 	search_else = 0x2,		// We want to search for an else or elif command
 	search_no_link = 0x4,	// Don't link anything
-	search_no_level = 0x8	// Not used
+	search_no_level = 0x8,	// Not used
+	search_inside = 0x10	// The search starts inside the block, after its else
 };
 
 static compile_error_t *link_file(const char *file, compile_error_t *back, unsigned int linkVersion);
 static compile_error_t *link_data(byte_t *data, size_t datalen, const char *srcFile, compile_error_t *back, unsigned int linkVersion);
 
-static byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, compile_error_t **backPtr);
-static byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, const char *srcFile, compile_error_t **backPtr);
-static byte_t *link_while_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, const char *srcFile, compile_error_t **backPtr);
+static byte_t *seek_to_next_control(byte_t *off, byte_t *end, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr);
+static byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr);
+static byte_t *link_while_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr);
 static byte_t *seek_past_if_style_cmd(byte_t *start, size_t **linkStart, const char *srcFile, compile_error_t **backPtr);
+static byte_t *link_switch_cmd(byte_t *start, byte_t *off, byte_t *end, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr);
+static byte_t *seek_to_switch_label(byte_t *off, byte_t *end, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr);
+static byte_t *seek_past_switch_cmd(byte_t *start);
+
+static char **read_pool(byte_t *data, byte_t **endPtr, const char *srcFile, compile_error_t **backPtr);
+
+static byte_t *skip_value(byte_t *off);
 
 static unsigned char infer_argument_count(const char *qualname);
 
@@ -28,7 +36,7 @@ compile_error_t *link(input_file_t *files, unsigned int linkVersion, msg_func_t
 	compile_error_t *errors = create_base_compile_error(messenger);
 	compile_error_t *back = errors;
 
-	if (linkVersion != 1)
+	if (linkVersion < LB_VERSION_NAMED || linkVersion > LB_VERSION_POOL)
 		return add_compile_error(errors, "", 0, error_error, "Unsupported link standard.");
 
 	while (files)
@@ -101,14 +109,26 @@ compile_error_t *link_data(byte_t *data, size_t len, const char *srcFile, compil
 {
 	byte_t *counter = data;
 	byte_t *end = data + len;
+	char **pool = NULL;
 	//size_t *linkLoc;
 	//byte_t *controlEnd;
 
+	if (*((unsigned int *)(data + 1)) != linkVersion)
+		return add_compile_error(back, srcFile, 0, error_error, "Bytecode version does not match link standard");
+
 	counter += 5; // (unused) compressed bit and version number
 
 	if (*counter != lb_class)
 		return add_compile_error(back, srcFile, 0, error_error, "Bad file for link");
 
+	if (linkVersion >= LB_VERSION_POOL)
+	{
+		// The pool is not code, so linking stops where it begins
+		pool = read_pool(data, &end, srcFile, &back);
+		if (!pool)
+			return back;
+	}
+
 	counter++; // class
 	counter += strlen(counter) + 1; // classname;
 	if (*counter == lb_extends)
@@ -119,7 +139,7 @@ compile_error_t *link_data(byte_t *data, size_t len, const char *srcFile, compil
 
 	while (1)
 	{
-		counter = seek_to_next_control(counter, end, srcFile, &back);
+		counter = seek_to_next_control(counter, end, linkVersion, pool, srcFile, &back);
 		if (counter >= end)
 			break;
 		switch (*counter)
@@ -130,16 +150,16 @@ compile_error_t *link_data(byte_t *data, size_t len, const char *srcFile, compil
 			if (*counter != lb_if)
 				break;
 		case lb_if:
-			counter = link_if_cmd(data, counter, end, search_end | search_else, srcFile, &back);
+			counter = link_if_cmd(data, counter, end, search_end | search_else, linkVersion, pool, srcFile, &back);
 			break;
 		case lb_while:
-			counter = link_while_cmd(data, counter, end, search_end, srcFile, &back);
+			counter = link_while_cmd(data, counter, end, search_end, linkVersion, pool, srcFile, &back);
 			break;
 		case lb_elif:
 			// Skip the elif statement, it should have already been linked
 			counter++;
 			counter += sizeof(size_t);
-			counter = link_if_cmd(data, counter, end, search_end | search_else, srcFile, &back);
+			counter = link_if_cmd(data, counter, end, search_end | search_else, linkVersion, pool, srcFile, &back);
 				// seek_past_if_style_cmd(counter, NULL, srcFile, &back);
 			break;
 		case lb_end:
@@ -147,17 +167,40 @@ compile_error_t *link_data(byte_t *data, size_t len, const char *srcFile, compil
 			counter++;
 			counter += sizeof(size_t);
 			break;
+		case lb_switch:
+			counter = link_switch_cmd(data, counter, end, linkVersion, pool, srcFile, &back);
+			if (!counter)
+			{
+				if (pool)
+					FREE(pool);
+				return back;
+			}
+			break;
+		case lb_case:
+			// Case labels are linked with their switch
+			counter++;
+			counter += sizeof(size_t) + sizeof(qword_t);
+			break;
+		case lb_default:
+			counter++;
+			counter += sizeof(size_t);
+			break;
 		default:
 			back = add_compile_error(back, srcFile, 0, error_error, "Failed to seek to a valid control statement.");
 		case NULL:
+			if (pool)
+				FREE(pool);
 			return back;
 			break;
 		}
 	}
+
+	if (pool)
+		FREE(pool);
 	return back;
 }
 
-byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, compile_error_t **backPtr)
+byte_t *seek_to_next_control(byte_t *off, byte_t *end, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr)
 {
 	unsigned char i;
 	unsigned char argCount;
@@ -173,6 +216,9 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 		case lb_elif:
 		case lb_while:
 		case lb_end:
+		case lb_switch:
+		case lb_case:
+		case lb_default:
 			return off;
 			break;
 
@@ -229,6 +275,18 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 					break;
 				}
 			}
+
+			if (version >= LB_VERSION_SLOTS)
+			{
+				argCount = *off; // local count
+				off++;
+				for (i = 0; i < argCount; i++)
+				{
+					off++;
+					off += strlen(off) + 1; // local name
+				}
+				off += sizeof(dword_t); // body size
+			}
 			break;
 
 		case lb_noop:
@@ -244,6 +302,7 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 		case lb_ulong:
 		case lb_bool:
 		case lb_float:
+		case lb_double:
 		case lb_object:
 		case lb_chararray:
 		case lb_uchararray:
@@ -258,30 +317,34 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 		case lb_doublearray:
 		case lb_objectarray:
 			off++;
-			off += strlen(off) + 1;
+			off = lb_skip_operand(off);
 			break;
 
 		case lb_setb:
-			off += strlen(off) + 1;
+			off++;
+			off = lb_skip_operand(off);
 			off += sizeof(byte_t);
 			break;
 		case lb_setw:
-			off += strlen(off) + 1;
+			off++;
+			off = lb_skip_operand(off);
 			off += sizeof(word_t);
 			break;
 		case lb_setd:
 		case lb_setr4:
-			off += strlen(off) + 1;
+			off++;
+			off = lb_skip_operand(off);
 			off += sizeof(dword_t);
 			break;
 		case lb_setq:
 		case lb_setr8:
-			off += strlen(off) + 1;
+			off++;
+			off = lb_skip_operand(off);
 			off += sizeof(qword_t);
 			break;
 		case lb_seto:
 			off++;
-			off += strlen(off) + 1;
+			off = lb_skip_operand(off);
 			setObject:
 			switch (*off)
 			{
@@ -291,35 +354,11 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 				off += strlen(off) + 1;	// Constructor signature
 				// Custom constructors not supported yet :'(
 				for (i = 0; i < argCount; i++)
-				{
-					switch (*off)
-					{
-					case lb_byte:
-						off++;
-						off += sizeof(byte_t);
-						break;
-					case lb_word:
-						off++;
-						off += sizeof(word_t);
-						break;
-					case lb_dword:
-						off++;
-						off += sizeof(dword_t);
-						break;
-					case lb_qword:
-						off++;
-						off += sizeof(qword_t);
-						break;
-					case lb_string:
-					case lb_value:
-						off++;
-						off += strlen(off) + 1;
-						break;
-					}
-				}
+					off = skip_value(off);
 				break;
 			case lb_value:
-				off += strlen(off) + 1;
+				off++;
+				off = lb_skip_operand(off);
 				break;
 			case lb_string:
 				off += strlen(off) + 1;
@@ -327,15 +366,21 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 			case lb_null:
 				off++;
 				break;
+			default:
+				// Array creation, the element type followed by the length
+				off++;
+				off = skip_value(off);
+				break;
 			}
 			break;
 		case lb_setv:
-			off += strlen(off) + 1;
-			off += strlen(off) + 1;
+			off++;
+			off = lb_skip_operand(off);
+			off = lb_skip_operand(off);
 			break;
 		case lb_setr:
 			off++;
-			off += strlen(off) + 1;
+			off = lb_skip_operand(off);
 			break;
 
 		case lb_ret:
@@ -366,41 +411,30 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 			break;
 		case lb_retv:
 			off++;
-			off += strlen(off) + 1;
+			off = lb_skip_operand(off);
 			break;
 
 		case lb_static_call:
 		case lb_dynamic_call:
-			off++;
-			argCount = infer_argument_count((char *)off);
-			off += strlen(off) + 1;	// Function name
-			for (i = 0; i < argCount; i++)
+			if (*off == lb_dynamic_call && version >= LB_VERSION_SLOTS)
 			{
-				switch (*off)
-				{
-				case lb_byte:
-					off++;
-					off += sizeof(byte_t);
-					break;
-				case lb_word:
-					off++;
-					off += sizeof(word_t);
-					break;
-				case lb_dword:
-					off++;
-					off += sizeof(dword_t);
-					break;
-				case lb_qword:
-					off++;
-					off += sizeof(qword_t);
-					break;
-				case lb_string:
-				case lb_value:
-					off++;
-					off += strlen(off) + 1;
-					break;
-				}
+				off++;
+				off = lb_skip_operand(off); // Object
+			}
+			else
+				off++;
+			if (version >= LB_VERSION_POOL)
+			{
+				argCount = infer_argument_count(pool[*((word_t *)off)]);
+				off += sizeof(word_t); // Function name index
+			}
+			else
+			{
+				argCount = infer_argument_count((char *)off);
+				off += strlen(off) + 1;	// Function name
 			}
+			for (i = 0; i < argCount; i++)
+				off = skip_value(off);
 			break;
 		
 		case lb_add:
@@ -414,33 +448,9 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 		case lb_lsh:
 		case lb_rsh:
 			off++;
-			off += strlen(off) + 1;	// Destination variable name
-			off += strlen(off) + 1;	// Source variable name
-			switch (*off)			// Argument
-			{
-			case lb_char:
-			case lb_uchar:
-				off += sizeof(byte_t);
-				break;
-			case lb_short:
-			case lb_ushort:
-				off += sizeof(word_t);
-				break;
-			case lb_int:
-			case lb_uint:
-			case lb_real4:
-				off += sizeof(dword_t);
-				break;
-			case lb_long:
-			case lb_ulong:
-			case lb_real8:
-				off += sizeof(qword_t);
-				break;
-			case lb_value:
-				off++;
-				off += strlen(off) + 1;
-				break;
-			}
+			off = lb_skip_operand(off);	// Destination variable
+			off = lb_skip_operand(off);	// Source variable
+			off = skip_value(off);		// Argument
 			break;
 		case lb_castc:
 		case lb_castuc:
@@ -458,8 +468,8 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 			// Handle unary operators
 
 			off++;
-			off += strlen(off) + 1;	// Destination variable name
-			off += strlen(off) + 1;	// Source variable name
+			off = lb_skip_operand(off);	// Destination variable
+			off = lb_skip_operand(off);	// Source variable
 			break;
 
 		case lb_align:
@@ -476,9 +486,9 @@ byte_t *seek_to_next_control(byte_t *off, byte_t *end, const char *srcFile, comp
 	return off;
 }
 
-byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, const char *srcFile, compile_error_t **backPtr)
+byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr)
 {
-	int level = 0;				// The control level we are in (start with while or if, end with end)
+	int level = searchType & search_inside ? 1 : 0;	// The control level we are in (start with while or if, end with end)
 	byte_t *top = off;			// The top of the if command
 	byte_t *failLoc = NULL;		// The relative location in bytecode where the program will jump to on comparison fail
 	byte_t *exitLoc = NULL;		// The relative location in bytecode where the program will jump to no matter what
@@ -490,7 +500,9 @@ byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, con
 		{
 		case lb_else:
 			off++;
-			if (searchType & search_else)
+
+			// An else of an if nested in this one is linked with that if
+			if ((searchType & search_else) && level == 1)
 			{
 				// When the instructions above this statement execute, exit the whole block
 				exitLinkLoc = (size_t *)off;
@@ -498,7 +510,7 @@ byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, con
 				failLoc = off;
 
 				// Seek to the end of the whole control block
-				exitLoc = link_if_cmd(start, off, end, search_end | search_no_link, srcFile, backPtr);
+				exitLoc = link_if_cmd(start, off, end, search_end | search_no_link | search_inside, version, pool, srcFile, backPtr);
 				if (searchType & search_no_link)
 					return off;
 				goto perform_if_link;
@@ -507,7 +519,7 @@ byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, con
 			break;
 		case lb_elif:
 			off++;
-			if (searchType & search_else)
+			if ((searchType & search_else) && level == 1)
 			{
 				// When the instructions above this statement execute, exit the whole block
 				exitLinkLoc = (size_t *)off;
@@ -520,16 +532,18 @@ byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, con
 				failLoc = off;
 
 				// Seek to the end of the whole control block
-				exitLoc = link_if_cmd(start, off, end, search_end | search_no_link, srcFile, backPtr);
+				exitLoc = link_if_cmd(start, off, end, search_end | search_no_link, version, pool, srcFile, backPtr);
 				if (searchType & search_no_link)
 					return off;
 				goto perform_if_link;
 			}
 			else
 			{
+				// An elif continues the if before it and shares its end, so it opens no new level
 				off += sizeof(size_t);
 				off = seek_past_if_style_cmd(off, NULL, srcFile, backPtr);
 			}
+			break;
 		case lb_if:
 		case lb_while:
 			// Increment the control statement level we are in
@@ -542,6 +556,16 @@ byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, con
 			if (level == 1)
 				failLinkLoc = (size_t *)(off - sizeof(size_t));
 			break;
+		case lb_switch:
+			level++;
+			off = seek_past_switch_cmd(off);
+			break;
+		case lb_case:
+			off += 1 + sizeof(size_t) + sizeof(qword_t);
+			break;
+		case lb_default:
+			off += 1 + sizeof(size_t);
+			break;
 		case lb_end:
 			// Decrement the control statement level we are in
 			level--;
@@ -566,7 +590,7 @@ byte_t *link_if_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, con
 			break;
 		default:
 			// Seek to next control statement
-			off = seek_to_next_control(off, end, srcFile, backPtr);
+			off = seek_to_next_control(off, end, version, pool, srcFile, backPtr);
 			if (!off)
 				return NULL;
 			break;
@@ -584,7 +608,7 @@ perform_if_link:
 	return (byte_t *)(failLinkLoc + 1); // Return start of next command
 }
 
-byte_t *link_while_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, const char *srcFile, compile_error_t **backPtr)
+byte_t *link_while_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr)
 {
 	int level = 0;
 	byte_t *topLoc = off;
@@ -607,9 +631,12 @@ byte_t *link_while_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType,
 			off += sizeof(size_t);
 			break;
 		case lb_elif:
+			// An elif continues the if before it and shares its end, so it opens no new level
 			off++;
 			off += sizeof(size_t);
 			assert(*off == lb_if);
+			off = seek_past_if_style_cmd(off, NULL, srcFile, backPtr);
+			break;
 		case lb_if:
 		case lb_while:
 			level++;
@@ -617,6 +644,16 @@ byte_t *link_while_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType,
 			if (level == 1)
 				failLinkLoc = (size_t *)(off - sizeof(size_t));
 			break;
+		case lb_switch:
+			level++;
+			off = seek_past_switch_cmd(off);
+			break;
+		case lb_case:
+			off += 1 + sizeof(size_t) + sizeof(qword_t);
+			break;
+		case lb_default:
+			off += 1 + sizeof(size_t);
+			break;
 		case lb_end:
 			level--;
 			off++;
@@ -631,7 +668,7 @@ byte_t *link_while_cmd(byte_t *start, byte_t *off, byte_t *end, int searchType,
 			}
 			break;
 		default:
-			off = seek_to_next_control(off, end, srcFile, backPtr);
+			off = seek_to_next_control(off, end, version, pool, srcFile, backPtr);
 			if (!off)
 				return NULL;
 			break;
@@ -669,87 +706,310 @@ byte_t *seek_past_if_style_cmd(byte_t *start, size_t **linkStart, const char *sr
 	byte_t count = *off;
 	off++;
 
+	off = skip_value(off);
+
+	if (count == lb_one)
+	{
+		if (linkStart)
+			*linkStart = (size_t *)off;
+		off += sizeof(size_t);
+	}
+	else if (count == lb_two)
+	{
+		off++; // comparator
+		off = skip_value(off);
+
+		if (linkStart)
+			*linkStart = (size_t *)off;
+		off += sizeof(size_t);
+	}
+	else
+	{
+		// bad
+	}
+	return off;
+}
+
+byte_t *link_switch_cmd(byte_t *start, byte_t *off, byte_t *end, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr)
+{
+	byte_t *body;				// The first command after the switch
+	byte_t *label;				// The current case or default label
+	byte_t *exitLoc;			// The switch's end command, where every case exits to
+	size_t *defaultLinkLoc;		// The location of the default target in the table
+	size_t *table;				// The first entry of the table
+	byte_t tableType;			// lb_dense or lb_sparse
+	qword_t low = 0;			// The lowest case of a dense table
+	dword_t count;				// The number of entries in the table
+	qword_t value;
+	dword_t i;
+
+	off++;
+	off = lb_skip_operand(off);
+	tableType = *off;
+	off++;
+	if (tableType == lb_dense)
+	{
+		low = *((qword_t *)off);
+		off += sizeof(qword_t);
+	}
+	else if (tableType != lb_sparse)
+	{
+		*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Error linking switch command: bad table type 0x%02x", (unsigned)tableType);
+		return NULL;
+	}
+	count = *((dword_t *)off);
+	off += sizeof(dword_t);
+	defaultLinkLoc = (size_t *)off;
+	table = defaultLinkLoc + 1;
+	body = (byte_t *)(table + (tableType == lb_dense ? count : count * 2));
+
+	// Point every entry of the table at the label with its case
+	*defaultLinkLoc = (size_t)-1;
+	label = seek_to_switch_label(body, end, version, pool, srcFile, backPtr);
+	while (label && label < end && *label != lb_end)
+	{
+		if (*label == lb_default)
+		{
+			*defaultLinkLoc = label + 1 + sizeof(size_t) - start;
+			label += 1 + sizeof(size_t);
+		}
+		else
+		{
+			value = *((qword_t *)(label + 1 + sizeof(size_t)));
+			if (tableType == lb_dense && value - low < count)
+				table[value - low] = label + 1 + sizeof(size_t) + sizeof(qword_t) - start;
+			else
+			{
+				for (i = 0; tableType == lb_sparse && i < count; i++)
+				{
+					if (table[i * 2] == value)
+					{
+						table[i * 2 + 1] = label + 1 + sizeof(size_t) + sizeof(qword_t) - start;
+						break;
+					}
+				}
+				if (tableType == lb_dense || i == count)
+				{
+					*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Error linking switch command: case %lld is not in the table", (llong)value);
+					return NULL;
+				}
+			}
+			label += 1 + sizeof(size_t) + sizeof(qword_t);
+		}
+		label = seek_to_switch_label(label, end, version, pool, srcFile, backPtr);
+	}
+
+	if (!label || label >= end)
+	{
+		*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Error linking switch command: missing end");
+		return NULL;
+	}
+	exitLoc = label;
+
+	// Values without a case go to the default label, or straight to the end without one
+	if (*defaultLinkLoc == (size_t)-1)
+		*defaultLinkLoc = exitLoc - start;
+	for (i = 0; i < count; i++)
+	{
+		if (tableType == lb_dense && table[i] == (size_t)-1)
+			table[i] = *defaultLinkLoc;
+		else if (tableType == lb_sparse && table[i * 2 + 1] == (size_t)-1)
+		{
+			*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Error linking switch command: case %lld has no label", (llong)table[i * 2]);
+			return NULL;
+		}
+	}
+
+	// The body of each case ends where the next label begins
+	label = seek_to_switch_label(body, end, version, pool, srcFile, backPtr);
+	while (label && label < exitLoc)
+	{
+		*((size_t *)(label + 1)) = exitLoc - start;
+		label += 1 + sizeof(size_t) + (*label == lb_case ? sizeof(qword_t) : 0);
+		label = seek_to_switch_label(label, end, version, pool, srcFile, backPtr);
+	}
+
+	return body;
+}
+
+byte_t *seek_to_switch_label(byte_t *off, byte_t *end, unsigned int version, char **pool, const char *srcFile, compile_error_t **backPtr)
+{
+	int level = 0;	// The number of blocks nested in the switch which off is in
+
+	while (off && off < end)
+	{
+		switch (*off)
+		{
+		case lb_if:
+		case lb_while:
+			level++;
+			off = seek_past_if_style_cmd(off, NULL, srcFile, backPtr);
+			break;
+		case lb_elif:
+			off++;
+			off += sizeof(size_t);
+			off = seek_past_if_style_cmd(off, NULL, srcFile, backPtr);
+			break;
+		case lb_else:
+			off++;
+			off += sizeof(size_t);
+			break;
+		case lb_switch:
+			level++;
+			off = seek_past_switch_cmd(off);
+			break;
+		case lb_case:
+			if (level == 0)
+				return off;
+			off += 1 + sizeof(size_t) + sizeof(qword_t);
+			break;
+		case lb_default:
+			if (level == 0)
+				return off;
+			off += 1 + sizeof(size_t);
+			break;
+		case lb_end:
+			if (level == 0)
+				return off;
+			level--;
+			off++;
+			off += sizeof(size_t);
+			break;
+		default:
+			off = seek_to_next_control(off, end, version, pool, srcFile, backPtr);
+			break;
+		}
+	}
+	return off;
+}
+
+byte_t *seek_past_switch_cmd(byte_t *start)
+{
+	assert(*start == lb_switch);
+
+	byte_t *off = start;
+	off++;
+	off = lb_skip_operand(off);
+
+	if (*off == lb_dense)
+	{
+		off++;
+		off += sizeof(qword_t); // lowest case
+		off += sizeof(dword_t) + sizeof(size_t) + *((dword_t *)off) * sizeof(size_t);
+	}
+	else
+	{
+		off++;
+		off += sizeof(dword_t) + sizeof(size_t) + *((dword_t *)off) * (sizeof(qword_t) + sizeof(size_t));
+	}
+	return off;
+}
+
+char **read_pool(byte_t *data, byte_t **endPtr, const char *srcFile, compile_error_t **backPtr)
+{
+	byte_t *end = *endPtr;
+	byte_t *cursor;
+	byte_t *nul;
+	dword_t poolOffset;
+	dword_t count;
+	char **pool;
+
+	if ((size_t)(end - data) < 5 + 2 * sizeof(dword_t))
+	{
+		*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Missing constant pool");
+		return NULL;
+	}
+
+	poolOffset = *((dword_t *)(end - sizeof(dword_t)));
+	end -= sizeof(dword_t);
+	if (poolOffset < 5 || poolOffset + sizeof(dword_t) > (size_t)(end - data))
+	{
+		*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Bad constant pool offset");
+		return NULL;
+	}
+
+	cursor = data + poolOffset;
+	count = *((dword_t *)cursor);
+	cursor += sizeof(dword_t);
+	if (count > (size_t)(end - cursor))
+	{
+		*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Bad constant pool size");
+		return NULL;
+	}
+
+	pool = (char **)MALLOC((count + 1) * sizeof(char *));
+	if (!pool)
+	{
+		*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Allocation failure.");
+		return NULL;
+	}
+
+	for (dword_t i = 0; i < count; i++)
+	{
+		nul = (byte_t *)memchr(cursor, 0, end - cursor);
+		if (!nul)
+		{
+			FREE(pool);
+			*backPtr = add_compile_error(*backPtr, srcFile, 0, error_error, "Bad constant pool entry");
+			return NULL;
+		}
+		pool[i] = (char *)cursor;
+		cursor = nul + 1;
+	}
+	pool[count] = NULL;
+
+	*endPtr = data + poolOffset;
+	return pool;
+}
+
+byte_t *skip_value(byte_t *off)
+{
 	switch (*off)
 	{
+	case lb_bool:
 	case lb_char:
 	case lb_uchar:
+	case lb_byte:
 		off++;
 		off += sizeof(byte_t);
 		break;
 	case lb_short:
 	case lb_ushort:
+	case lb_word:
 		off++;
 		off += sizeof(word_t);
 		break;
 	case lb_int:
 	case lb_uint:
 	case lb_float:
+	case lb_dword:
+	case lb_real4:
+		off++;
 		off += sizeof(dword_t);
 		break;
 	case lb_long:
 	case lb_ulong:
 	case lb_double:
+	case lb_qword:
+	case lb_real8:
+		off++;
 		off += sizeof(qword_t);
 		break;
 	case lb_value:
+		off++;
+		off = lb_skip_operand(off);
+		break;
+	case lb_string:
 		off++;
 		off += strlen(off) + 1;
 		break;
+	case lb_ret:
+		off++;
+		break;
 	default:
+		assert(0);
 		break;
 	}
-
-	if (count == lb_one)
-	{
-		if (linkStart)
-			*linkStart = (size_t *)off;
-		off += sizeof(size_t);
-	}
-	else if (count == lb_two)
-	{
-		off++; // comparator
-		switch (*off)
-		{
-		case lb_bool:
-		case lb_char:
-		case lb_uchar:
-			off++;
-			off += sizeof(byte_t);
-			break;
-		case lb_short:
-		case lb_ushort:
-			off++;
-			off += sizeof(word_t);
-			break;
-		case lb_int:
-		case lb_uint:
-		case lb_float:
-			off++;
-			off += sizeof(dword_t);
-			break;
-		case lb_long:
-		case lb_ulong:
-		case lb_double:
-			off++;
-			off += sizeof(qword_t);
-			break;
-		case lb_value:
-			off++;
-			off += strlen(off) + 1;
-			break;
-		default:
-			assert(0);
-			break;
-		}
-
-		if (linkStart)
-			*linkStart = (size_t *)off;
-		off += sizeof(size_t);
-	}
-	else
-	{
-		// bad
-	}
 	return off;
 }
 
@@ -762,6 +1022,9 @@ unsigned char infer_argument_count(const char *qualname)
 	cursor++;
 	while (*cursor)
 	{
+		// An array argument is its element type prefixed with [
+		if (*cursor == '[')
+			cursor++;
 		if (*cursor == 'L')
 			cursor = strchr(cursor, ';');
 		cursor++;
@@ -30,7 +30,7 @@ int main(int argc, char *argv[])
 	input_file_t *files = NULL;
 	const char *inputDirectory = NULL;
 	const char *outputDirectory = ".";
-	unsigned int version = 1;
+	unsigned int version = LB_VERSION_POOL;
 	int runCompiler = 1, runLinker = 1;
 	int compileDebug = 0;
 	int inputDirRec = 0;
@@ -244,7 +244,7 @@ void display_help()
 	printf("               .lasm extension will be added as an input compilation.\n");
 	printf("-r             Indicates that the directory specified in -i should search\n");
 	printf("               recursively.\n");
-	printf("-s [version]   Sets the bytecode version to compile to. Default is 1.\n");
+	printf("-s [version]   Sets the bytecode version to compile to (1, 2 or 3). Default is 3.\n");
 	printf("-fa [value]    Sets the number of bytes to align functions to. Default is 32.\n");
 	printf("-ga [value]    Sets the number of bytes to align globals to. Default is 8.\n");
 	printf("-nc            Specifies not to run the compiler.\n");
@@ -98,22 +98,14 @@ int handle_cast(void *envPtr, byte_t **executeLocation)
 
     (*executeLocation)++;
 
-    char *dstName = (char *)(*executeLocation);
     data_t *dstData;
     flags_t dstFlags;
+    if (!env_resolve_operand(env, executeLocation, &dstData, &dstFlags))
+        return 0;
 
-    (*executeLocation) += strlen(*executeLocation) + 1;
-
-    char *srcName = (char *)(*executeLocation);
     data_t *srcData;
     flags_t srcFlags;
-
-    (*executeLocation) += strlen(*executeLocation) + 1;
-
-    if (!env_resolve_variable(env, dstName, &dstData, &dstFlags))
-        return 0;
-
-    if (!env_resolve_variable(env, srcName, &srcData, &srcFlags))
+    if (!env_resolve_operand(env, executeLocation, &srcData, &srcFlags))
         return 0;
 
     switch (TYPEOF(srcFlags))
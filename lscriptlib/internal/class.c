@@ -13,6 +13,13 @@ static int register_functions(class_t *clazz, const byte_t *dataStart, const byt
 static int register_static_fields(class_t *clazz, const byte_t *dataStart, const byte_t *dataEnd);
 static int register_field_offests(class_t *clazz, const byte_t *dataStart, const byte_t *dataEnd);
 
+static const byte_t *seek_function_end(const byte_t *curr);
+static const byte_t *seek_global_end(const byte_t *curr);
+static int build_function_frame(function_t *func);
+static const byte_t *next_static_field(class_t *clazz, const byte_t *curr, const char **name);
+static int build_vtable(class_t *clazz);
+static int read_pool(class_t *clazz, const byte_t *dataStart, byte_t **dataEnd);
+
 class_t *class_load(byte_t *binary, size_t length, int loadSuperclasses, classloadproc_t loadproc, void *more)
 {
 	class_t *result;
@@ -37,6 +44,20 @@ class_t *class_load(byte_t *binary, size_t length, int loadSuperclasses, classlo
 	version = *((unsigned int *)curr); // Will be read different on big-endian machines
 	curr += sizeof(unsigned int);
 
+	if (version < LB_VERSION_NAMED || version > LB_VERSION_POOL)
+	{
+		FREE(result);
+		return NULL;
+	}
+	result->version = version;
+
+	// The pool follows the class's code, so everything after this stops where it begins
+	if (version >= LB_VERSION_POOL && !read_pool(result, binary, &end))
+	{
+		FREE(result);
+		return NULL;
+	}
+
 	if (curr == end)
 		return result;
 
@@ -132,7 +153,16 @@ class_t *class_load(byte_t *binary, size_t length, int loadSuperclasses, classlo
 			return NULL;
 		}
 
-		set_superclass(result, superclass);
+		if (!set_superclass(result, superclass))
+		{
+			class_free(result, 0);
+			return NULL;
+		}
+	}
+	else if (!build_vtable(result))
+	{
+		class_free(result, 0);
+		return NULL;
 	}
 
 	return result;
@@ -165,7 +195,7 @@ int set_superclass(class_t *__restrict clazz, class_t *__restrict superclass)
 	}
 	map_iterator_free(mit);
 
-	return 1;
+	return build_vtable(clazz);
 }
 
 void class_free(class_t *__restrict clazz, int freedata)
@@ -197,6 +227,36 @@ void class_free(class_t *__restrict clazz, int freedata)
 
 			map_free(argTypes, 1);
 
+			if (func->localTypes)
+			{
+				FREE(func->localTypes);
+				func->localTypes = NULL;
+			}
+
+			if (func->slots)
+			{
+				map_free(func->slots, 0);
+				func->slots = NULL;
+			}
+
+			if (func->frame)
+			{
+				FREE(func->frame);
+				func->frame = NULL;
+			}
+
+			if (func->nativeArgTypes)
+			{
+				FREE(func->nativeArgTypes);
+				func->nativeArgTypes = NULL;
+			}
+
+			if (func->decoded)
+			{
+				FREE(func->decoded);
+				func->decoded = NULL;
+			}
+
 			FREE(it->key);
 			it->key = NULL;
 
@@ -212,7 +272,15 @@ void class_free(class_t *__restrict clazz, int freedata)
 
 	map_free(clazz->functions, 0); // need to free each element individually here
 	map_free(clazz->staticFields, 0);
+	if (clazz->statics)
+		FREE(clazz->statics);
+	if (clazz->vtable)
+		FREE(clazz->vtable);
+	if (clazz->pool)
+		FREE(clazz->pool);
 	map_free(clazz->fields, 1);
+	if (clazz->refs)
+		FREE(clazz->refs);
 
 	if (clazz->debug)
 		free_debug(clazz->debug);
@@ -256,6 +324,11 @@ int register_functions(class_t *clazz, const byte_t *dataStart, const byte_t *da
 	size_t i;
 	size_t argSize;
 
+	unsigned char numLocals;
+	byte_t *localTypes;
+	const char **localNames;
+	const byte_t *bodyEnd;
+
 	const byte_t *curr = dataStart;
 	while (curr < dataEnd)
 	{
@@ -442,6 +515,42 @@ int register_functions(class_t *clazz, const byte_t *dataStart, const byte_t *da
 				curr += strlen(argname) + 1;
 			}
 
+			// Version 2 headers list the function's locals and the size of its body
+			numLocals = 0;
+			localTypes = NULL;
+			localNames = NULL;
+			bodyEnd = NULL;
+			if (clazz->version >= LB_VERSION_SLOTS)
+			{
+				numLocals = *curr;
+				curr++;
+
+				if (numLocals > 0)
+				{
+					localTypes = (byte_t *)MALLOC(numLocals * sizeof(byte_t));
+					localNames = (const char **)MALLOC(numLocals * sizeof(const char *));
+					if (!localTypes || !localNames)
+					{
+						if (localTypes)
+							FREE(localTypes);
+						if (localNames)
+							FREE(localNames);
+						return 0;
+					}
+				}
+
+				for (unsigned char i = 0; i < numLocals; i++)
+				{
+					localTypes[i] = *curr;
+					curr++;
+					localNames[i] = curr;
+					curr += strlen(curr) + 1;
+				}
+
+				bodyEnd = curr + sizeof(dword_t) + *((dword_t *)curr);
+				curr += sizeof(dword_t);
+			}
+
 			func = (function_t *)MALLOC(sizeof(function_t));
 			if (func)
 			{
@@ -453,6 +562,7 @@ int register_functions(class_t *clazz, const byte_t *dataStart, const byte_t *da
 
 				func->name = funcName;
 				func->location = execType == lb_interp ? (void *)curr : NULL;
+				func->bodySize = bodyEnd ? (size_t)(bodyEnd - curr) : 0;
 				func->argTypes = argTypes;
 				func->numargs = numArgs;
 				func->parentClass = clazz;
@@ -460,12 +570,26 @@ int register_functions(class_t *clazz, const byte_t *dataStart, const byte_t *da
 				func->argSize = argSize;
 				func->references = 1;
 				func->returnType = returnType;
+				func->numlocals = numLocals;
+				func->localTypes = localTypes;
+				func->slots = NULL;
+				func->framesize = 0;
+				func->frame = NULL;
+				func->vtableIndex = 0;
+				func->vtableOwner = NULL;
+				func->nativeArgTypes = NULL;
+				func->intrinsic = NULL;
+				func->numdecoded = 0;
+				func->decoded = NULL;
 
 				if (isStatic)
 					func->flags |= FUNCTION_FLAG_STATIC;
 
 				if (execType == lb_native)
+				{
 					func->flags |= FUNCTION_FLAG_NATIVE;
+					func->intrinsic = intrinsic_find(clazz->name, func->qualifiedName);
+				}
 				else if (execType == lb_abstract)
 					func->flags |= FUNCTION_FLAG_ABSTRACT;
 
@@ -484,6 +608,34 @@ int register_functions(class_t *clazz, const byte_t *dataStart, const byte_t *da
 				}
 				list_iterator_free(it);
 
+				if (clazz->version >= LB_VERSION_SLOTS)
+				{
+					// Names are only looked up for operands the compiler could not bind to a slot
+					func->slots = map_create(8, string_hash_func, string_compare_func, NULL, NULL, NULL);
+					if (!func->slots)
+					{
+						if (localNames)
+							FREE(localNames);
+						return 0;
+					}
+
+					for (i = 0; i < numArgs; i++)
+						map_insert(func->slots, func->args[i], (void *)(i + 1));
+					if (!isStatic)
+						map_insert(func->slots, "this", (void *)(numArgs + 1));
+					for (i = 0; i < numLocals; i++)
+						map_insert(func->slots, localNames[i], (void *)(numArgs + !isStatic + i + 1));
+
+					if (!build_function_frame(func))
+					{
+						if (localNames)
+							FREE(localNames);
+						return 0;
+					}
+				}
+				if (localNames)
+					FREE(localNames);
+
 				map_insert(clazz->functions, qualifiedName, func);
 
 				if (argorder->next)
@@ -493,6 +645,15 @@ int register_functions(class_t *clazz, const byte_t *dataStart, const byte_t *da
 				}
 				list_free(argorder, 0);
 			}
+
+			if (bodyEnd)
+				curr = bodyEnd;
+			break;
+		case lb_global:
+			if (clazz->version >= LB_VERSION_SLOTS)
+				curr = seek_global_end(curr);
+			else
+				curr++;
 			break;
 		case lb_setb:
 		case lb_retb:
@@ -569,31 +730,70 @@ int register_static_fields(class_t *clazz, const byte_t *dataStart, const byte_t
 	if (!clazz->staticFields)
 		clazz->staticFields = map_create(CLASS_HASHTABLE_ENTRIES, string_hash_func, string_compare_func, string_copy_func, NULL, (free_func_t)free);
 	const char *globalName;
+	const char *curr;
 
-	const char *curr = dataStart;
+	// Count the statics first so the slot array can be allocated up front
+	clazz->numstatics = 0;
+	curr = dataStart;
 	while (curr < dataEnd)
 	{
-		switch (*curr)
+		curr = next_static_field(clazz, curr, &globalName);
+		if (globalName)
+			clazz->numstatics++;
+	}
+
+	clazz->statics = NULL;
+	if (clazz->numstatics > 0)
+	{
+		clazz->statics = (value_t **)MALLOC(clazz->numstatics * sizeof(value_t *));
+		if (!clazz->statics)
+			return 0;
+	}
+
+	// Statics are numbered in declaration order, which is how the compiler addresses them
+	size_t index = 0;
+	curr = dataStart;
+	while (curr < dataEnd)
+	{
+		curr = next_static_field(clazz, curr, &globalName);
+		if (globalName)
 		{
-		case lb_global:
-			curr++;
-			globalName = curr;
-			curr += strlen(globalName) + 1;
-			if (*curr == lb_static)
-			{
-				map_insert(clazz->staticFields, globalName, curr);
-				value_t *val = (value_t *)curr;
-				curr += 8 + value_sizeof(val);
-			}
-			break;
-		default:
-			curr++;
-			break;
+			value_t *val = (value_t *)(globalName + strlen(globalName) + 1);
+			map_insert(clazz->staticFields, globalName, val);
+			clazz->statics[index++] = val;
 		}
 	}
 	return 1;
 }
 
+const byte_t *next_static_field(class_t *clazz, const byte_t *curr, const char **name)
+{
+	value_t *val;
+
+	*name = NULL;
+	switch (*curr)
+	{
+	case lb_global:
+		curr++;
+		if (curr[strlen(curr) + 1] == lb_static)
+		{
+			*name = curr;
+			curr += strlen(curr) + 1;
+			val = (value_t *)curr;
+			curr += 8 + value_sizeof(val);
+		}
+		else
+			curr += strlen(curr) + 1;
+		return curr;
+	case lb_function:
+		if (clazz->version >= LB_VERSION_SLOTS)
+			return seek_function_end(curr);
+		return curr + 1;
+	default:
+		return curr + 1;
+	}
+}
+
 int register_field_offests(class_t *clazz, const byte_t *dataStart, const byte_t *dataEnd)
 {
 	if (!clazz->fields)
@@ -602,6 +802,8 @@ int register_field_offests(class_t *clazz, const byte_t *dataStart, const byte_t
 
 	size_t valueSize;
 	size_t currentOffset = 0;
+	size_t refCount = 0;
+	byte_t type;
 
 	const byte_t *curr = dataStart;
 	while (curr < dataEnd)
@@ -626,6 +828,10 @@ int register_field_offests(class_t *clazz, const byte_t *dataStart, const byte_t
 				field->offset = (void *)currentOffset;
 				map_insert(clazz->fields, fieldName, field);
 				currentOffset += valueSize;
+
+				type = *(curr + VALUE_TYPE_OFFSET);
+				if (type >= lb_object && type <= lb_objectarray)
+					refCount++;
 				curr += 8;
 			}
 			else
@@ -633,6 +839,12 @@ int register_field_offests(class_t *clazz, const byte_t *dataStart, const byte_t
 				curr += 8 + valueSize;
 			}
 			break;
+		case lb_function:
+			if (clazz->version >= LB_VERSION_SLOTS)
+				curr = seek_function_end(curr);
+			else
+				curr++;
+			break;
 		default:
 			curr++;
 			break;
@@ -640,6 +852,167 @@ int register_field_offests(class_t *clazz, const byte_t *dataStart, const byte_t
 	}
 
 	clazz->size = currentOffset;
+
+	// An object holds exactly its class's fields, so these offsets cover every reference in it
+	clazz->numrefs = 0;
+	clazz->refs = NULL;
+	if (refCount)
+	{
+		clazz->refs = (size_t *)MALLOC(refCount * sizeof(size_t));
+		if (!clazz->refs)
+		{
+			map_free(clazz->fields, 1);
+			clazz->fields = NULL;
+			return 0;
+		}
+
+		map_iterator_t *mit = map_create_iterator(clazz->fields);
+		while (mit->node)
+		{
+			field_t *field = (field_t *)mit->value;
+			type = field_typeof(field);
+			if (type >= lb_object && type <= lb_objectarray)
+				clazz->refs[clazz->numrefs++] = (size_t)field->offset;
+			mit = map_iterator_next(mit);
+		}
+		map_iterator_free(mit);
+	}
+
+	return 1;
+}
+
+const byte_t *seek_function_end(const byte_t *curr)
+{
+	unsigned char count;
+	unsigned char i;
+
+	curr++;
+	curr += 3; // Function qualifiers and return type
+	curr += strlen(curr) + 1; // Function name
+
+	count = *curr;
+	curr++;
+	for (i = 0; i < count; i++)
+	{
+		if (*curr == lb_object || *curr == lb_objectarray)
+		{
+			curr++;
+			curr += strlen(curr) + 1; // Argument classname
+		}
+		else
+			curr++;
+		curr += strlen(curr) + 1; // Argument name
+	}
+
+	count = *curr;
+	curr++;
+	for (i = 0; i < count; i++)
+	{
+		curr++;
+		curr += strlen(curr) + 1; // Local name
+	}
+
+	return curr + sizeof(dword_t) + *((dword_t *)curr);
+}
+
+const byte_t *seek_global_end(const byte_t *curr)
+{
+	value_t *val;
+
+	curr++;
+	curr += strlen(curr) + 1;
+	val = (value_t *)curr;
+	curr += 8;
+	if (value_access_type(val) == lb_static)
+		curr += value_sizeof(val);
+	return curr;
+}
+
+int build_function_frame(function_t *func)
+{
+	size_t i;
+	value_t *slot;
+
+	func->framesize = func->numargs + !(func->flags & FUNCTION_FLAG_STATIC) + func->numlocals;
+	if (func->framesize == 0)
+		return 1;
+
+	func->frame = (value_t *)CALLOC(func->framesize, sizeof(value_t));
+	if (!func->frame)
+		return 0;
+
+	// Slot 0 lives at the highest address, so the frame is stored in reverse
+	slot = func->frame + func->framesize - 1;
+	for (i = 0; i < func->numargs; i++, slot--)
+		value_set_type(slot, (byte_t)map_at(func->argTypes, func->args[i]));
+	if (!(func->flags & FUNCTION_FLAG_STATIC))
+	{
+		value_set_type(slot, lb_object);
+		slot--;
+	}
+	for (i = 0; i < func->numlocals; i++, slot--)
+		value_set_type(slot, func->localTypes[i]);
+
+	return 1;
+}
+
+int build_vtable(class_t *clazz)
+{
+	size_t base = clazz->super ? clazz->super->vtablesize : 0;
+	size_t next = base;
+	function_t *func, *overridden;
+	map_iterator_t *mit;
+
+	if (clazz->vtable)
+	{
+		FREE(clazz->vtable);
+		clazz->vtable = NULL;
+	}
+
+	// Overrides reuse the superclass's slot, anything new is appended after it
+	mit = map_create_iterator(clazz->functions);
+	while (mit->node)
+	{
+		func = (function_t *)mit->value;
+		if (func->parentClass == clazz && !(func->flags & FUNCTION_FLAG_STATIC))
+		{
+			overridden = clazz->super ? class_get_function(clazz->super, func->qualifiedName) : NULL;
+			if (overridden && overridden->vtableOwner)
+			{
+				func->vtableIndex = overridden->vtableIndex;
+				func->vtableOwner = overridden->vtableOwner;
+			}
+			else
+			{
+				func->vtableIndex = next++;
+				func->vtableOwner = clazz;
+			}
+		}
+		mit = map_iterator_next(mit);
+	}
+	map_iterator_free(mit);
+
+	clazz->vtablesize = 0;
+	if (next == 0)
+		return 1;
+
+	clazz->vtable = (function_t **)CALLOC(next, sizeof(function_t *));
+	if (!clazz->vtable)
+		return 0;
+	clazz->vtablesize = next;
+	if (base > 0)
+		MEMCPY(clazz->vtable, clazz->super->vtable, base * sizeof(function_t *));
+
+	mit = map_create_iterator(clazz->functions);
+	while (mit->node)
+	{
+		func = (function_t *)mit->value;
+		if (func->parentClass == clazz && func->vtableOwner)
+			clazz->vtable[func->vtableIndex] = func;
+		mit = map_iterator_next(mit);
+	}
+	map_iterator_free(mit);
+
 	return 1;
 }
 
@@ -647,3 +1020,50 @@ const char *class_get_last_error()
 {
 	return NULL;
 }
+
+int read_pool(class_t *clazz, const byte_t *dataStart, byte_t **dataEnd)
+{
+	const byte_t *poolEnd;
+	const byte_t *curr;
+	const byte_t *nul;
+	dword_t poolOffset;
+	dword_t count;
+
+	if ((size_t)(*dataEnd - dataStart) < sizeof(char) + sizeof(unsigned int) + 2 * sizeof(dword_t))
+		return 0;
+
+	poolEnd = *dataEnd - sizeof(dword_t);
+	poolOffset = *((dword_t *)poolEnd);
+	if (poolOffset < sizeof(char) + sizeof(unsigned int) || poolOffset + sizeof(dword_t) > (size_t)(poolEnd - dataStart))
+		return 0;
+
+	curr = dataStart + poolOffset;
+	count = *((dword_t *)curr);
+	curr += sizeof(dword_t);
+	if (count > (size_t)(poolEnd - curr))
+		return 0;
+
+	if (count > 0)
+	{
+		clazz->pool = (char **)MALLOC(count * sizeof(char *));
+		if (!clazz->pool)
+			return 0;
+	}
+
+	for (dword_t i = 0; i < count; i++)
+	{
+		nul = (const byte_t *)memchr(curr, 0, poolEnd - curr);
+		if (!nul)
+		{
+			FREE(clazz->pool);
+			clazz->pool = NULL;
+			return 0;
+		}
+		clazz->pool[i] = (char *)curr;
+		curr = nul + 1;
+	}
+	clazz->poolsize = count;
+
+	*dataEnd = (byte_t *)dataStart + poolOffset;
+	return 1;
+}
@@ -6,13 +6,15 @@
 #include "collection.h"
 #include "value.h"
 #include "debug.h"
+#include "intrinsic.h"
 
 typedef signed long long class_flags_t;
 typedef signed long long function_flags_t;
 
 enum
 {
-	CLASS_FLAG_VIRTUAL = 0x1
+	CLASS_FLAG_VIRTUAL = 0x1,
+	CLASS_FLAG_VERIFIED = 0x2	// The class's bytecode passed verify_class, so the VM may skip checks it proves
 };
 
 enum
@@ -24,12 +26,14 @@ enum
 
 typedef struct function_s function_t;
 typedef struct class_s class_t;
+typedef struct decoded_s decoded_t;
 
 struct function_s
 {
 	const char *name;			// The name of the function
 	const char *qualifiedName;	// The qualified name of the function
 	void *location;				// The location of the function in memory after its declaration
+	size_t bodySize;			// The number of bytes of bytecode at location (version 2+)
 	function_flags_t flags;		// The functions's flags
 	size_t numargs;				// The number of arguments this function takes
 	const char **args;			// The name of each argument in order
@@ -38,6 +42,17 @@ struct function_s
 	size_t argSize;				// The total number of bytes all the arguments will take up
 	size_t references;			// The number of references there are to this function
 	byte_t returnType;			// The return type of the function
+	size_t numlocals;			// The number of locals the function declares (version 2+)
+	byte_t *localTypes;			// The type of each local, in slot order (version 2+)
+	map_t *slots;				// A map from an argument or local name to its frame slot + 1 (version 2+)
+	size_t framesize;			// The number of slots in the function's frame (version 2+)
+	value_t *frame;				// The initial frame, last slot first, copied onto the stack on each call (version 2+)
+	size_t vtableIndex;			// The function's slot in the vtable of every class deriving from vtableOwner
+	class_t *vtableOwner;		// The class which introduced the function's vtable slot, or NULL if static
+	byte_t *nativeArgTypes;		// How each argument is copied into a native call (lb_byte to lb_real8), built when linked
+	intrinsic_t intrinsic;		// The VM handler run in place of a native call, or NULL if there is none
+	size_t numdecoded;			// The number of entries in decoded
+	decoded_t *decoded;			// The body translated by decode_function, or NULL if it runs from its bytecode
 };
 
 struct class_s
@@ -49,9 +64,18 @@ struct class_s
 	byte_t *data;			// The raw data of the class
 	map_t *functions;		// Maps the function names to its location in memory
 	map_t *staticFields;	// Maps the static field name to its value in memory
+	size_t numstatics;		// The number of static fields
+	value_t **statics;		// The static fields in declaration order, indexed by static slot operands
+	size_t vtablesize;		// The number of entries in the vtable
+	function_t **vtable;	// The dynamic functions, with the superclass's slots first
+	size_t poolsize;		// The number of entries in the constant pool (version 3+)
+	char **pool;			// The constant pool entries, which point into the class's data (version 3+)
 	map_t *fields;			// Maps the field name to its offset
+	size_t numrefs;			// The number of fields which hold references
+	size_t *refs;			// The offsets of the fields which hold references, for the garbage collector
 	debug_t *debug;			// A pointer to debug information about this class
 	size_t size;			// Stores the total size this object will allocate
+	unsigned int version;	// The bytecode version the class was compiled with
 };
 
 typedef class_t *(*classloadproc_t)(const char *classname, void *more);
@@ -72,7 +96,8 @@ this class. This is called generally when a superclass is needed.
 class_t *class_load(byte_t *binary, size_t length, int loadSuperclasses, classloadproc_t loadproc, void *more);
 
 /*
-Sets a class' superclass. The class must not already have a superclass.
+Sets a class' superclass. The class must not already have a superclass. The class's vtable is
+rebuilt so that the superclass's functions keep their slots.
 
 clazz and superclass must point to different classes. If they are the same, behavior is undefined.
 
@@ -122,6 +147,20 @@ inline void *class_get_dynamic_field_offset(class_t *clazz, const char *fieldNam
 	return map_at(clazz->fields, fieldName);
 }
 
+/*
+Returns the number of frame slots a function uses. Arguments take the first slots, followed by
+"this" for dynamic functions, followed by the function's locals. Only meaningful for functions
+in classes of version LB_VERSION_SLOTS or later.
+
+@param func The function.
+
+@return The number of frame slots.
+*/
+inline size_t function_slot_count(const function_t *func)
+{
+	return func->numargs + !(func->flags & FUNCTION_FLAG_STATIC) + func->numlocals;
+}
+
 /*
 Frees a class loaded with class_load.
 
@@ -0,0 +1,419 @@
+#include "decode.h"
+
+#include <string.h>
+#include "lb.h"
+#include "vm_compare.h"
+#include "mem_debug.h"
+
+#define IS_REFERENCE_TYPE(type) ((type) >= lb_object && (type) <= lb_objectarray)
+#define IS_INT32_TYPE(type) ((type) == lb_int || (type) == lb_uint)
+
+static void decode_command(const function_t *func, decoded_t *entry, const byte_t *end);
+static int decode_branch(const function_t *func, decoded_t *entry, const byte_t *end);
+static int decode_jump(decoded_t *entry, const byte_t *end);
+static int decode_arithmetic(const function_t *func, decoded_t *entry, const byte_t *end);
+static int decode_set(const function_t *func, decoded_t *entry, const byte_t *end);
+static int decode_move(const function_t *func, decoded_t *entry, const byte_t *end);
+static int decode_declare(const function_t *func, decoded_t *entry, const byte_t *end);
+static void link_targets(function_t *func);
+
+static int read_value(const function_t *func, byte_t **loc, decoded_operand_t *operand);
+static int read_slot(const function_t *func, byte_t **loc, word_t *slot, byte_t *type);
+static byte_t frame_type(const function_t *func, word_t slot);
+
+void decode_function(function_t *func, const byte_t *boundaries)
+{
+	byte_t *start = (byte_t *)func->location;
+	decoded_t *entries, *entry;
+	size_t count = 0;
+
+	for (size_t offset = 0; offset < func->bodySize; offset++)
+	{
+		if (boundaries[offset / 8] & (1 << (offset % 8)))
+			count++;
+	}
+
+	entries = (decoded_t *)CALLOC(count, sizeof(decoded_t));
+	if (!entries)
+		return;
+
+	entry = entries;
+	for (size_t offset = 0; offset < func->bodySize; offset++)
+	{
+		if (boundaries[offset / 8] & (1 << (offset % 8)))
+		{
+			if (entry != entries)
+				(entry - 1)->next = start + offset;
+			entry->rip = start + offset;
+			entry++;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+		decode_command(func, entries + i, entries[i].next ? entries[i].next : start + func->bodySize);
+
+	// Decoded commands continue to the entry after them, which the last command does not have
+	if (count)
+		entries[count - 1].op = *entries[count - 1].rip;
+
+	func->decoded = entries;
+	func->numdecoded = count;
+	link_targets(func);
+}
+
+decoded_t *decode_find(const function_t *func, const byte_t *rip)
+{
+	size_t low = 0, high = func->numdecoded, mid;
+
+	while (low < high)
+	{
+		mid = low + (high - low) / 2;
+		if (func->decoded[mid].rip == rip)
+			return func->decoded + mid;
+		if (func->decoded[mid].rip < rip)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return NULL;
+}
+
+void decode_command(const function_t *func, decoded_t *entry, const byte_t *end)
+{
+	int decoded;
+
+	switch (*entry->rip)
+	{
+	case lb_if:
+	case lb_while:
+		decoded = decode_branch(func, entry, end);
+		break;
+	case lb_end:
+	case lb_else:
+	case lb_elif:
+	case lb_case:
+	case lb_default:
+		decoded = decode_jump(entry, end);
+		break;
+	case lb_add:
+	case lb_sub:
+		decoded = decode_arithmetic(func, entry, end);
+		break;
+	case lb_setd:
+	case lb_setr4:
+	case lb_setq:
+	case lb_setr8:
+		decoded = decode_set(func, entry, end);
+		break;
+	case lb_setv:
+		decoded = decode_move(func, entry, end);
+		break;
+	default:
+		if (*entry->rip >= lb_char && *entry->rip <= lb_objectarray)
+			decoded = decode_declare(func, entry, end);
+		else
+			decoded = 0;
+		break;
+	}
+
+	// Anything else runs through the handler of its bytecode command
+	if (!decoded)
+		entry->op = *entry->rip;
+}
+
+int decode_branch(const function_t *func, decoded_t *entry, const byte_t *end)
+{
+	byte_t *loc = entry->rip + 1;
+	byte_t comparator;
+
+	if (*loc != lb_two)
+		return 0;
+	loc++;
+
+	if (!read_value(func, &loc, &entry->lhs))
+		return 0;
+
+	comparator = *loc;
+	loc++;
+	switch (comparator)
+	{
+	case lb_equal:
+		entry->cmp = compare_equal;
+		break;
+	case lb_nequal:
+		entry->cmp = compare_less | compare_greater;
+		break;
+	case lb_less:
+		entry->cmp = compare_less;
+		break;
+	case lb_lequal:
+		entry->cmp = compare_less | compare_equal;
+		break;
+	case lb_greater:
+		entry->cmp = compare_greater;
+		break;
+	case lb_gequal:
+		entry->cmp = compare_greater | compare_equal;
+		break;
+	default:
+		return 0;
+	}
+
+	if (!read_value(func, &loc, &entry->rhs))
+		return 0;
+
+	// The target is resolved to an entry once the whole function is decoded
+	if (loc + sizeof(size_t) != end)
+		return 0;
+
+	entry->op = dop_branch;
+	entry->loop = *entry->rip == lb_while;
+	return 1;
+}
+
+int decode_jump(decoded_t *entry, const byte_t *end)
+{
+	// An elif's entry only covers its jump, since the if after it begins a command of its own
+	if (*entry->rip == lb_case)
+	{
+		if (entry->rip + 1 + sizeof(size_t) + sizeof(qword_t) != end)
+			return 0;
+	}
+	else if (entry->rip + 1 + sizeof(size_t) != end)
+		return 0;
+
+	entry->op = dop_jump;
+	return 1;
+}
+
+int decode_arithmetic(const function_t *func, decoded_t *entry, const byte_t *end)
+{
+	byte_t *loc = entry->rip + 1;
+	byte_t type;
+
+	// The same forms vmm_add and vmm_sub quicken to lb_addi and lb_subi
+	if (!read_slot(func, &loc, &entry->dst, &type) || !IS_INT32_TYPE(type))
+		return 0;
+
+	entry->lhs.kind = decoded_slot;
+	if (!read_slot(func, &loc, &entry->lhs.slot, &entry->lhs.type) || !IS_INT32_TYPE(entry->lhs.type))
+		return 0;
+
+	if (*loc == lb_value)
+	{
+		loc++;
+		entry->rhs.kind = decoded_slot;
+		if (!read_slot(func, &loc, &entry->rhs.slot, &entry->rhs.type) || !IS_INT32_TYPE(entry->rhs.type))
+			return 0;
+	}
+	else if (IS_INT32_TYPE(*loc))
+	{
+		entry->rhs.kind = decoded_imm;
+		entry->rhs.type = *loc;
+		entry->rhs.imm = *((luint *)(loc + 1));
+		loc += 1 + sizeof(luint);
+	}
+	else
+		return 0;
+
+	if (loc != end)
+		return 0;
+
+	entry->op = *entry->rip == lb_add ? dop_add32 : dop_sub32;
+	return 1;
+}
+
+int decode_set(const function_t *func, decoded_t *entry, const byte_t *end)
+{
+	byte_t *loc = entry->rip + 1;
+	byte_t type;
+	size_t width;
+
+	if (!read_slot(func, &loc, &entry->dst, &type))
+		return 0;
+
+	// The literal is copied into the slot as raw bits, whatever the slot's type
+	width = *entry->rip == lb_setd || *entry->rip == lb_setr4 ? sizeof(dword_t) : sizeof(qword_t);
+	if (loc + width != end)
+		return 0;
+	memcpy(&entry->value, loc, width);
+
+	entry->op = width == sizeof(dword_t) ? dop_set32 : dop_set64;
+	return 1;
+}
+
+int decode_move(const function_t *func, decoded_t *entry, const byte_t *end)
+{
+	byte_t *loc = entry->rip + 1;
+	byte_t type;
+
+	if (!read_slot(func, &loc, &entry->dst, &type))
+		return 0;
+
+	entry->lhs.kind = decoded_slot;
+	if (!read_slot(func, &loc, &entry->lhs.slot, &entry->lhs.type) || loc != end)
+		return 0;
+
+	// Between slots of the same type, static_set only copies the value
+	if (type != entry->lhs.type)
+		return 0;
+
+	switch (type)
+	{
+	case lb_int:
+	case lb_uint:
+	case lb_float:
+		entry->op = dop_move32;
+		return 1;
+	case lb_long:
+	case lb_ulong:
+	case lb_double:
+		entry->op = dop_move64;
+		return 1;
+	default:
+		if (!IS_REFERENCE_TYPE(type))
+			return 0;
+		entry->op = dop_move64;
+		return 1;
+	}
+}
+
+int decode_declare(const function_t *func, decoded_t *entry, const byte_t *end)
+{
+	byte_t *loc = entry->rip + 1;
+	byte_t type;
+	value_t val;
+
+	if (!read_slot(func, &loc, &entry->dst, &type) || loc != end)
+		return 0;
+
+	val.flags = 0;
+	value_set_type(&val, *entry->rip);
+	entry->flags = val.flags;
+	entry->op = dop_declare;
+	return 1;
+}
+
+void link_targets(function_t *func)
+{
+	decoded_t *entry;
+	size_t target;
+
+	for (size_t i = 0; i < func->numdecoded; i++)
+	{
+		entry = func->decoded + i;
+
+		// Branches left to their bytecode handler record their target too, so env_run can follow
+		// them there without searching
+		switch (*entry->rip)
+		{
+		case lb_if:
+		case lb_while:
+			if (!entry->next)
+				continue;
+			target = *((size_t *)(entry->next - sizeof(size_t)));
+			break;
+		case lb_end:
+		case lb_else:
+		case lb_elif:
+		case lb_case:
+		case lb_default:
+			target = *((size_t *)(entry->rip + 1));
+			break;
+		default:
+			continue;
+		}
+
+		// Targets are offsets from the class's data, where -1 proceeds to the next command
+		if (target == (size_t)-1)
+			entry->target = entry->next ? entry + 1 : NULL;
+		else
+			entry->target = decode_find(func, func->parentClass->data + target);
+
+		if (!entry->target)
+			entry->op = *entry->rip;
+	}
+}
+
+int read_value(const function_t *func, byte_t **loc, decoded_operand_t *operand)
+{
+	byte_t *curr = *loc;
+
+	// Integers narrower than 32 bits compare as the int they are promoted to
+	operand->kind = decoded_imm;
+	operand->type = lb_int;
+	switch (*curr)
+	{
+	case lb_char:
+		operand->imm = (luint)(lint)*((lchar *)(curr + 1));
+		*loc = curr + 1 + sizeof(lchar);
+		return 1;
+	case lb_uchar:
+		operand->imm = *((luchar *)(curr + 1));
+		*loc = curr + 1 + sizeof(luchar);
+		return 1;
+	case lb_bool:
+		operand->imm = (luint)(lint)*((lbool *)(curr + 1));
+		*loc = curr + 1 + sizeof(lbool);
+		return 1;
+	case lb_short:
+		operand->imm = (luint)(lint)*((lshort *)(curr + 1));
+		*loc = curr + 1 + sizeof(lshort);
+		return 1;
+	case lb_ushort:
+		operand->imm = *((lushort *)(curr + 1));
+		*loc = curr + 1 + sizeof(lushort);
+		return 1;
+	case lb_int:
+	case lb_uint:
+		operand->type = *curr;
+		operand->imm = *((luint *)(curr + 1));
+		*loc = curr + 1 + sizeof(luint);
+		return 1;
+	}
+
+	if (*curr != lb_value)
+		return 0;
+	curr++;
+
+	if (read_slot(func, &curr, &operand->slot, &operand->type))
+	{
+		// A plain slot keeps its type for the whole function
+		if (IS_INT32_TYPE(operand->type))
+		{
+			operand->kind = decoded_slot;
+			*loc = curr;
+			return 1;
+		}
+		if (operand->type < lb_char || operand->type > lb_bool || operand->type == lb_long || operand->type == lb_ulong)
+			return 0;
+		curr = *loc + 1;
+	}
+
+	// Fields, statics, elements and narrower slots are resolved when the command runs, and may turn
+	// out to be another type
+	operand->kind = decoded_operand;
+	operand->type = 0;
+	operand->operand = curr;
+	*loc = lb_skip_operand(curr);
+	return 1;
+}
+
+int read_slot(const function_t *func, byte_t **loc, word_t *slot, byte_t *type)
+{
+	byte_t *curr = *loc;
+
+	if (*curr != lb_slot || curr[1 + sizeof(word_t)] != 0)
+		return 0;
+
+	*slot = *((word_t *)(curr + 1));
+	*type = frame_type(func, *slot);
+	*loc = curr + 1 + sizeof(word_t) + 1;
+	return 1;
+}
+
+byte_t frame_type(const function_t *func, word_t slot)
+{
+	// Verified functions only ever redeclare a slot with the type in the frame template, stored last slot first
+	return value_typeof(func->frame + func->framesize - 1 - slot);
+}
@@ -0,0 +1,82 @@
+#if !defined(DECODE_H)
+#define DECODE_H
+
+#include "class.h"
+
+/*
+Commands which only appear in a function's decoded stream, never in bytecode. They take the
+free opcodes after the casts, so env_run can dispatch them through the same table as bytecode
+commands.
+*/
+enum
+{
+	dop_branch = 0xc0,	// if or while comparing two integers of up to 32 bits, jumping to target when the comparison fails
+	dop_jump,			// end, else, elif, case or default, going to target
+	dop_add32,			// add of 32-bit integer slots, dst = lhs + rhs
+	dop_sub32,			// sub of 32-bit integer slots, dst = lhs - rhs
+	dop_set32,			// setd or setr4 of a plain slot to value
+	dop_set64,			// setq or setr8 of a plain slot to value
+	dop_move32,			// setv between plain slots of the same 32-bit type
+	dop_move64,			// setv between plain slots of the same 64-bit or reference type
+	dop_declare			// Declaration of a slot, resetting it to flags
+};
+
+// Where the value of a decoded operand comes from
+enum
+{
+	decoded_imm,		// A literal stored in the entry
+	decoded_slot,		// A plain frame slot of the type recorded in the entry
+	decoded_operand		// A bytecode operand which is resolved, and its type checked, each time it runs
+};
+
+typedef struct decoded_operand_s decoded_operand_t;
+
+struct decoded_operand_s
+{
+	byte_t kind;		// decoded_imm, decoded_slot or decoded_operand
+	byte_t type;		// lb_int or lb_uint for a literal or slot, or 0 for decoded_operand
+	word_t slot;		// The frame slot, for decoded_slot
+	luint imm;			// The literal, promoted to 32 bits, for decoded_imm
+	byte_t *operand;	// The operand in the function's bytecode, for decoded_operand
+};
+
+struct decoded_s
+{
+	byte_t op;					// A dop_ command, or the bytecode command which runs through its own handler
+	byte_t cmp;					// The compare_less, equal and greater results on which a branch proceeds into its body
+	byte_t loop;				// Whether a branch is a while loop, and so a garbage collection safepoint
+	word_t dst;					// The slot the command writes
+	flags_t flags;				// The flags a declaration resets its slot to
+	qword_t value;				// The literal stored by dop_set32 and dop_set64
+	decoded_operand_t lhs;		// The left side of a branch, or the source of arithmetic and moves
+	decoded_operand_t rhs;		// The right side of a branch or arithmetic
+	byte_t *rip;				// The command in the function's bytecode
+	byte_t *next;				// The bytecode following the command, or NULL if it is the function's last
+	decoded_t *target;			// The entry an if, while, end, else, elif, case or default goes to
+};
+
+/*
+Translates the body of a verified function into an array of decoded entries, one for each
+command, stored in the function's decoded field. Commands whose operands are plain slots or
+literals are resolved once here, and jumps point straight at the entry they land on. All other
+commands keep their bytecode opcode and run through their usual handler.
+
+If memory runs out, the function is left undecoded and runs from its bytecode.
+
+@param func The function to decode. It must have passed verification.
+@param boundaries A bit for each byte of the function's body, set where a command begins.
+*/
+void decode_function(function_t *func, const byte_t *boundaries);
+
+/*
+Finds the decoded entry of a command.
+
+@param func The function the command belongs to.
+@param rip The start of the command in the function's bytecode.
+
+@return The command's entry, or NULL if the function was not decoded or rip does not start one
+of its commands.
+*/
+decoded_t *decode_find(const function_t *func, const byte_t *rip);
+
+#endif
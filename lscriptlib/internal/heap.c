@@ -18,6 +18,8 @@
 #define SIZE_MASK (~((tag_t)0x3))
 #define FIELD_MASK ((tag_t)0x3)
 
+#define WALK_BATCH_SIZE 256
+
 #define GET_BLOCK_SIZE(tag) ((tag_t)((tag)>>2))
 #define SET_BLOCK_SIZE(tagPtr, size) (*tagPtr=(((*tagPtr)&FIELD_MASK)+((size)<<2)))
 
@@ -202,6 +204,89 @@ void hfree(heap_p heap, void *block)
 #endif
 }
 
+void hwalk(heap_p heap, heap_walk_func_t func, void *param)
+{
+#if defined(NO_NATIVE_HEAP_IMPL)
+	tag_t *header = heap->block;
+	tag_t *next;
+	size_t blockSize;
+
+	while (header < heap->end)
+	{
+		blockSize = GET_BLOCK_SIZE(*header);
+		if (!blockSize)
+			break;
+
+		next = header + (blockSize / WORD_SIZE);
+		if (!(*header & ALLOCATED_MASK))
+		{
+			header = next;
+			continue;
+		}
+
+		// Freeing a block merges it with the free blocks around it, so find the next allocated
+		// block while the free blocks' tags are still intact
+		while (next < heap->end && !(*next & ALLOCATED_MASK) && GET_BLOCK_SIZE(*next))
+			next += GET_BLOCK_SIZE(*next) / WORD_SIZE;
+
+		if (func(header + 1, param))
+			hfree(heap, header + 1);
+
+		header = next;
+	}
+#else
+	PROCESS_HEAP_ENTRY entry;
+	void *batch[WALK_BATCH_SIZE];
+	void **dead = batch;
+	void **grown;
+	size_t capacity = WALK_BATCH_SIZE;
+	size_t count;
+	int complete;
+
+	// A native heap can not be changed while it is walked, so dead blocks are freed afterwards.
+	// If the list of dead blocks can not grow, those found so far are freed and the walk starts
+	// over, which visits only the surviving blocks again.
+	do
+	{
+		complete = 1;
+		count = 0;
+
+		HeapLock(heap->handle);
+		entry.lpData = NULL;
+		while (HeapWalk(heap->handle, &entry))
+		{
+			if (!(entry.wFlags & PROCESS_HEAP_ENTRY_BUSY))
+				continue;
+
+			if (count == capacity)
+			{
+				grown = (void **)MALLOC(capacity * 2 * sizeof(void *));
+				if (!grown)
+				{
+					complete = 0;
+					break;
+				}
+				MEMCPY(grown, dead, count * sizeof(void *));
+				if (dead != batch)
+					FREE(dead);
+				dead = grown;
+				capacity *= 2;
+			}
+
+			if (func(entry.lpData, param))
+				dead[count++] = entry.lpData;
+		}
+		HeapUnlock(heap->handle);
+
+		for (size_t i = 0; i < count; i++)
+			HeapFree(heap->handle, 0, dead[i]);
+	} while (!complete);
+
+	if (dead != batch)
+		FREE(dead);
+#endif
+}
+
 #if defined(NO_NATIVE_HEAP_IMPL)
 void coalesce_block(heap_p heap, tag_t *header)
 {
@@ -19,6 +19,16 @@ struct heap_s
 
 typedef heap_t *heap_p;
 
+/*
+Called by hwalk on each allocated block.
+
+@param block The block, as returned by halloc.
+@param param The value passed to hwalk.
+
+@return nonzero if the block should be freed.
+*/
+typedef int(*heap_walk_func_t)(void *block, void *param);
+
 /*
 Creates a new heap with the requested size.
 
@@ -53,4 +63,15 @@ Frees memory allocated with halloc.
 */
 void hfree(heap_p heap, void *block);
 
+/*
+Visits every block allocated on a heap by reading the heap's own block headers. Blocks for
+which func returns nonzero are freed once they have been visited. Each block is visited once,
+but func must not allocate on or free from the heap itself.
+
+@param heap The heap to walk.
+@param func The function to call on each allocated block.
+@param param A value passed to func.
+*/
+void hwalk(heap_p heap, heap_walk_func_t func, void *param);
+
 #endif
\ No newline at end of file
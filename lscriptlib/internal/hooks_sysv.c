@@ -0,0 +1,91 @@
+#include "types.h"
+#include "lb.h"
+
+#if !defined(_WIN32)
+
+#include <string.h>
+
+#define SYSV_INT_REGS 6		// rdi, rsi, rdx, rcx, r8 and r9
+#define SYSV_REAL_REGS 8	// xmm0 to xmm7
+#define SYSV_STACK_ARGS 16	// The most arguments a call passes on the stack
+
+// Under System V, integer and real arguments fill their own registers in order, so a function
+// taking six integers, then eight reals, then the stack arguments as integers, is called with
+// every register and stack slot set however its arguments actually interleave
+#define SYSV_PROC_ARGS \
+	qword_t, qword_t, qword_t, qword_t, qword_t, qword_t, \
+	real8_t, real8_t, real8_t, real8_t, real8_t, real8_t, real8_t, real8_t, \
+	qword_t, qword_t, qword_t, qword_t, qword_t, qword_t, qword_t, qword_t, \
+	qword_t, qword_t, qword_t, qword_t, qword_t, qword_t, qword_t, qword_t
+
+typedef qword_t(*sysv_int_proc_t)(SYSV_PROC_ARGS);
+typedef real4_t(*sysv_real4_proc_t)(SYSV_PROC_ARGS);
+typedef real8_t(*sysv_real8_proc_t)(SYSV_PROC_ARGS);
+
+#define SYSV_CALL_ARGS(i, r, s) \
+	i[0], i[1], i[2], i[3], i[4], i[5], \
+	r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], \
+	s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], \
+	s[8], s[9], s[10], s[11], s[12], s[13], s[14], s[15]
+
+static inline int is_real_arg(size_t index, const byte_t *argTypes)
+{
+	// The environment and class come first and are always pointers
+	return index >= 2 && (argTypes[index - 2] == lb_real4 || argTypes[index - 2] == lb_real8);
+}
+
+int vm_sysv_can_call(size_t argCount, const byte_t *argTypes)
+{
+	size_t ints = 0, reals = 0, stack = 0;
+
+	for (size_t i = 0; i < argCount; i++)
+	{
+		if (is_real_arg(i, argTypes) ? reals++ >= SYSV_REAL_REGS : ints++ >= SYSV_INT_REGS)
+			stack++;
+	}
+
+	return stack <= SYSV_STACK_ARGS;
+}
+
+qword_t vm_call_extern_sysv(size_t argCount, const byte_t *argTypes, const void *args, void *proc, byte_t returnType)
+{
+	qword_t ints[SYSV_INT_REGS] = { 0 };
+	real8_t reals[SYSV_REAL_REGS] = { 0 };
+	qword_t stack[SYSV_STACK_ARGS] = { 0 };
+	size_t numints = 0, numreals = 0, numstack = 0;
+	const qword_t *arg = (const qword_t *)args;
+	qword_t result = 0;
+	real4_t r4;
+	real8_t r8;
+
+	for (size_t i = 0; i < argCount; i++)
+	{
+		// A real4 is read from the low half of its register or stack slot, where it was staged
+		if (is_real_arg(i, argTypes) && numreals < SYSV_REAL_REGS)
+			memcpy(&reals[numreals++], &arg[i], sizeof(qword_t));
+		else if (!is_real_arg(i, argTypes) && numints < SYSV_INT_REGS)
+			ints[numints++] = arg[i];
+		else if (numstack < SYSV_STACK_ARGS)
+			stack[numstack++] = arg[i];
+	}
+
+	// Reals are returned in xmm0 rather than rax
+	switch (returnType)
+	{
+	case lb_float:
+		r4 = ((sysv_real4_proc_t)proc)(SYSV_CALL_ARGS(ints, reals, stack));
+		memcpy(&result, &r4, sizeof(real4_t));
+		break;
+	case lb_double:
+		r8 = ((sysv_real8_proc_t)proc)(SYSV_CALL_ARGS(ints, reals, stack));
+		memcpy(&result, &r8, sizeof(real8_t));
+		break;
+	default:
+		result = ((sysv_int_proc_t)proc)(SYSV_CALL_ARGS(ints, reals, stack));
+		break;
+	}
+
+	return result;
+}
+
+#endif
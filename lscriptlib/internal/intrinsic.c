@@ -0,0 +1,130 @@
+#include "intrinsic.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "vm.h"
+#include "lsystem.h"
+#include "lstring.h"
+
+#define MATH_INTRINSIC(name, type, ret) \
+static int intrinsic_Math_##name(void *envPtr, const byte_t *args) \
+{ \
+	((env_t *)envPtr)->ret = name(*((const type *)args)); \
+	return exception_none; \
+}
+
+typedef struct intrinsic_entry_s intrinsic_entry_t;
+
+struct intrinsic_entry_s
+{
+	const char *className;		// The class declaring the function
+	const char *qualifiedName;	// The qualified name of the function
+	intrinsic_t proc;			// The handler run in place of the native call
+};
+
+MATH_INTRINSIC(round, real8_t, r8ret)
+MATH_INTRINSIC(roundf, real4_t, r4ret)
+MATH_INTRINSIC(floor, real8_t, r8ret)
+MATH_INTRINSIC(floorf, real4_t, r4ret)
+MATH_INTRINSIC(ceil, real8_t, r8ret)
+MATH_INTRINSIC(ceilf, real4_t, r4ret)
+MATH_INTRINSIC(sqrt, real8_t, r8ret)
+MATH_INTRINSIC(sqrtf, real4_t, r4ret)
+MATH_INTRINSIC(cbrt, real8_t, r8ret)
+MATH_INTRINSIC(cbrtf, real4_t, r4ret)
+MATH_INTRINSIC(exp, real8_t, r8ret)
+MATH_INTRINSIC(expf, real4_t, r4ret)
+MATH_INTRINSIC(exp2, real8_t, r8ret)
+MATH_INTRINSIC(exp2f, real4_t, r4ret)
+MATH_INTRINSIC(log, real8_t, r8ret)
+MATH_INTRINSIC(logf, real4_t, r4ret)
+MATH_INTRINSIC(log10, real8_t, r8ret)
+MATH_INTRINSIC(log10f, real4_t, r4ret)
+MATH_INTRINSIC(sin, real8_t, r8ret)
+MATH_INTRINSIC(sinf, real4_t, r4ret)
+MATH_INTRINSIC(cos, real8_t, r8ret)
+MATH_INTRINSIC(cosf, real4_t, r4ret)
+MATH_INTRINSIC(tan, real8_t, r8ret)
+MATH_INTRINSIC(tanf, real4_t, r4ret)
+
+static int intrinsic_System_arraycopy(void *envPtr, const byte_t *args);
+static int intrinsic_String_compare(void *envPtr, const byte_t *args);
+
+static const intrinsic_entry_t intrinsics[] =
+{
+	{ "lscript.lang.Math", "round(D", &intrinsic_Math_round },
+	{ "lscript.lang.Math", "roundf(F", &intrinsic_Math_roundf },
+	{ "lscript.lang.Math", "floor(D", &intrinsic_Math_floor },
+	{ "lscript.lang.Math", "floorf(F", &intrinsic_Math_floorf },
+	{ "lscript.lang.Math", "ceil(D", &intrinsic_Math_ceil },
+	{ "lscript.lang.Math", "ceilf(F", &intrinsic_Math_ceilf },
+	{ "lscript.lang.Math", "sqrt(D", &intrinsic_Math_sqrt },
+	{ "lscript.lang.Math", "sqrtf(F", &intrinsic_Math_sqrtf },
+	{ "lscript.lang.Math", "cbrt(D", &intrinsic_Math_cbrt },
+	{ "lscript.lang.Math", "cbrtf(F", &intrinsic_Math_cbrtf },
+	{ "lscript.lang.Math", "exp(D", &intrinsic_Math_exp },
+	{ "lscript.lang.Math", "expf(F", &intrinsic_Math_expf },
+	{ "lscript.lang.Math", "exp2(D", &intrinsic_Math_exp2 },
+	{ "lscript.lang.Math", "exp2f(F", &intrinsic_Math_exp2f },
+	{ "lscript.lang.Math", "log(D", &intrinsic_Math_log },
+	{ "lscript.lang.Math", "logf(F", &intrinsic_Math_logf },
+	{ "lscript.lang.Math", "log10(D", &intrinsic_Math_log10 },
+	{ "lscript.lang.Math", "log10f(F", &intrinsic_Math_log10f },
+	{ "lscript.lang.Math", "sin(D", &intrinsic_Math_sin },
+	{ "lscript.lang.Math", "sinf(F", &intrinsic_Math_sinf },
+	{ "lscript.lang.Math", "cos(D", &intrinsic_Math_cos },
+	{ "lscript.lang.Math", "cosf(F", &intrinsic_Math_cosf },
+	{ "lscript.lang.Math", "tan(D", &intrinsic_Math_tan },
+	{ "lscript.lang.Math", "tanf(F", &intrinsic_Math_tanf },
+	{ "lscript.lang.System", "arraycopy(Llscript.lang.Object;iLlscript.lang.Object;ii", &intrinsic_System_arraycopy },
+	{ "lscript.lang.String", "compare(Llscript.lang.String;Llscript.lang.String;", &intrinsic_String_compare },
+	{ NULL, NULL, NULL }
+};
+
+intrinsic_t intrinsic_find(const char *className, const char *qualifiedName)
+{
+	const intrinsic_entry_t *entry;
+
+	for (entry = intrinsics; entry->className; entry++)
+	{
+		if (!strcmp(entry->className, className) && !strcmp(entry->qualifiedName, qualifiedName))
+			return entry->proc;
+	}
+
+	return NULL;
+}
+
+int intrinsic_System_arraycopy(void *envPtr, const byte_t *args)
+{
+	env_t *env = (env_t *)envPtr;
+	lobject dst, src;
+	luint dstOff, srcOff, len;
+
+	dst = *((const lobject *)args);
+	args += sizeof(lobject);
+	dstOff = *((const luint *)args);
+	args += sizeof(luint);
+	src = *((const lobject *)args);
+	args += sizeof(lobject);
+	srcOff = *((const luint *)args);
+	args += sizeof(luint);
+	len = *((const luint *)args);
+
+	// The checks and the copy are the native's own, so exceptions are raised exactly as they would be
+	env->vret = lscript_lang_System_arraycopy((LEnv)env, NULL, dst, dstOff, src, srcOff, len);
+	return env->exception;
+}
+
+int intrinsic_String_compare(void *envPtr, const byte_t *args)
+{
+	env_t *env = (env_t *)envPtr;
+	lobject a, b;
+
+	a = *((const lobject *)args);
+	args += sizeof(lobject);
+	b = *((const lobject *)args);
+
+	env->dret = (dword_t)lscript_lang_String_compare((LEnv)env, NULL, a, b);
+	return env->exception;
+}
@@ -0,0 +1,27 @@
+#if !defined(INTRINSIC_H)
+#define INTRINSIC_H
+
+#include "types.h"
+
+/*
+A VM handler which runs a native function in place of the native call. It reads the function's
+arguments directly from the packed argument list and leaves the return value in the environment.
+
+@param envPtr A pointer to the env_t the function is called in
+@param args The function's arguments, packed in declaration order
+
+@return Any exception raised by the function, or exception_none if there was none raised.
+*/
+typedef int(*intrinsic_t)(void *envPtr, const byte_t *args);
+
+/*
+Finds the intrinsic which implements a native function.
+
+@param className The fully qualified name of the class declaring the function
+@param qualifiedName The qualified name of the function
+
+@return The intrinsic, or NULL if the function has none and must be called natively.
+*/
+intrinsic_t intrinsic_find(const char *className, const char *qualifiedName);
+
+#endif
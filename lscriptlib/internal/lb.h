@@ -1,6 +1,24 @@
 #if !defined(LB_H)
 #define LB_H
 
+#include <string.h>
+
+#define LB_VERSION_NAMED 1	// Variables are referenced by name
+#define LB_VERSION_SLOTS 2	// Locals and arguments are referenced by frame slot
+#define LB_VERSION_POOL 3	// Called function names are stored once in a constant pool (see below)
+
+/*
+Version 3+ classes end with a constant pool: a dword entry count, the entries as NUL-terminated
+strings, and finally a dword holding the offset of the pool from the start of the class. Calls
+refer to their function name by its 2-byte index into the pool.
+
+A switch command is followed by the operand it switches on, then either lb_dense with the 8-byte
+lowest case, a dword entry count, the default target and one target per entry, or lb_sparse with
+a dword entry count, the default target and the entries as 8-byte case and target pairs. Targets
+are offsets from the start of the class. Cases do not fall through: reaching the next case or
+default label jumps to the switch's end.
+*/
+
 enum
 {
 	lb_noop = 0x00,
@@ -12,6 +30,12 @@ enum
 	lb_using,			// Not used in bytecode
 	lb_constructor,		// Not used in bytecode
 
+	lb_slot = 0x08,		// Frame slot operand (version 2+): 2-byte slot index followed by a field path
+	lb_static_slot,		// Static field operand (version 2+): 2-byte index into the class's statics followed by a field path
+	lb_element,			// Array element operand (version 2+): the array operand followed by the index operand
+	lb_index,			// Literal array index (version 2+): 4-byte unsigned index
+	lb_element_unchecked,	// lb_element whose index is a plain slot proven in bounds, only produced by the VM when verifying a class
+
 	lb_function = 0x10,
 	lb_static,
 	lb_dynamic,
@@ -96,6 +120,8 @@ enum
 	lb_lsh,
 	lb_rsh,
 	lb_not,
+	lb_addi,			// add on 32-bit integer slots, only produced by the VM when quickening lb_add
+	lb_subi,			// sub on 32-bit integer slots, only produced by the VM when quickening lb_sub
 
 	lb_if = 0x90,
 	lb_elif,
@@ -103,6 +129,13 @@ enum
 	lb_while,
 	lb_end,
 	lb_jmp,
+	lb_ifi,				// if comparing two 32-bit integers, only produced by the VM when quickening lb_if
+	lb_whilei,			// while comparing two 32-bit integers, only produced by the VM when quickening lb_while
+	lb_switch,			// Multi-way branch on an integer operand through a jump table (see below)
+	lb_case,			// Case label of a switch: an 8-byte exit offset followed by the 8-byte case value
+	lb_default,			// Default label of a switch: an 8-byte exit offset
+	lb_dense,			// Switch table indexed by the value minus the lowest case
+	lb_sparse,			// Switch table of (case, target) pairs in ascending case order
 
 	lb_equal = 0xa0,
 	lb_nequal,
@@ -130,5 +163,31 @@ enum
 	lb_debug = 0xff
 };
 
+/*
+Finds the end of an operand in bytecode.
+
+@param loc The start of the operand.
+
+@return The byte following the operand.
+*/
+inline unsigned char *lb_skip_operand(unsigned char *loc)
+{
+	switch (*loc)
+	{
+	case lb_element:
+	case lb_element_unchecked:
+		loc = lb_skip_operand(loc + 1); // The array
+		if (*loc == lb_index)
+			return loc + 1 + sizeof(unsigned int);
+		return lb_skip_operand(loc); // The index
+	case lb_slot:
+	case lb_static_slot:
+		loc += 1 + sizeof(unsigned short); // Slot index, followed by the field path
+		return loc + strlen((const char *)loc) + 1;
+	default:
+		return loc + strlen((const char *)loc) + 1;
+	}
+}
+
 #endif
 
@@ -13,6 +13,7 @@ struct vm_args_s
 {
 	size_t heapSize;
 	size_t stackSize;
+	size_t gcThreshold;
 	vm_flags_t flags;
 	const char *const *argv;
 	int argc;
@@ -50,7 +51,7 @@ LEXPORT LVM LCALL ls_create_vm(int argc, const char *const argv[], void *lsAPILi
 	vm_args_t args;
 	if (gCurrentVM || !parse_arguments(argc, argv, &args))
 		return NULL;
-	vm_t *vm = vm_create(args.heapSize, args.stackSize, lsAPILib, args.flags, MAX_PATHS, args.paths, stdio);
+	vm_t *vm = vm_create(args.heapSize, args.stackSize, args.gcThreshold, lsAPILib, args.flags, MAX_PATHS, args.paths, stdio);
 	free_arg_struct(&args);
 	return gCurrentVM = vm;
 }
@@ -60,6 +61,12 @@ LEXPORT lint LCALL ls_start_vm(int argc, const char *const argv[], void **thread
 	int result;
 	
 	result = vm_start(gCurrentVM, threadHandle != NULL, argc, argv);
+	if (!result)
+	{
+		// vm_start frees the VM when it fails
+		gCurrentVM = NULL;
+		return result;
+	}
 	if (threadHandle)
 		*threadHandle = gCurrentVM->hVMThread;
 	if (threadID)
@@ -72,7 +79,7 @@ LEXPORT LVM LCALL ls_create_and_start_vm(int argc, const char *const argv[], voi
 	vm_args_t args;
 	if (gCurrentVM || !parse_arguments(argc, argv, &args))
 		return NULL;
-	vm_t *vm = vm_create(args.heapSize, args.stackSize, lsAPILib, args.flags, MAX_PATHS, args.paths, stdio);
+	vm_t *vm = vm_create(args.heapSize, args.stackSize, args.gcThreshold, lsAPILib, args.flags, MAX_PATHS, args.paths, stdio);
 	free_arg_struct(&args);
 	gCurrentVM = vm;
 	if (!gCurrentVM)
@@ -318,6 +325,7 @@ int parse_arguments(int argc, const char *const argv[], vm_args_t *argStruct)
 
 	argStruct->heapSize = DEFAULT_HEAP_SIZE;
 	argStruct->stackSize = DEFAULT_STACK_SIZE;
+	argStruct->gcThreshold = DEFAULT_GC_THRESHOLD;
 	for (int i = 0; i < argc; i++)
 	{
 		if (equals_ignore_case("-version", argv[i]))
@@ -344,6 +352,24 @@ int parse_arguments(int argc, const char *const argv[], vm_args_t *argStruct)
 		{
 			argStruct->flags |= vm_flag_verbose_errors;
 		}
+		else if (equals_ignore_case("-aot", argv[i]))
+		{
+			argStruct->flags |= vm_flag_aot;
+		}
+		else if (equals_ignore_case("-nodecode", argv[i]))
+		{
+			argStruct->flags |= vm_flag_no_decode;
+		}
+		else if (equals_ignore_case("-time", argv[i]))
+		{
+			argStruct->flags |= vm_flag_time;
+		}
+		else if (equals_ignore_case("-jit", argv[i]))
+		{
+			// There is no JIT compiler to enable, so the option is refused rather than ignored
+			printf("-jit is not supported: this VM has no JIT compiler and runs every function in the interpreter.\n");
+			return 0;
+		}
 		else if (equals_ignore_case("-path", argv[i]))
 		{
 			i++;
@@ -415,6 +441,35 @@ int parse_arguments(int argc, const char *const argv[], vm_args_t *argStruct)
 				return 0;
 			}
 		}
+		else if (equals_ignore_case("-gcthreshold", argv[i]))
+		{
+			i++;
+			if (i < argc)
+			{
+				switch (argv[i][0])
+				{
+				case 'k':
+				case 'K':
+					argStruct->gcThreshold = KB_TO_B(atoi(argv[i] + 1));
+					break;
+				case 'm':
+				case 'M':
+					argStruct->gcThreshold = MB_TO_B(atoi(argv[i] + 1));
+					break;
+				case 'g':
+				case 'G':
+					argStruct->gcThreshold = GB_TO_B(atoi(argv[i] + 1));
+					break;
+				default:
+					argStruct->gcThreshold = atoi(argv[i]);
+				}
+			}
+			else
+			{
+				print_help();
+				return 0;
+			}
+		}
 		else
 		{
 			argStruct->argc = argc - i;
@@ -449,6 +504,12 @@ void print_help()
 	printf("  -nodebug      Disables loading of debugging symbols.\n");
 	printf("  -verr         Enables only verbose error output. Has no effect if\n");
 	printf("                -verbose is specified.\n");
+	printf("  -aot          Runs static functions exported by loaded libraries\n");
+	printf("                in place of their bytecode.\n");
+	printf("  -nodecode     Runs verified functions from their bytecode rather\n");
+	printf("                than decoding them when their class is loaded.\n");
+	printf("  -time         Prints how long the main function ran and how many\n");
+	printf("                commands it executed per second.\n");
 	printf("  -path <path>  Adds <path> to the claspath.\n");
 	printf("  -heaps [<bytes>|K<kibibytes>|M<mebibytes>|G<gibibytes>]\n");
 	printf("                Specifies the heap size, in bytes, kibibytes,\n");
@@ -456,4 +517,7 @@ void print_help()
 	printf("  -stacks [<bytes>|K<kibibytes>|M<mebibytes>|G<gibibytes>]\n");
 	printf("                Specifies the stack size per thread, in bytes,\n");
 	printf("                kibiytes, mebibytes, or gibibytes.\n");
+	printf("  -gcthreshold [<bytes>|K<kibibytes>|M<mebibytes>|G<gibibytes>]\n");
+	printf("                Specifies how much may be allocated before garbage is\n");
+	printf("                collected. 0 disables automatic collection.\n");
 }
@@ -0,0 +1,36 @@
+#include "lstring.h"
+
+#include <string.h>
+
+#include "vm.h"
+
+LNIFUNC lint LNICALL lscript_lang_String_compare(LEnv venv, lclass vclazz, lobject a, lobject b)
+{
+	env_t *env = (env_t *)venv;
+	array_t *achars, *bchars;
+	luint length;
+	int result;
+
+	if (!a || !b)
+	{
+		env_raise_exception(env, exception_null_dereference, a ? "compare b" : "compare a");
+		return 0;
+	}
+
+	achars = (array_t *)object_get_object((object_t *)a, "chars");
+	bchars = (array_t *)object_get_object((object_t *)b, "chars");
+	if (!achars || !bchars)
+	{
+		env_raise_exception(env, exception_null_dereference, "chars");
+		return 0;
+	}
+
+	// Chars are compared as unsigned bytes, and a string which runs out first is the lesser
+	length = achars->length < bchars->length ? achars->length : bchars->length;
+	result = memcmp(&achars->data, &bchars->data, length);
+	if (result)
+		return result < 0 ? -1 : 1;
+	if (achars->length != bchars->length)
+		return achars->length < bchars->length ? -1 : 1;
+	return 0;
+}
@@ -0,0 +1,8 @@
+#if !defined(LSTRING_H)
+#define LSTRING_H
+
+#include "../lscript.h"
+
+LNIFUNC lint LNICALL lscript_lang_String_compare(LEnv venv, lclass vclazz, lobject a, lobject b);
+
+#endif
@@ -95,5 +95,11 @@ LNIFUNC lobject LNICALL lscript_lang_System_arraycopy(LEnv venv, lclass vclazz,
 	byte_t *srcdata = (byte_t *)&srcarr->data;
 	memcpy(dstdata + (elemsize * dstOff), srcdata + (elemsize * srcOff), copylen);
 
+	if (dsttype == lb_object)
+	{
+		for (luint i = 0; i < len; i++)
+			manager_write_barrier(env->vm->manager, (void **)array_get_data(dstarr, dstOff + i, sizeof(lobject)));
+	}
+
 	return dst;
 }
@@ -4,11 +4,52 @@
 
 #include "mem_debug.h"
 
-#define MARKED_MASK 0x1
+#define MARK_GRANULE 8				// Every block halloc returns is aligned to at least this many bytes
+#define INITIAL_MARK_STACK_SIZE 256
+#if !defined(MARK_STACK_LIMIT)
+#define MARK_STACK_LIMIT ((size_t)-1)	// The most references the mark stack may hold, lowered to test the rescan when it overflows
+#endif
+#define INITIAL_REMEMBERED_SIZE 256
+#define NURSERY_SIZE (4 * 1024 * 1024)			// The size of the young generation, in bytes
+#define LARGE_OBJECT_SIZE (NURSERY_SIZE / 16)	// Objects at least this large are allocated on the heap directly
 
-static void explore_value(value_t *value);
+#define ALIGN_GRANULE(size) (((size) + MARK_GRANULE - 1) & ~(size_t)(MARK_GRANULE - 1))
 
-manager_t *manager_create(size_t heapsize)
+#define FORWARDED_MASK 0x1	// Set in the manager flags of a young object once it has been moved onto the heap
+
+enum
+{
+	collect_none,			// No collection is running
+	collect_mark,			// Marking everything reachable, young or old
+	collect_trace_young,	// Marking only the young objects which are reachable
+	collect_update_young	// Pointing every slot which held a young object at its new address
+};
+
+static void *alloc_block(manager_t *manager, size_t size);
+static int collect_young(manager_t *manager, manager_roots_func_t roots, void *param);
+static void collect_heap(manager_t *manager, manager_roots_func_t roots, void *param);
+static void visit_roots(manager_t *manager, manager_roots_func_t roots, void *param);
+static int promote_survivors(manager_t *manager);
+static void undo_promotion(manager_t *manager, byte_t *end);
+static void rescan_young(manager_t *manager);
+static inline size_t find_remembered(manager_t *manager, void **slot);
+static int grow_remembered(manager_t *manager);
+static void clear_remembered(manager_t *manager);
+static inline int is_young(manager_t *manager, void *reference);
+static inline value_t *forwarded(value_t *value);
+static int prepare_mark_bits(manager_t *manager);
+static inline int is_marked(manager_t *manager, value_t *value);
+static void push_reference(manager_t *manager, value_t *value);
+static void scan_reference(manager_t *manager, value_t *value);
+static void drain_mark_stack(manager_t *manager);
+static int scan_block(void *block, void *param);
+static int rescan_block(void *block, void *param);
+static int sweep_block(void *block, void *param);
+static void note_allocation(manager_t *manager, void *block, size_t size);
+static size_t reference_size(value_t *value);
+static unsigned int array_element_size(byte_t type);
+
+manager_t *manager_create(size_t heapsize, size_t threshold)
 {
 	manager_t *manager = (manager_t *)MALLOC(sizeof(manager_t));
 	if (!manager)
@@ -21,24 +62,65 @@ manager_t *manager_create(size_t heapsize)
 		return NULL;
 	}
 
-	manager->refs = list_create();
-	if (!manager->refs)
-	{
-		free_heap(manager->heap);
-		FREE(manager);
-		return NULL;
-	}
-	manager->refs->data = (void *)0xbaddcafebaddcafe;
-
 	manager->strongRefs = list_create();
 	if (!manager->strongRefs)
 	{
-		list_free(manager->refs, 0);
 		free_heap(manager->heap);
 		FREE(manager);
 		return NULL;
 	}
-	manager->refs->data = (void *)0xbaddcafebaddcafe;
+	manager->strongRefs->data = (void *)0xbaddcafebaddcafe;
+
+	manager->live = 0;
+	manager->allocated = 0;
+	manager->threshold = threshold;
+	manager->limit = threshold;
+	manager->collectRequested = 0;
+	manager->collecting = collect_none;
+
+	// Objects only move when garbage is collected automatically, so without a threshold
+	// every object goes straight to the heap. Without memory for the young generation,
+	// collections still work, they just trace the whole heap each time.
+	manager->nursery = NULL;
+	manager->nurseryBits = NULL;
+	manager->nurserySize = 0;
+	if (threshold)
+	{
+		manager->nursery = (byte_t *)MALLOC(NURSERY_SIZE);
+		manager->nurseryBits = (byte_t *)MALLOC(NURSERY_SIZE / MARK_GRANULE / 8);
+		if (manager->nursery && manager->nurseryBits)
+			manager->nurserySize = NURSERY_SIZE;
+		else
+		{
+			if (manager->nursery)
+				FREE(manager->nursery);
+			if (manager->nurseryBits)
+				FREE(manager->nurseryBits);
+			manager->nursery = NULL;
+			manager->nurseryBits = NULL;
+		}
+	}
+	manager->nurseryTop = manager->nursery;
+	manager->nurseryLimit = manager->nursery + manager->nurserySize;
+
+	manager->remembered = NULL;
+	manager->rememberedSize = 0;
+	manager->rememberedCapacity = 0;
+	manager->rememberOverflow = 0;
+
+	manager->promoted = 0;
+	manager->freed = 0;
+
+	manager->lowest = SIZE_MAX;
+	manager->highest = 0;
+	manager->end = 0;
+	manager->markBase = 0;
+	manager->markBits = NULL;
+	manager->markBitsSize = 0;
+	manager->markStack = NULL;
+	manager->markStackSize = 0;
+	manager->markStackCapacity = 0;
+	manager->markOverflow = 0;
 
 	return manager;
 }
@@ -46,52 +128,27 @@ manager_t *manager_create(size_t heapsize)
 object_t *manager_alloc_object(manager_t *manager, class_t *clazz)
 {
 	size_t size = sizeof(value_t) + clazz->size;
-	value_t *value = (value_t *)halloc(manager->heap, size);
+	value_t *value = (value_t *)alloc_block(manager, size);
 	if (!value)
 		return NULL;
 	value->flags = 0;
 	value_set_type(value, lb_object);
 	value->ovalue = clazz;
 	memset((char *)&value->ovalue + sizeof(lobject), 0, clazz->size);
-	list_insert(manager->refs, value);
 	return (object_t *)value;
 }
 
 array_t *manager_alloc_array(manager_t *manager, byte_t type, unsigned int length)
 {
-	unsigned int elemSize;
-	switch (type)
-	{
-	case lb_chararray:
-	case lb_uchararray:
-	case lb_boolarray:
-		elemSize = sizeof(lchar);
-		break;
-	case lb_shortarray:
-	case lb_ushortarray:
-		elemSize = sizeof(lshort);
-		break;
-	case lb_intarray:
-	case lb_uintarray:
-	case lb_floatarray:
-		elemSize = sizeof(lint);
-		break;
-	case lb_longarray:
-	case lb_ulongarray:
-	case lb_doublearray:
-	case lb_objectarray:
-		elemSize = sizeof(llong);
-		break;
-	default:
+	unsigned int elemSize = array_element_size(type);
+	if (!elemSize)
 		return NULL;
-		break;
-	}
 	unsigned int payloadSize = length * elemSize;
 
 	// sizeof(value_t) accounts for flags, length, and dummy fields in array_t
 	unsigned int totalSize = payloadSize + sizeof(value_t);
 
-	array_t *array = (array_t *)halloc(manager->heap, totalSize);
+	array_t *array = (array_t *)alloc_block(manager, totalSize);
 	if (!array)
 		return NULL;
 
@@ -101,7 +158,6 @@ array_t *manager_alloc_array(manager_t *manager, byte_t type, unsigned int lengt
 	array->dummy = 0;
 
 	memset(&array->data, 0, payloadSize);
-	list_insert(manager->refs, array);
 
 	return array;
 }
@@ -144,123 +200,568 @@ void manager_destroy_strong_reference(manager_t *manager, reference_t *reference
 	}
 }
 
-void manager_gc(manager_t *manager, map_t *visibleSet)
+void manager_mark(manager_t *manager, void **reference)
 {
-	map_iterator_t *mit = map_create_iterator(visibleSet);
+	value_t *value = (value_t *)*reference;
+
+	switch (manager->collecting)
+	{
+	case collect_mark:
+		push_reference(manager, value);
+		break;
+	case collect_trace_young:
+		if (is_young(manager, value))
+			push_reference(manager, value);
+		break;
+	case collect_update_young:
+		if (is_young(manager, value) && (*value_manager_flags(value) & FORWARDED_MASK))
+			*reference = forwarded(value);
+		break;
+	}
+}
+
+void manager_remember(manager_t *manager, void **slot)
+{
+	size_t index;
+
+	if (manager->rememberOverflow)
+		return;
+
+	// Keeping the set at most half full keeps probes short
+	if ((manager->rememberedSize + 1) * 2 > manager->rememberedCapacity && !grow_remembered(manager))
+	{
+		// The next collection scans the whole heap for young references instead
+		manager->rememberOverflow = 1;
+		return;
+	}
 
-	// Explore each value in the visible set and mark any reachable objects
-	while (mit->node)
+	index = find_remembered(manager, slot);
+	if (!manager->remembered[index])
 	{
-		explore_value((value_t *)mit->key);
+		manager->remembered[index] = slot;
+		manager->rememberedSize++;
+	}
+}
+
+void manager_gc(manager_t *manager, manager_roots_func_t roots, void *param, int full)
+{
+	manager->promoted = 0;
+	manager->freed = 0;
 
-		mit = map_iterator_next(mit);
+	if (!collect_young(manager, roots, param))
+	{
+		// The survivors did not fit on the heap, so free what is dead there and try again. If they
+		// still do not fit, the young generation stays full and objects are allocated on the heap.
+		collect_heap(manager, roots, param);
+		collect_young(manager, roots, param);
 	}
+	else if (full || manager->allocated >= manager->limit)
+		collect_heap(manager, roots, param);
 
-	map_iterator_free(mit);
+	manager->collectRequested = 0;
+}
 
-	// Explore each value having a strong reference to it and mark any reachable objects
-	list_t *curr = manager->strongRefs->next;
+void manager_free(manager_t *manager)
+{
+	if (manager)
+	{
+		list_free(manager->strongRefs, 0);
+		free_heap(manager->heap);
+		if (manager->nursery)
+			FREE(manager->nursery);
+		if (manager->nurseryBits)
+			FREE(manager->nurseryBits);
+		if (manager->remembered)
+			FREE(manager->remembered);
+		if (manager->markBits)
+			FREE(manager->markBits);
+		if (manager->markStack)
+			FREE(manager->markStack);
+		FREE(manager);
+	}
+}
+
+void *alloc_block(manager_t *manager, size_t size)
+{
+	size_t alignedSize = ALIGN_GRANULE(size);
+	void *block;
+
+	if (manager->nursery && size < LARGE_OBJECT_SIZE)
+	{
+		if (manager->nurseryTop + alignedSize <= manager->nurseryLimit)
+		{
+			block = manager->nurseryTop;
+			manager->nurseryTop += alignedSize;
+			return block;
+		}
+
+		// Once full, the young generation stays closed until the next collection. Code which links
+		// objects it has just allocated relies on this: an object allocated after an old one is
+		// never young, so storing it in the old one needs no write barrier.
+		manager->nurseryLimit = manager->nurseryTop;
+		manager->collectRequested = 1;
+	}
+
+	block = halloc(manager->heap, size);
+	if (block)
+		note_allocation(manager, block, size);
+	return block;
+}
+
+int collect_young(manager_t *manager, manager_roots_func_t roots, void *param)
+{
+	size_t used;
+	size_t size;
+	byte_t *curr;
+	value_t *value;
+
+	if (!manager->nursery || manager->nurseryTop == manager->nursery)
+		return 1;
+
+	used = manager->nurseryTop - manager->nursery;
+
+	// Only the young objects reachable from roots, strong references and remembered slots live
+	MEMSET(manager->nurseryBits, 0, (used / MARK_GRANULE + 7) / 8);
+	manager->collecting = collect_trace_young;
+	manager->markOverflow = 0;
+	visit_roots(manager, roots, param);
+	drain_mark_stack(manager);
+	while (manager->markOverflow)
+	{
+		manager->markOverflow = 0;
+		rescan_young(manager);
+	}
+
+	if (!promote_survivors(manager))
+	{
+		manager->collecting = collect_none;
+		return 0;
+	}
+
+	// Every slot which can hold a survivor is visited again, now to point it at the copy
+	manager->collecting = collect_update_young;
+	visit_roots(manager, roots, param);
+
+	for (curr = manager->nursery; curr < manager->nurseryTop; curr += ALIGN_GRANULE(size))
+	{
+		value = (value_t *)curr;
+		if (!(*value_manager_flags(value) & FORWARDED_MASK))
+		{
+			size = reference_size(value);
+			continue;
+		}
+
+		// The copy holds the only intact class or length, and its fields may point at other survivors
+		value = forwarded(value);
+		size = reference_size(value);
+		scan_reference(manager, value);
+	}
+
+	manager->freed += used - manager->promoted;
+	manager->nurseryTop = manager->nursery;
+	manager->nurseryLimit = manager->nursery + manager->nurserySize;
+	clear_remembered(manager);
+	manager->rememberOverflow = 0;
+	manager->collecting = collect_none;
+	return 1;
+}
+
+void collect_heap(manager_t *manager, manager_roots_func_t roots, void *param)
+{
+	size_t live;
+
+	// Without mark bits every object would look unreachable, so nothing can be collected
+	if (!prepare_mark_bits(manager))
+		return;
+
+	if (manager->nursery)
+		MEMSET(manager->nurseryBits, 0, manager->nurserySize / MARK_GRANULE / 8);
+
+	manager->collecting = collect_mark;
+	manager->markOverflow = 0;
+	visit_roots(manager, roots, param);
+	drain_mark_stack(manager);
+
+	// References which did not fit on the mark stack are marked but unscanned, so rescan every
+	// marked reference until the stack no longer overflows
+	while (manager->markOverflow)
+	{
+		manager->markOverflow = 0;
+		hwalk(manager->heap, rescan_block, manager);
+		rescan_young(manager);
+	}
+
+	// Free any object which was not marked as visible
+	live = manager->live;
+	hwalk(manager->heap, sweep_block, manager);
+	manager->freed += live - manager->live;
+
+	// Collecting more often than the live data grows would make each byte allocated cost more
+	// and more tracing, so the next collection waits for at least as many bytes as survived
+	manager->allocated = 0;
+	manager->limit = manager->live > manager->threshold ? manager->live : manager->threshold;
+
+	// Remembered slots may lie in objects which were just freed, so any young objects left
+	// must be found by scanning the whole heap
+	if (manager->rememberedSize)
+	{
+		clear_remembered(manager);
+		manager->rememberOverflow = 1;
+	}
+
+	manager->collecting = collect_none;
+}
+
+void visit_roots(manager_t *manager, manager_roots_func_t roots, void *param)
+{
+	list_t *curr;
+
+	roots(manager, param);
+
+	curr = manager->strongRefs->next;
 	while (curr)
 	{
-		explore_value((value_t *)((reference_t *)curr->data)->object);
+		manager_mark(manager, (void **)&((reference_t *)curr->data)->object);
 		curr = curr->next;
 	}
 
-	// Free any object which was not marked as visible
-	list_iterator_t *lit = list_create_iterator(manager->refs);
-	while (lit)
+	// A full collection reaches young objects through the heap anyway
+	if (manager->collecting == collect_mark)
+		return;
+
+	for (size_t i = 0; i < manager->rememberedCapacity; i++)
+	{
+		if (manager->remembered[i])
+			manager_mark(manager, manager->remembered[i]);
+	}
+
+	if (manager->rememberOverflow)
+		hwalk(manager->heap, scan_block, manager);
+}
+
+int promote_survivors(manager_t *manager)
+{
+	byte_t *curr;
+	value_t *value;
+	value_t *copy;
+	size_t size;
+	size_t bit;
+
+	for (curr = manager->nursery; curr < manager->nurseryTop; curr += ALIGN_GRANULE(size))
 	{
-		list_t *currNode = lit->node;
-		if (currNode != manager->refs)
+		value = (value_t *)curr;
+		size = reference_size(value);
+
+		bit = (curr - manager->nursery) / MARK_GRANULE;
+		if (!(manager->nurseryBits[bit >> 3] & (1 << (bit & 7))))
+			continue;
+
+		copy = (value_t *)halloc(manager->heap, size);
+		if (!copy)
 		{
-			value_t *value = (value_t *)currNode->data;
-			unsigned char *flags = value_manager_flags(value);
-			if (!(*flags & MARKED_MASK))
-			{
-				list_t *prevNode, *nextNode;
+			undo_promotion(manager, curr);
+			return 0;
+		}
+		MEMCPY(copy, value, size);
+		note_allocation(manager, copy, size);
+		manager->promoted += size;
 
-				prevNode = currNode->prev;
-				nextNode = currNode->next;
+		// The original is dead now, so its class or length can hold where it went
+		*value_manager_flags(value) |= FORWARDED_MASK;
+		*((value_t **)&value->ovalue) = copy;
+	}
 
-				lit = list_iterator_next(lit);
+	return 1;
+}
 
-				if (prevNode)
-					prevNode->next = nextNode;
+void undo_promotion(manager_t *manager, byte_t *end)
+{
+	byte_t *curr;
+	value_t *value;
+	value_t *copy;
+	size_t size;
 
-				if (nextNode)
-					nextNode->prev = prevNode;
+	for (curr = manager->nursery; curr < end; curr += ALIGN_GRANULE(size))
+	{
+		value = (value_t *)curr;
+		if (!(*value_manager_flags(value) & FORWARDED_MASK))
+		{
+			size = reference_size(value);
+			continue;
+		}
+
+		// Only the flags and the word after them were overwritten by the forwarding address
+		copy = forwarded(value);
+		size = reference_size(copy);
+		MEMCPY(value, copy, sizeof(value_t));
+		hfree(manager->heap, copy);
 
-				hfree(manager->heap, currNode->data);
+		manager->live -= size;
+		manager->allocated -= size;
+		manager->promoted -= size;
+	}
+}
 
-				currNode->next = NULL;
-				currNode->prev = NULL;
-				list_free(currNode, 0);
-				continue;
-			}
+void rescan_young(manager_t *manager)
+{
+	byte_t *curr;
+	size_t bit;
+
+	for (curr = manager->nursery; curr < manager->nurseryTop; curr += ALIGN_GRANULE(reference_size((value_t *)curr)))
+	{
+		bit = (curr - manager->nursery) / MARK_GRANULE;
+		if (manager->nurseryBits[bit >> 3] & (1 << (bit & 7)))
+		{
+			scan_reference(manager, (value_t *)curr);
+			drain_mark_stack(manager);
 		}
-		lit = list_iterator_next(lit);
 	}
-	list_iterator_free(lit);
 }
 
-void manager_free(manager_t *manager)
+inline size_t find_remembered(manager_t *manager, void **slot)
 {
-	if (manager)
+	size_t mask = manager->rememberedCapacity - 1;
+
+	// Slots are 8-byte aligned, so the low bits carry nothing and are mixed in from above
+	size_t index = (size_t)slot / sizeof(void *);
+	index ^= index >> 16;
+	index &= mask;
+
+	while (manager->remembered[index] && manager->remembered[index] != slot)
+		index = (index + 1) & mask;
+	return index;
+}
+
+int grow_remembered(manager_t *manager)
+{
+	void ***old = manager->remembered;
+	size_t oldCapacity = manager->rememberedCapacity;
+	size_t capacity = oldCapacity ? oldCapacity * 2 : INITIAL_REMEMBERED_SIZE;
+
+	manager->remembered = (void ***)MALLOC(capacity * sizeof(void **));
+	if (!manager->remembered)
 	{
-		list_free(manager->strongRefs, 0);
-		list_free(manager->refs, 0);
-		free_heap(manager->heap);
-		FREE(manager);
+		manager->remembered = old;
+		return 0;
+	}
+	MEMSET(manager->remembered, 0, capacity * sizeof(void **));
+	manager->rememberedCapacity = capacity;
+
+	for (size_t i = 0; i < oldCapacity; i++)
+	{
+		if (old[i])
+			manager->remembered[find_remembered(manager, old[i])] = old[i];
 	}
+
+	if (old)
+		FREE(old);
+	return 1;
 }
 
-void explore_value(value_t *value)
+void clear_remembered(manager_t *manager)
 {
-	if (!value)
+	if (manager->remembered)
+		MEMSET(manager->remembered, 0, manager->rememberedCapacity * sizeof(void **));
+	manager->rememberedSize = 0;
+}
+
+inline int is_young(manager_t *manager, void *reference)
+{
+	return (byte_t *)reference >= manager->nursery && (byte_t *)reference < manager->nurseryTop;
+}
+
+inline value_t *forwarded(value_t *value)
+{
+	return *((value_t **)&value->ovalue);
+}
+
+int prepare_mark_bits(manager_t *manager)
+{
+	size_t size;
+
+	if (manager->highest < manager->lowest)
+		return 1;
+
+	size = (manager->highest - manager->lowest) / MARK_GRANULE / 8 + 1;
+	if (size > manager->markBitsSize)
+	{
+		if (manager->markBits)
+			FREE(manager->markBits);
+		manager->markBits = (byte_t *)MALLOC(size);
+		if (!manager->markBits)
+		{
+			manager->markBitsSize = 0;
+			return 0;
+		}
+		manager->markBitsSize = size;
+	}
+
+	// Marks live beside the objects, so clearing every one is a single pass over the bitmap
+	manager->markBase = manager->lowest;
+	MEMSET(manager->markBits, 0, size);
+	return 1;
+}
+
+inline int is_marked(manager_t *manager, value_t *value)
+{
+	size_t bit = ((size_t)value - manager->markBase) / MARK_GRANULE;
+	return manager->markBits[bit >> 3] & (1 << (bit & 7));
+}
+
+void push_reference(manager_t *manager, value_t *value)
+{
+	byte_t *bits;
+	size_t bit;
+	value_t **stack;
+	size_t capacity;
+
+	// Anything outside the young generation and the heap, such as null, is not the collector's to mark
+	if (is_young(manager, value))
+	{
+		bits = manager->nurseryBits;
+		bit = ((byte_t *)value - manager->nursery) / MARK_GRANULE;
+	}
+	else if ((size_t)value >= manager->lowest && (size_t)value <= manager->highest)
+	{
+		bits = manager->markBits;
+		bit = ((size_t)value - manager->markBase) / MARK_GRANULE;
+	}
+	else
 		return;
 
-	unsigned char *flags = value_manager_flags(value);
-	if (*flags & MARKED_MASK)
+	if (bits[bit >> 3] & (1 << (bit & 7)))
 		return;
+	bits[bit >> 3] |= (1 << (bit & 7));
 
-	*flags |= MARKED_MASK;
+	// Only objects and object arrays hold references which need scanning
+	if (value_typeof(value) != lb_object && value_typeof(value) != lb_objectarray)
+		return;
 
+	if (manager->markStackSize == manager->markStackCapacity)
+	{
+		capacity = manager->markStackCapacity ? manager->markStackCapacity * 2 : INITIAL_MARK_STACK_SIZE;
+		if (capacity > MARK_STACK_LIMIT)
+			capacity = MARK_STACK_LIMIT;
+		stack = capacity > manager->markStackCapacity ? (value_t **)MALLOC(capacity * sizeof(value_t *)) : NULL;
+		if (!stack)
+		{
+			manager->markOverflow = 1;
+			return;
+		}
+
+		if (manager->markStack)
+		{
+			MEMCPY(stack, manager->markStack, manager->markStackSize * sizeof(value_t *));
+			FREE(manager->markStack);
+		}
+		manager->markStack = stack;
+		manager->markStackCapacity = capacity;
+	}
+
+	manager->markStack[manager->markStackSize++] = value;
+}
+
+void scan_reference(manager_t *manager, value_t *value)
+{
 	object_t *object;
 	array_t *array;
-	map_iterator_t *fieldIterator;
+	class_t *clazz;
 
-	unsigned char type = value_typeof(value);
-	switch (type)
+	switch (value_typeof(value))
 	{
 	case lb_object:
-	
 		object = (object_t *)value;
-		fieldIterator = map_create_iterator(object->clazz->fields);
-
-		while (fieldIterator->node)
-		{
-			field_t *field = (field_t *)fieldIterator->value;
-			unsigned char fieldType = field_typeof(field);
-			if (fieldType >= lb_object && fieldType <= lb_objectarray)
-			{
-				// Explore the object stored in this object
-				explore_value(*((value_t **)(((char *)&object->data) + (size_t)field->offset)));
-			}
-			fieldIterator = map_iterator_next(fieldIterator);
-		}
-
-		map_iterator_free(fieldIterator);
+		clazz = object->clazz;
 
+		for (size_t i = 0; i < clazz->numrefs; i++)
+			manager_mark(manager, (void **)(((char *)&object->data) + clazz->refs[i]));
 		break;
 	case lb_objectarray:
 		array = (array_t *)value;
 
 		for (luint i = 0; i < array->length; i++)
-		{
-			object_t *object = (object_t *)array_get_object(array, i);
-			explore_value((value_t *)object);
-		}
-
+			manager_mark(manager, (void **)array_get_data(array, i, sizeof(lobject)));
 		break;
 	}
 }
+
+void drain_mark_stack(manager_t *manager)
+{
+	while (manager->markStackSize)
+		scan_reference(manager, manager->markStack[--manager->markStackSize]);
+}
+
+int scan_block(void *block, void *param)
+{
+	manager_t *manager = (manager_t *)param;
+	scan_reference(manager, (value_t *)block);
+	drain_mark_stack(manager);
+	return 0;
+}
+
+int rescan_block(void *block, void *param)
+{
+	manager_t *manager = (manager_t *)param;
+	if (is_marked(manager, (value_t *)block))
+	{
+		scan_reference(manager, (value_t *)block);
+		drain_mark_stack(manager);
+	}
+	return 0;
+}
+
+int sweep_block(void *block, void *param)
+{
+	manager_t *manager = (manager_t *)param;
+	if (is_marked(manager, (value_t *)block))
+		return 0;
+	manager->live -= reference_size((value_t *)block);
+	return 1;
+}
+
+void note_allocation(manager_t *manager, void *block, size_t size)
+{
+	if ((size_t)block < manager->lowest)
+		manager->lowest = (size_t)block;
+	if ((size_t)block > manager->highest)
+		manager->highest = (size_t)block;
+	if ((size_t)block + size > manager->end)
+		manager->end = (size_t)block + size;
+
+	manager->live += size;
+	manager->allocated += size;
+	if (manager->threshold && manager->allocated >= manager->limit)
+		manager->collectRequested = 1;
+}
+
+size_t reference_size(value_t *value)
+{
+	if (value_typeof(value) == lb_object)
+		return sizeof(value_t) + ((object_t *)value)->clazz->size;
+	return sizeof(value_t) + (size_t)((array_t *)value)->length * array_element_size(value_typeof(value));
+}
+
+unsigned int array_element_size(byte_t type)
+{
+	switch (type)
+	{
+	case lb_chararray:
+	case lb_uchararray:
+	case lb_boolarray:
+		return sizeof(lchar);
+	case lb_shortarray:
+	case lb_ushortarray:
+		return sizeof(lshort);
+	case lb_intarray:
+	case lb_uintarray:
+	case lb_floatarray:
+		return sizeof(lint);
+	case lb_longarray:
+	case lb_ulongarray:
+	case lb_doublearray:
+	case lb_objectarray:
+		return sizeof(llong);
+	default:
+		return 0;
+	}
+}
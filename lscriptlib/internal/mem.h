@@ -26,21 +26,61 @@ typedef struct manager_s manager_t;
 struct manager_s
 {
 	heap_p heap;			// The heap
-	list_t *refs;			// A list of all references
 	list_t *strongRefs;		// A list of all strong references
+
+	size_t live;			// The number of bytes held by objects and arrays on the heap
+	size_t allocated;		// The number of bytes allocated on the heap since the last full collection
+	size_t threshold;		// The number of bytes which may be allocated between full collections, or 0 to never request one
+	size_t limit;			// The number of bytes which may be allocated on the heap before a full collection is requested
+	int collectRequested;	// Whether the young generation is full or allocated has crossed limit since the last collection
+	int collecting;			// What manager_mark does with a root during a collection
+
+	byte_t *nursery;		// The young generation, where objects are allocated until they survive a collection, or NULL
+	byte_t *nurseryTop;		// Where the next young object will be allocated
+	byte_t *nurseryLimit;	// The end of the space young objects may be allocated in
+	size_t nurserySize;		// The size of the young generation, in bytes
+	byte_t *nurseryBits;	// One bit per 8-byte granule of the young generation, set on live young references
+	void ***remembered;		// A set of the slots outside the young generation which were given a young reference, with NULL for no slot
+	size_t rememberedSize;	// The number of slots in remembered
+	size_t rememberedCapacity;	// The number of entries in remembered, a power of 2
+	int rememberOverflow;	// Whether a slot could not be remembered, so every object on the heap must be scanned instead
+
+	size_t promoted;		// The number of bytes moved onto the heap by the last collection
+	size_t freed;			// The number of bytes freed by the last collection
+
+	size_t lowest;			// The address of the lowest object or array on the heap
+	size_t highest;			// The address of the highest object or array on the heap
+	size_t end;				// The address just past the end of the highest object or array on the heap
+	size_t markBase;		// The address covered by the first bit of markBits
+	byte_t *markBits;		// One bit per 8-byte granule between markBase and highest, set on live references
+	size_t markBitsSize;	// The size of markBits, in bytes
+	value_t **markStack;	// References which are marked but whose children have not been scanned
+	size_t markStackSize;	// The number of references on markStack
+	size_t markStackCapacity;	// The number of references markStack can hold
+	int markOverflow;		// Whether a reference could not be pushed to markStack during this collection
 };
 
+/*
+Called by manager_gc to mark the roots of a collection. The address of each root must be passed
+to manager_mark. It may be called more than once per collection.
+*/
+typedef void(*manager_roots_func_t)(manager_t *manager, void *param);
+
 /*
 Creates a new memory manager.
 
 @param heapsize The size of the heap.
+@param threshold The number of bytes which may be allocated on the heap before a full collection
+is requested, or 0 to never request one. If 0, there is no young generation either, so objects
+never move.
 
 @return The new manager, or NULL if the creation failed.
 */
-manager_t *manager_create(size_t heapsize);
+manager_t *manager_create(size_t heapsize, size_t threshold);
 
 /*
-Allocates an object on the manager's heap.
+Allocates an object in the manager's young generation, or on its heap if it is large or the young
+generation is full.
 
 @param manager The manager on which to allocate the object.
 @param clazz The class of the object to allocate.
@@ -50,7 +90,8 @@ Allocates an object on the manager's heap.
 object_t *manager_alloc_object(manager_t *manager, class_t *clazz);
 
 /*
-Allocates an array on the manager's heap.
+Allocates an array in the manager's young generation, or on its heap if it is large or the young
+generation is full.
 
 @param manager The manager on which to allocate the object.
 @param type The type of array. Can be one of the types defined in lb.h of the form: lb_[TYPE]array.
@@ -93,15 +134,62 @@ Destroys a strong reference.
 void manager_destroy_strong_reference(manager_t *manager, reference_t *reference);
 
 /*
-Performs garbage collection on the manager. Any object will be freed unless either of these conditions
-are met: an object allocated on the manager is said to be a known reachable value by being in the
-visible set or an object has at least one strong reference to it.
+Marks the object or array a root refers to. Everything reachable from it survives the collection.
+Young objects which survive are moved onto the heap, and *reference is updated to their new
+address. Only valid while manager_gc is calling its roots function.
+
+@param manager The manager which is collecting.
+@param reference The address of the root. The root may be NULL.
+*/
+void manager_mark(manager_t *manager, void **reference);
+
+/*
+Remembers a slot outside the young generation which was given a young reference, so the next
+collection finds the young object and updates the slot when it moves. A slot is only remembered
+once however often it is stored to. Use manager_write_barrier instead of calling this directly.
+
+@param manager The manager which allocated the reference.
+@param slot The slot the reference was stored in.
+*/
+void manager_remember(manager_t *manager, void **slot);
+
+/*
+Must be called after a reference is stored in a field of an object or an element of an object
+array. Stores outside the range of the heap, such as to static fields, are ignored since the
+roots function must mark those slots anyway.
+
+@param manager The manager which allocated the objects.
+@param slot The slot the reference was stored in.
+*/
+inline void manager_write_barrier(manager_t *manager, void **slot)
+{
+	byte_t *value = (byte_t *)*slot;
+	if (value >= manager->nursery && value < manager->nurseryTop &&
+		(size_t)slot >= manager->lowest && (size_t)slot < manager->end &&
+		((byte_t *)slot < manager->nursery || (byte_t *)slot >= manager->nurseryTop))
+		manager_remember(manager, slot);
+}
+
+/*
+Performs garbage collection on the manager. Any object will be freed unless it is reachable from
+a root marked by roots or from an object with at least one strong reference to it.
+
+Young objects are collected first by moving the survivors onto the heap, which only traces what
+the roots, strong references and remembered slots reach in the young generation. The heap itself
+is only marked and swept when full is nonzero, once the bytes allocated on it cross the limit, or
+when the survivors do not fit on it.
+
+The manager never collects by itself. Once the young generation fills up or the bytes allocated
+on the heap cross the threshold, collectRequested is set so the owner can collect at a point
+where every reference it holds is visible to roots. Since objects move, the owner must not hold
+any reference which roots does not pass to manager_mark. Strong references are updated.
 
 @param manager The manager to garbage collect.
-@param visibleSet A set of values which are known to be visible - stored in the key field of
-each pair.
+@param roots A function which marks every root with manager_mark.
+@param param A value passed to roots.
+@param full Whether to also collect the heap.
 */
-void manager_gc(manager_t *manager, map_t *visibleSet);
+void manager_gc(manager_t *manager, manager_roots_func_t roots, void *param, int full);
 
 /*
 Frees a memory manager allocated with manager_create.
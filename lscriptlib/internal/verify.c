@@ -0,0 +1,1067 @@
+#include "verify.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "decode.h"
+#include "mem_debug.h"
+
+#define IS_REFERENCE_TYPE(type) ((type) >= lb_object && (type) <= lb_objectarray)
+#define IS_ARRAY_TYPE(type) ((type) >= lb_chararray && (type) <= lb_objectarray)
+#define IS_PRIMITIVE_TYPE(type) ((type) >= lb_char && (type) <= lb_double)
+#define IS_INTEGER_TYPE(type) ((type) >= lb_char && (type) <= lb_bool)
+
+#define LENGTH_PATH ".length"
+#define LENGTH_PATH_SIZE (sizeof(LENGTH_PATH) - 1)
+
+typedef struct verify_state_s verify_state_t;
+typedef struct verify_jump_s verify_jump_t;
+typedef struct verify_loop_s verify_loop_t;
+typedef struct verify_block_s verify_block_t;
+
+struct verify_jump_s
+{
+	size_t target;		// The jump target, as an offset from the class's data
+	size_t source;		// The offset of the jumping command from the function's body
+};
+
+struct verify_loop_s
+{
+	word_t index;			// The slot of the loop's unsigned index
+	word_t head;			// The slot holding the array, or "this" if the array is one of its fields
+	const char *path;		// The field path from head to the array, followed by ".length"
+	size_t pathlen;			// The length of the field path, not including ".length"
+	const byte_t *top;		// The while command
+	const byte_t *body;		// The first command of the loop's body
+	const byte_t *end;		// The loop's end command
+	const byte_t *step;		// The only command in the body which writes the index, or NULL
+};
+
+struct verify_block_s
+{
+	byte_t opener;			// The command which opened the block
+	size_t pushed;			// The number of qwords pushed when the block was entered
+	int counted;			// Whether the block is a while loop over an array which loop can describe
+	verify_loop_t loop;		// The loop, if counted is nonzero
+};
+
+struct verify_state_s
+{
+	class_t *clazz;				// The class being verified
+	int decode;					// Whether functions are decoded once they pass
+	function_t *func;			// The function being verified
+	const byte_t *start;		// The first command of the function's body
+	const byte_t *end;			// One past the last byte of the function's body
+	const byte_t *cmd;			// The command being decoded
+	const byte_t *curr;			// The next byte to decode
+	const byte_t *prev;			// The command decoded before cmd
+	byte_t *boundaries;			// A bit for each byte of the body, set where a command begins
+	size_t numjumps;			// The number of jumps collected
+	verify_jump_t *jumps;		// The jumps made by the function, checked once every command is known
+	size_t depth;				// The number of if, while and switch blocks the current command is in
+	size_t pushed;				// The number of qwords pushed at the current command
+	verify_block_t blocks[VERIFY_MAX_DEPTH];	// The open if, while and switch blocks, outermost first
+	size_t numelements;			// The number of array element operands collected
+	const byte_t **elements;	// The array element operands in the function
+	size_t numloops;			// The number of counted loops collected
+	verify_loop_t *loops;		// The counted loops whose element accesses are in bounds
+	char *message;				// Receives the error
+	size_t size;				// The size of message
+};
+
+static int verify_function(verify_state_t *state);
+static int verify_command(verify_state_t *state);
+static int verify_operand(verify_state_t *state, byte_t *type);
+static int verify_value(verify_state_t *state);
+static int verify_object_value(verify_state_t *state, byte_t dstType);
+static int verify_call(verify_state_t *state, byte_t cmd);
+static int verify_args(verify_state_t *state, const char *qualifiedName);
+static int verify_comparison(verify_state_t *state);
+static int verify_jump(verify_state_t *state, int allowFallthrough);
+static int verify_switch_table(verify_state_t *state);
+static int verify_jump_targets(verify_state_t *state);
+
+static int enter_block(verify_state_t *state);
+static int check_block_stack(verify_state_t *state);
+static int check_switch_label(verify_state_t *state);
+
+static void find_counted_loop(verify_state_t *state, const byte_t *cond);
+static void end_counted_loop(verify_state_t *state);
+static void note_write(verify_state_t *state, const byte_t *operand);
+static void note_call(verify_state_t *state);
+static void eliminate_bounds_checks(verify_state_t *state);
+static int is_loop_element(const verify_loop_t *loop, const byte_t *element);
+
+static int need(verify_state_t *state, size_t bytes);
+static int skip(verify_state_t *state, size_t bytes);
+static const char *read_string(verify_state_t *state);
+static byte_t slot_type(const function_t *func, word_t index);
+static size_t set_width(byte_t cmd);
+static int same_array_layout(byte_t arrayType, byte_t dstType);
+static unsigned char infer_argument_count(const char *qualifiedName);
+static int fail(verify_state_t *state, const char *format, ...);
+
+int verify_class(class_t *clazz, char *message, size_t size, int decode)
+{
+	verify_state_t state;
+	map_iterator_t *mit;
+	function_t *func;
+	int result = 1;
+
+	if (size)
+		*message = 0;
+
+	state.clazz = clazz;
+	state.decode = decode;
+	state.message = message;
+	state.size = size;
+
+	mit = map_create_iterator(clazz->functions);
+	while (result && mit->node)
+	{
+		func = (function_t *)mit->value;
+
+		// Inherited functions were verified with their own class, and functions declared without a
+		// body, such as Iterable's, have nothing to verify
+		if (func->parentClass == clazz && !(func->flags & (FUNCTION_FLAG_NATIVE | FUNCTION_FLAG_ABSTRACT)) && func->location && func->bodySize)
+		{
+			state.func = func;
+			result = verify_function(&state);
+		}
+
+		mit = map_iterator_next(mit);
+	}
+	map_iterator_free(mit);
+
+	return result;
+}
+
+int verify_function(verify_state_t *state)
+{
+	function_t *func = state->func;
+	size_t offset;
+	int result;
+
+	state->start = (const byte_t *)func->location;
+	state->end = state->start + func->bodySize;
+	state->cmd = state->start;
+	state->curr = state->start;
+	state->prev = NULL;
+	state->numjumps = 0;
+	state->depth = 0;
+	state->pushed = 0;
+	state->numelements = 0;
+	state->numloops = 0;
+
+	state->boundaries = (byte_t *)CALLOC((func->bodySize + 7) / 8, sizeof(byte_t));
+
+	// Every jump is stored in at least a size_t, every loop takes at least an opcode and a size_t,
+	// and every element operand at least its tag and a one character name
+	state->jumps = (verify_jump_t *)MALLOC((func->bodySize / sizeof(size_t) + 1) * sizeof(verify_jump_t));
+	state->loops = (verify_loop_t *)MALLOC((func->bodySize / (1 + sizeof(size_t)) + 1) * sizeof(verify_loop_t));
+	state->elements = (const byte_t **)MALLOC((func->bodySize / 3 + 1) * sizeof(const byte_t *));
+	if (!state->boundaries || !state->jumps || !state->loops || !state->elements)
+	{
+		if (state->boundaries)
+			FREE(state->boundaries);
+		if (state->jumps)
+			FREE(state->jumps);
+		if (state->loops)
+			FREE(state->loops);
+		if (state->elements)
+			FREE(state->elements);
+		return fail(state, "Allocation failure");
+	}
+
+	result = 1;
+	while (result && state->curr < state->end)
+	{
+		state->prev = state->cmd;
+		state->cmd = state->curr;
+		offset = (size_t)(state->cmd - state->start);
+		state->boundaries[offset / 8] |= 1 << (offset % 8);
+		result = verify_command(state);
+	}
+
+	if (result && state->depth != 0)
+		result = fail(state, "%zu if, while or switch blocks are never ended", state->depth);
+
+	if (result)
+		result = verify_jump_targets(state);
+
+	if (result)
+	{
+		eliminate_bounds_checks(state);
+		if (state->decode)
+			decode_function(func, state->boundaries);
+	}
+
+	FREE(state->elements);
+	FREE(state->loops);
+	FREE(state->jumps);
+	FREE(state->boundaries);
+	return result;
+}
+
+int verify_command(verify_state_t *state)
+{
+	byte_t cmd;
+	byte_t type, dstType, srcType;
+	const byte_t *dst, *cond;
+	size_t offset;
+
+	cmd = *state->curr;
+	state->curr++;
+	dst = state->curr;
+
+	switch (cmd)
+	{
+	case lb_noop:
+		return 1;
+
+	case lb_char:
+	case lb_uchar:
+	case lb_short:
+	case lb_ushort:
+	case lb_int:
+	case lb_uint:
+	case lb_long:
+	case lb_ulong:
+	case lb_bool:
+	case lb_float:
+	case lb_double:
+	case lb_object:
+	case lb_chararray:
+	case lb_uchararray:
+	case lb_shortarray:
+	case lb_ushortarray:
+	case lb_intarray:
+	case lb_uintarray:
+	case lb_longarray:
+	case lb_ulongarray:
+	case lb_boolarray:
+	case lb_floatarray:
+	case lb_doublearray:
+	case lb_objectarray:
+		if (!need(state, 1))
+			return 0;
+		if (*state->curr != lb_slot)
+		{
+			note_write(state, dst);
+			return read_string(state) != NULL;
+		}
+
+		// The VM resets the slot to the declared type, so it must match the type it was given in the frame
+		if (!need(state, 2 + sizeof(word_t)))
+			return 0;
+		if (state->curr[1 + sizeof(word_t)] != 0)
+			return fail(state, "Declaration of a slot with a field path");
+		if (!verify_operand(state, &type))
+			return 0;
+		if (type != cmd)
+			return fail(state, "Declaration of type 0x%02x into a slot of type 0x%02x", (unsigned)cmd, (unsigned)type);
+		note_write(state, dst);
+		return 1;
+
+	case lb_setb:
+	case lb_setw:
+	case lb_setd:
+	case lb_setq:
+	case lb_setr4:
+	case lb_setr8:
+		if (!verify_operand(state, &dstType))
+			return 0;
+		if (dstType && (!IS_PRIMITIVE_TYPE(dstType) || sizeof_type(dstType) != set_width(cmd)))
+			return fail(state, "Literal of %zu bytes stored into a slot of type 0x%02x", set_width(cmd), (unsigned)dstType);
+		note_write(state, dst);
+		return skip(state, set_width(cmd));
+	case lb_seto:
+		if (!verify_operand(state, &dstType))
+			return 0;
+		if (dstType && !IS_REFERENCE_TYPE(dstType))
+			return fail(state, "Object stored into a slot of type 0x%02x", (unsigned)dstType);
+		note_write(state, dst);
+		return verify_object_value(state, dstType);
+	case lb_setv:
+		if (!verify_operand(state, &dstType) || !verify_operand(state, &srcType))
+			return 0;
+		if (dstType && srcType && (IS_REFERENCE_TYPE(dstType) || IS_REFERENCE_TYPE(srcType)) && dstType != srcType)
+			return fail(state, "Slot of type 0x%02x set from a slot of type 0x%02x", (unsigned)dstType, (unsigned)srcType);
+		note_write(state, dst);
+		return 1;
+	case lb_setr:
+		if (!verify_operand(state, &type))
+			return 0;
+		note_write(state, dst);
+		return 1;
+
+	case lb_ret:
+	case lb_retr:
+		return 1;
+	case lb_retb:
+	case lb_retw:
+	case lb_retd:
+	case lb_retq:
+	case lb_retr4:
+	case lb_retr8:
+		// The return commands are ordered like the set commands
+		return skip(state, set_width(cmd - lb_retb + lb_setb));
+	case lb_retv:
+		return verify_operand(state, &type);
+
+	case lb_static_call:
+	case lb_dynamic_call:
+		note_call(state);
+		return verify_call(state, cmd);
+
+	case lb_add:
+	case lb_sub:
+	case lb_mul:
+	case lb_div:
+	case lb_mod:
+	case lb_and:
+	case lb_or:
+	case lb_xor:
+	case lb_lsh:
+	case lb_rsh:
+		if (!verify_operand(state, &type) || !verify_operand(state, &type) || !verify_value(state))
+			return 0;
+		note_write(state, dst);
+		return 1;
+	case lb_neg:
+	case lb_not:
+	case lb_castc:
+	case lb_castuc:
+	case lb_casts:
+	case lb_castus:
+	case lb_casti:
+	case lb_castui:
+	case lb_castl:
+	case lb_castul:
+	case lb_castb:
+	case lb_castf:
+	case lb_castd:
+		if (!verify_operand(state, &type) || !verify_operand(state, &type))
+			return 0;
+		note_write(state, dst);
+		return 1;
+
+	case lb_if:
+	case lb_while:
+		cond = state->curr;
+		if (!verify_comparison(state) || !verify_jump(state, 0) || !enter_block(state))
+			return 0;
+		if (cmd == lb_while)
+			find_counted_loop(state, cond);
+		return 1;
+	case lb_elif:
+		// The if command which follows continues the same block rather than opening one
+		if (!check_block_stack(state) || !verify_jump(state, 1))
+			return 0;
+		if (!need(state, 1) || *state->curr != lb_if)
+			return fail(state, "elif is not followed by an if command");
+
+		// The previous branch's comparison jumps to the if when it fails, so it starts a command too
+		offset = (size_t)(state->curr - state->start);
+		state->boundaries[offset / 8] |= 1 << (offset % 8);
+		state->curr++;
+		return verify_comparison(state) && verify_jump(state, 0);
+	case lb_else:
+		return check_block_stack(state) && verify_jump(state, 1);
+	case lb_end:
+		if (!check_block_stack(state) || !verify_jump(state, 1))
+			return 0;
+		end_counted_loop(state);
+		state->depth--;
+		return 1;
+
+	case lb_switch:
+		if (!verify_operand(state, &type))
+			return 0;
+		if (type && !IS_INTEGER_TYPE(type))
+			return fail(state, "switch on a slot of type 0x%02x", (unsigned)type);
+		return verify_switch_table(state) && enter_block(state);
+	case lb_case:
+		// Case labels always jump to the end of the switch, so the value after it is never run
+		return check_switch_label(state) && verify_jump(state, 0) && skip(state, sizeof(qword_t));
+	case lb_default:
+		return check_switch_label(state) && verify_jump(state, 0);
+
+	case lb_push:
+		if (!need(state, 1))
+			return 0;
+		if (*state->curr == lb_ret)
+			state->curr++;
+		else if (*state->curr == lb_value)
+		{
+			state->curr++;
+			if (!verify_operand(state, &type))
+				return 0;
+		}
+		else
+			return fail(state, "Invalid push format, must be either ret or value");
+		state->pushed++;
+		return 1;
+	case lb_pop:
+		if (!need(state, 1))
+			return 0;
+		if (*state->curr != lb_null)
+			return fail(state, "Invalid pop format, must be null");
+		state->curr++;
+		if (state->pushed == (state->depth ? state->blocks[state->depth - 1].pushed : 0))
+			return fail(state, "pop without a matching push");
+		state->pushed--;
+		return 1;
+
+	default:
+		return fail(state, "Unsupported command 0x%02x", (unsigned)cmd);
+	}
+}
+
+int verify_operand(verify_state_t *state, byte_t *type)
+{
+	word_t index;
+	const char *path;
+
+	*type = 0;
+
+	if (!need(state, 1))
+		return 0;
+
+	switch (*state->curr)
+	{
+	case lb_element:
+		state->elements[state->numelements] = state->curr;
+		state->numelements++;
+		state->curr++;
+		if (!verify_operand(state, type))
+			return 0;
+		if (*type && *type < lb_chararray)
+			return fail(state, "Element of a slot of type 0x%02x", (unsigned)*type);
+		*type = 0;
+		if (!need(state, 1))
+			return 0;
+		if (*state->curr == lb_index)
+			return skip(state, 1 + sizeof(luint));
+		if (!verify_operand(state, type))
+			return 0;
+		*type = 0;
+		return 1;
+	case lb_slot:
+	case lb_static_slot:
+		if (!need(state, 1 + sizeof(word_t)))
+			return 0;
+		index = *((word_t *)(state->curr + 1));
+		if (*state->curr == lb_slot)
+		{
+			if (index >= state->func->framesize)
+				return fail(state, "Slot %hu is outside of the function's frame of %zu slots", index, state->func->framesize);
+			*type = slot_type(state->func, index);
+		}
+		else
+		{
+			if (index >= state->clazz->numstatics)
+				return fail(state, "Static slot %hu is outside of the class's %zu statics", index, state->clazz->numstatics);
+			*type = value_typeof(state->clazz->statics[index]);
+		}
+		state->curr += 1 + sizeof(word_t);
+
+		path = read_string(state);
+		if (!path)
+			return 0;
+		if (*path)
+		{
+			// Fields and elements can only be reached through references
+			if (!IS_REFERENCE_TYPE(*type))
+				return fail(state, "Path \"%s\" into a slot of type 0x%02x", path, (unsigned)*type);
+			*type = 0;
+		}
+		return 1;
+	case lb_element_unchecked:
+		return fail(state, "Unchecked array element operand");
+	default:
+		path = read_string(state);
+		if (!path)
+			return 0;
+		if (!*path)
+			return fail(state, "Empty variable name");
+		return 1;
+	}
+}
+
+int verify_value(verify_state_t *state)
+{
+	byte_t type;
+	size_t width;
+
+	if (!need(state, 1))
+		return 0;
+
+	type = *state->curr;
+	state->curr++;
+	switch (type)
+	{
+	case lb_bool:
+	case lb_char:
+	case lb_uchar:
+	case lb_byte:
+		width = sizeof(byte_t);
+		break;
+	case lb_short:
+	case lb_ushort:
+	case lb_word:
+		width = sizeof(word_t);
+		break;
+	case lb_int:
+	case lb_uint:
+	case lb_float:
+	case lb_dword:
+	case lb_real4:
+		width = sizeof(dword_t);
+		break;
+	case lb_long:
+	case lb_ulong:
+	case lb_double:
+	case lb_qword:
+	case lb_real8:
+		width = sizeof(qword_t);
+		break;
+	case lb_value:
+		return verify_operand(state, &type);
+	case lb_string:
+		return read_string(state) != NULL;
+	case lb_ret:
+		return 1;
+	default:
+		return fail(state, "Invalid value type 0x%02x", (unsigned)type);
+	}
+
+	return skip(state, width);
+}
+
+int verify_object_value(verify_state_t *state, byte_t dstType)
+{
+	byte_t type, sizeType;
+	const char *name;
+
+	if (!need(state, 1))
+		return 0;
+
+	type = *state->curr;
+	state->curr++;
+	switch (type)
+	{
+	case lb_new:
+		note_call(state);
+		if (dstType && dstType != lb_object)
+			return fail(state, "Object created into a slot of type 0x%02x", (unsigned)dstType);
+		if (!read_string(state))
+			return 0;
+		name = read_string(state);
+		if (!name)
+			return 0;
+		return verify_args(state, name);
+	case lb_char:
+	case lb_uchar:
+	case lb_short:
+	case lb_ushort:
+	case lb_int:
+	case lb_uint:
+	case lb_long:
+	case lb_ulong:
+	case lb_bool:
+	case lb_float:
+	case lb_double:
+	case lb_object:
+		// Element types are laid out in the same order as their array types
+		if (dstType && dstType != lb_object && !same_array_layout(type + (lb_chararray - lb_char), dstType))
+			return fail(state, "Array of type 0x%02x created into a slot of type 0x%02x", (unsigned)(type + (lb_chararray - lb_char)), (unsigned)dstType);
+		if (!need(state, 1))
+			return 0;
+		if (*state->curr == lb_dword)
+			return skip(state, 1 + sizeof(dword_t));
+		if (*state->curr != lb_value)
+			return fail(state, "seto expected value or dword");
+		state->curr++;
+		if (!verify_operand(state, &sizeType))
+			return 0;
+		if (sizeType && sizeType != lb_uint)
+			return fail(state, "init array requires 32-bit unsigned integral size");
+		return 1;
+	case lb_string:
+		if (dstType && dstType != lb_object)
+			return fail(state, "String stored into a slot of type 0x%02x", (unsigned)dstType);
+		return read_string(state) != NULL;
+	case lb_null:
+		return 1;
+	default:
+		return fail(state, "seto expected type");
+	}
+}
+
+int verify_call(verify_state_t *state, byte_t cmd)
+{
+	byte_t type;
+	word_t index;
+	const char *name;
+
+	if (cmd == lb_dynamic_call)
+	{
+		if (!verify_operand(state, &type))
+			return 0;
+		if (type && type != lb_object)
+			return fail(state, "Function called on a slot of type 0x%02x", (unsigned)type);
+	}
+
+	if (state->clazz->version >= LB_VERSION_POOL)
+	{
+		if (!need(state, sizeof(word_t)))
+			return 0;
+		index = *((word_t *)state->curr);
+		if (index >= state->clazz->poolsize)
+			return fail(state, "Constant pool index %hu is outside of the pool of %zu entries", index, state->clazz->poolsize);
+		state->curr += sizeof(word_t);
+		name = state->clazz->pool[index];
+	}
+	else
+	{
+		name = read_string(state);
+		if (!name)
+			return 0;
+	}
+
+	return verify_args(state, name);
+}
+
+int verify_args(verify_state_t *state, const char *qualifiedName)
+{
+	unsigned char argCount = infer_argument_count(qualifiedName);
+
+	for (unsigned char i = 0; i < argCount; i++)
+	{
+		if (!verify_value(state))
+			return 0;
+	}
+	return 1;
+}
+
+int verify_comparison(verify_state_t *state)
+{
+	byte_t count;
+
+	if (!need(state, 1))
+		return 0;
+	count = *state->curr;
+	state->curr++;
+
+	if (!verify_value(state))
+		return 0;
+
+	if (count == lb_one)
+		return 1;
+	if (count != lb_two)
+		return fail(state, "Invalid comparison count 0x%02x", (unsigned)count);
+
+	if (!need(state, 1))
+		return 0;
+	if (*state->curr < lb_equal || *state->curr > lb_gequal)
+		return fail(state, "Invalid comparator 0x%02x", (unsigned)*state->curr);
+	state->curr++;
+
+	return verify_value(state);
+}
+
+int verify_jump(verify_state_t *state, int allowFallthrough)
+{
+	size_t target;
+
+	if (!need(state, sizeof(size_t)))
+		return 0;
+	target = *((size_t *)state->curr);
+	state->curr += sizeof(size_t);
+
+	if (target == (size_t)-1)
+	{
+		if (!allowFallthrough)
+			return fail(state, "Unlinked jump");
+		return 1;
+	}
+
+	state->jumps[state->numjumps].target = target;
+	state->jumps[state->numjumps].source = (size_t)(state->cmd - state->start);
+	state->numjumps++;
+	return 1;
+}
+
+int verify_jump_targets(verify_state_t *state)
+{
+	size_t start = (size_t)(state->start - state->clazz->data);
+	size_t offset;
+
+	for (size_t i = 0; i < state->numjumps; i++)
+	{
+		// Targets are relative to the class's data, but must stay inside this function
+		offset = state->jumps[i].target - start;
+		if (state->jumps[i].target < start || offset >= state->func->bodySize || !(state->boundaries[offset / 8] & (1 << (offset % 8))))
+		{
+			state->cmd = state->start + state->jumps[i].source;
+			return fail(state, "Jump to %zu does not land on a command in the function", state->jumps[i].target);
+		}
+	}
+	return 1;
+}
+
+int verify_switch_table(verify_state_t *state)
+{
+	byte_t tableType;
+	dword_t count;
+	size_t entrySize;
+	qword_t value = 0;
+
+	if (!need(state, 1))
+		return 0;
+	tableType = *state->curr;
+	state->curr++;
+
+	if (tableType == lb_dense)
+	{
+		if (!skip(state, sizeof(qword_t)))
+			return 0;
+		entrySize = sizeof(size_t);
+	}
+	else if (tableType == lb_sparse)
+		entrySize = sizeof(qword_t) + sizeof(size_t);
+	else
+		return fail(state, "Invalid switch table type 0x%02x", (unsigned)tableType);
+
+	if (!need(state, sizeof(dword_t)))
+		return 0;
+	count = *((dword_t *)state->curr);
+	state->curr += sizeof(dword_t);
+	if (count > (size_t)(state->end - state->curr) / entrySize)
+		return fail(state, "Switch table of %u entries runs past the end of the function", count);
+
+	// The default target
+	if (!verify_jump(state, 0))
+		return 0;
+
+	for (dword_t i = 0; i < count; i++)
+	{
+		if (tableType == lb_sparse)
+		{
+			// The VM binary searches sparse tables
+			if (i && (llong)*((qword_t *)state->curr) <= (llong)value)
+				return fail(state, "Switch cases are not in ascending order");
+			value = *((qword_t *)state->curr);
+			state->curr += sizeof(qword_t);
+		}
+		if (!verify_jump(state, 0))
+			return 0;
+	}
+	return 1;
+}
+
+int enter_block(verify_state_t *state)
+{
+	if (state->depth >= VERIFY_MAX_DEPTH)
+		return fail(state, "Blocks are nested deeper than %d", VERIFY_MAX_DEPTH);
+	state->blocks[state->depth].opener = *state->cmd;
+	state->blocks[state->depth].pushed = state->pushed;
+	state->blocks[state->depth].counted = 0;
+	state->depth++;
+	return 1;
+}
+
+int check_block_stack(verify_state_t *state)
+{
+	if (state->depth == 0)
+		return fail(state, "Command outside of an if or while block");
+
+	// Every path through a block must leave the stack as it found it
+	if (state->pushed != state->blocks[state->depth - 1].pushed)
+		return fail(state, "Block leaves %zu qwords on the stack", state->pushed - state->blocks[state->depth - 1].pushed);
+	return 1;
+}
+
+int check_switch_label(verify_state_t *state)
+{
+	if (state->depth == 0 || state->blocks[state->depth - 1].opener != lb_switch)
+		return fail(state, "Case label outside of a switch");
+	return check_block_stack(state);
+}
+
+void find_counted_loop(verify_state_t *state, const byte_t *cond)
+{
+	verify_block_t *block = &state->blocks[state->depth - 1];
+	verify_loop_t *loop = &block->loop;
+	field_t *field;
+	char fieldName[256];
+	byte_t headType;
+	size_t pathlen;
+
+	// Only "while index < array.length" is recognized, where index is a plain unsigned slot. The
+	// comparison has already been verified, so every operand it holds is complete.
+	if (cond[0] != lb_two || cond[1] != lb_value || cond[2] != lb_slot || cond[3 + sizeof(word_t)] != 0)
+		return;
+	loop->index = *((word_t *)(cond + 3));
+	if (slot_type(state->func, loop->index) != lb_uint)
+		return;
+
+	cond += 4 + sizeof(word_t);
+	if (cond[0] != lb_less || cond[1] != lb_value || cond[2] != lb_slot)
+		return;
+	loop->head = *((word_t *)(cond + 3));
+	loop->path = (const char *)(cond + 3 + sizeof(word_t));
+
+	pathlen = strlen(loop->path);
+	if (pathlen < LENGTH_PATH_SIZE || strcmp(loop->path + pathlen - LENGTH_PATH_SIZE, LENGTH_PATH))
+		return;
+	loop->pathlen = pathlen - LENGTH_PATH_SIZE;
+
+	headType = slot_type(state->func, loop->head);
+	if (loop->pathlen == 0)
+	{
+		if (!IS_ARRAY_TYPE(headType))
+			return;
+	}
+	else
+	{
+		// A field's type is only known when it is read through "this", whose class is being verified
+		if ((state->func->flags & FUNCTION_FLAG_STATIC) || loop->head != state->func->numargs)
+			return;
+		if (loop->pathlen >= sizeof(fieldName) || loop->path[0] != '.' || strcspn(loop->path + 1, ".[") < loop->pathlen - 1)
+			return;
+		MEMCPY(fieldName, loop->path + 1, loop->pathlen - 1);
+		fieldName[loop->pathlen - 1] = 0;
+
+		field = (field_t *)class_get_dynamic_field_offset(state->clazz, fieldName);
+		if (!field || !IS_ARRAY_TYPE(field_typeof(field)))
+			return;
+	}
+
+	loop->top = state->cmd;
+	loop->body = state->curr;
+	loop->step = NULL;
+	block->counted = 1;
+}
+
+void end_counted_loop(verify_state_t *state)
+{
+	verify_block_t *block = &state->blocks[state->depth - 1];
+
+	// The index may only be stepped right before the loop goes back to compare it again
+	if (!block->counted || (block->loop.step && block->loop.step != state->prev))
+		return;
+
+	block->loop.end = state->cmd;
+	state->loops[state->numloops] = block->loop;
+	state->numloops++;
+}
+
+void note_write(verify_state_t *state, const byte_t *operand)
+{
+	verify_block_t *block;
+	word_t index;
+	int hasPath;
+
+	for (size_t i = 0; i < state->depth; i++)
+	{
+		block = &state->blocks[i];
+		if (!block->counted)
+			continue;
+
+		switch (*operand)
+		{
+		case lb_slot:
+			index = *((word_t *)(operand + 1));
+			hasPath = operand[1 + sizeof(word_t)] != 0;
+			if (hasPath)
+			{
+				// Any field written might be the one holding the array
+				if (block->loop.pathlen)
+					block->counted = 0;
+			}
+			else if (index == block->loop.head)
+				block->counted = 0;
+			else if (index == block->loop.index)
+			{
+				if (block->loop.step)
+					block->counted = 0;
+				block->loop.step = state->cmd;
+			}
+			break;
+		case lb_static_slot:
+			if (operand[1 + sizeof(word_t)] != 0 && block->loop.pathlen)
+				block->counted = 0;
+			break;
+		case lb_element:
+			// Storing an element replaces neither the array nor the index
+			break;
+		default:
+			// A name could resolve to any slot or field
+			block->counted = 0;
+			break;
+		}
+	}
+}
+
+void note_call(verify_state_t *state)
+{
+	// The callee could replace the array through any reference to the object holding it
+	for (size_t i = 0; i < state->depth; i++)
+		state->blocks[i].counted = 0;
+}
+
+void eliminate_bounds_checks(verify_state_t *state)
+{
+	const verify_loop_t *loop;
+	const byte_t *source, *target;
+	size_t i, j;
+
+	for (i = 0; i < state->numloops; i++)
+	{
+		loop = &state->loops[i];
+
+		// The body may only be entered through the loop's comparison
+		for (j = 0; j < state->numjumps; j++)
+		{
+			source = state->start + state->jumps[j].source;
+			target = state->clazz->data + state->jumps[j].target;
+			if (target > loop->top && target <= loop->end && (source < loop->body || source >= loop->end))
+				break;
+		}
+		if (j < state->numjumps)
+			continue;
+
+		// The comparison proved the array non-null and the index below its length, and nothing
+		// in the body changes either before the next comparison
+		for (j = 0; j < state->numelements; j++)
+		{
+			if (state->elements[j] >= loop->body && state->elements[j] < loop->end && is_loop_element(loop, state->elements[j]))
+				*((byte_t *)state->elements[j]) = lb_element_unchecked;
+		}
+	}
+}
+
+int is_loop_element(const verify_loop_t *loop, const byte_t *element)
+{
+	const char *path;
+
+	if (element[1] != lb_slot || *((word_t *)(element + 2)) != loop->head)
+		return 0;
+
+	path = (const char *)(element + 2 + sizeof(word_t));
+	if (strlen(path) != loop->pathlen || memcmp(path, loop->path, loop->pathlen))
+		return 0;
+
+	element = (const byte_t *)path + loop->pathlen + 1;
+	return element[0] == lb_slot && *((word_t *)(element + 1)) == loop->index && element[1 + sizeof(word_t)] == 0;
+}
+
+int need(verify_state_t *state, size_t bytes)
+{
+	if ((size_t)(state->end - state->curr) < bytes)
+		return fail(state, "Command runs past the end of the function");
+	return 1;
+}
+
+int skip(verify_state_t *state, size_t bytes)
+{
+	if (!need(state, bytes))
+		return 0;
+	state->curr += bytes;
+	return 1;
+}
+
+const char *read_string(verify_state_t *state)
+{
+	const char *string = (const char *)state->curr;
+	const byte_t *nul = (const byte_t *)memchr(state->curr, 0, state->end - state->curr);
+	if (!nul)
+	{
+		fail(state, "Unterminated string");
+		return NULL;
+	}
+	state->curr = nul + 1;
+	return string;
+}
+
+byte_t slot_type(const function_t *func, word_t index)
+{
+	// The frame template is stored last slot first
+	return value_typeof(func->frame + func->framesize - 1 - index);
+}
+
+size_t set_width(byte_t cmd)
+{
+	switch (cmd)
+	{
+	case lb_setb:
+		return sizeof(byte_t);
+	case lb_setw:
+		return sizeof(word_t);
+	case lb_setd:
+		return sizeof(dword_t);
+	case lb_setq:
+		return sizeof(qword_t);
+	case lb_setr4:
+		return sizeof(real4_t);
+	case lb_setr8:
+		return sizeof(real8_t);
+	default:
+		return 0;
+	}
+}
+
+int same_array_layout(byte_t arrayType, byte_t dstType)
+{
+	if (arrayType == dstType)
+		return 1;
+
+	// Integral arrays that differ only in the signedness of their elements share a layout
+	if (arrayType > lb_ulongarray || dstType < lb_chararray || dstType > lb_ulongarray)
+		return 0;
+	return (arrayType - lb_chararray) / 2 == (dstType - lb_chararray) / 2;
+}
+
+unsigned char infer_argument_count(const char *qualifiedName)
+{
+	unsigned char argCount = 0;
+	const char *cursor = strchr(qualifiedName, '(');
+	if (!cursor)
+		return 0;
+	cursor++;
+	while (*cursor)
+	{
+		// An array argument is its element type prefixed with [
+		if (*cursor == '[')
+			cursor++;
+		if (*cursor == 'L')
+		{
+			cursor = strchr(cursor, ';');
+			if (!cursor)
+				break;
+		}
+		cursor++;
+		argCount++;
+	}
+	return argCount;
+}
+
+int fail(verify_state_t *state, const char *format, ...)
+{
+	va_list ls;
+	int written;
+
+	if (!state->size)
+		return 0;
+
+	written = sprintf_s(state->message, state->size, "%s at offset %zu: ", state->func->qualifiedName, (size_t)(state->cmd - state->start));
+	if (written < 0 || (size_t)written >= state->size)
+		return 0;
+
+	va_start(ls, format);
+	vsprintf_s(state->message + written, state->size - written, format, ls);
+	va_end(ls);
+	return 0;
+}
@@ -0,0 +1,37 @@
+#if !defined(VERIFY_H)
+#define VERIFY_H
+
+#include "class.h"
+
+#define VERIFY_MAX_DEPTH 256	// The deepest nesting of if, while and switch blocks a verified function may have
+
+/*
+Verifies the bytecode of every interpreted function a class declares. A function passes when
+each of its commands decodes completely within its body, every slot, static and constant pool
+index is in range, declarations and literal or object stores agree with the declared type of
+the slot they target, if, while and switch blocks are balanced, every jump and switch table
+entry lands on the start of a command in the same function, and pushes and pops balance within
+each block.
+
+Once a function is verified, array element operands inside "while index < array.length" loops
+are rewritten to lb_element_unchecked when the loop's comparison proves them in bounds: the
+index is a plain unsigned slot stepped only right before the loop's end, the array is held in a
+slot or one of this's fields and cannot be replaced in the body, and the body is only entered
+through the comparison.
+
+When decode is nonzero, each function is then translated by decode_function, so the VM can run
+it from pre-decoded entries rather than its bytecode.
+
+Only classes of version LB_VERSION_SLOTS or later can be verified, since earlier versions
+neither record the size of a function's body nor the types of its locals.
+
+@param clazz The class to verify. Its superclass, statics and constant pool must be loaded.
+@param message A buffer receiving a description of the first error found.
+@param size The size of message, in bytes.
+@param decode Whether to decode each function which passes.
+
+@return nonzero if the class was verified, or zero if it failed verification.
+*/
+int verify_class(class_t *clazz, char *message, size_t size, int decode);
+
+#endif
@@ -12,22 +12,84 @@
 #include "string_util.h"
 #include "debug.h"
 #include "lprocess.h"
+#include "verify.h"
+#include "decode.h"
+
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#endif
 
 #define WORD_SIZE sizeof(size_t)
 
 //#define CURR_CLASS(env) (*(((class_t**)(env)->rbp)+2))
 #define CURR_FLAGS(env) (*(((frame_flags_t*)(env)->rbp)-1))
-#define CURR_FUNC(env) (*(((function_t**)(env)->rbp)-2))
 #define FRAME_FUNC(rbp) (*(((function_t**)(rbp))-2))
 #define FRAME_RIP(rbp) (*(((byte_t**)(rbp))-3))
 #define PREV_FRAME(rbp) (*(((byte_t**)(rbp))-4))
 
 #define EXIT_RUN(val) {__retVal=(val);goto done_call;}
 
-#define CLEAR_EXCEPTION(env) { env->exception = 0; env->message[0] = 0; }
+// Compilers which can take the address of a label let env_run jump from the end
+// of one command straight to the handler of the next, rather than going back
+// through a single switch. Others fall back to the switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define THREADED_DISPATCH
+#endif
+
+// Functions decoded when their class was loaded run from their decoded entries, where ip is the
+// entry of the command at env->rip. Commands without a decoded form keep their bytecode opcode
+// and move env->rip themselves, after which ip is moved to follow it.
+#define SYNC_DECODED() { if (ip) ip = env->rip == ip->next ? ip + 1 : ip->target && env->rip == ip->target->rip ? ip->target : decode_find(CURR_FUNC(env), env->rip); }
+
+#if defined(THREADED_DISPATCH)
+#define COMMAND(cmd) case cmd: cmd_##cmd
+#define NEXT_COMMAND() do { if (!env->rip) goto done_call; SYNC_DECODED(); env->cmdStart = env->rip; executed++; goto *dispatch[ip ? ip->op : *env->rip]; } while (0)
+#define NEXT_DECODED(entry) do { ip = (entry); env->rip = ip->rip; env->cmdStart = env->rip; executed++; goto *dispatch[ip->op]; } while (0)
+#else
+#define COMMAND(cmd) case cmd
+#define NEXT_COMMAND() break
+#define NEXT_DECODED(entry) do { ip = (entry); env->rip = ip->rip; goto run_decoded; } while (0)
+#endif
+
+// Runs the current command through the handler of its bytecode, for a decoded command whose
+// operands did not resolve to the types it was decoded for
+#define RUN_AS_BYTECODE() do { op = *env->rip; goto run_command; } while (0)
+
+#define CLEAR_EXCEPTION(env) { env->exception = 0; env->format = NULL; env->message[0] = 0; }
+
+#define IS_REFERENCE_TYPE(type) ((type) >= lb_object && (type) <= lb_objectarray)
+
+#define CURR_VERIFIED(env) (CURR_FUNC(env)->parentClass->flags & CLASS_FLAG_VERIFIED)
+
+// Refreshes what env_run knows about the running function after a call or return changed the frame
+#define ENTER_FRAME() { verified = CURR_VERIFIED(env); ip = env->rip ? decode_find(CURR_FUNC(env), env->rip) : NULL; }
+
+// Garbage is only collected where every live reference is held in a frame, a static or a strong
+// reference, so it is never done in the middle of a command or while native code is waiting on
+// the interpreter
+#define GC_SAFEPOINT(env) { if ((env)->vm->manager->collectRequested && !(env)->nativeCalls) vm_collect((env)->vm, 0); }
 
 typedef unsigned long long frame_flags_t;
 
+// How an argument of an exception message's format is passed
+enum
+{
+	format_arg_none,	// The conversion takes no argument, such as "%%"
+	format_arg_int,		// An int or smaller integer, which is promoted to int
+	format_arg_long,	// A long
+	format_arg_qword,	// A long long or size_t
+	format_arg_double,	// A double, or a float which is promoted to double
+	format_arg_string,	// A string, which is copied into the environment when raised
+	format_arg_pointer	// A pointer
+};
+
+typedef struct field_site_s field_site_t;
+struct field_site_s
+{
+	class_t *clazz;		// The class the field was last resolved on
+	field_t *field;		// The field in that class
+};
+
 static const char *const g_exceptionStrings[] =
 {
 	"NO_EXCEPTION",
@@ -56,9 +118,11 @@ enum
 {
 	frame_flag_return_no_cleanup = 0x1,
 	frame_flag_return_native = 0x2,
+	frame_flag_slots = 0x4,				// Variables live in slots instead of a name map (version 2+)
 };
 
 static int class_resolve_filename(vm_t *__restrict vm, const char *__restrict classname, char *filename, size_t filenameLen);
+static int class_resolve_filename_cached(vm_t *__restrict vm, const char *__restrict classname, char *filename, size_t filenameLen);
 static class_t *class_load_to_vm(vm_t *__restrict vm, class_t *__restrict clazz);
 static class_t *class_load_filename_override(vm_t *__restrict vm, const char *__restrict classname, const char *__restrict filename, int loadSuperClasses, int loadToVM, int checkExists);
 static char *resolve_first_class(vm_t *vm, char *name, class_t **result);
@@ -66,28 +130,41 @@ static char *resolve_first_class(vm_t *vm, char *name, class_t **result);
 static class_t *class_load_ext(const char *classname, vm_t *vm);
 
 static int env_run(env_t *__restrict env, void *__restrict location);
+static inline char *env_read_call_name(env_t *env);
+static int env_resolve_static_call(env_t *env, const char *site, char *name, function_t **function);
+static int env_resolve_virtual_call(env_t *env, object_t *object, const char *site, const char *name, function_t **function);
+static field_t *env_get_field_at_site(env_t *env, object_t *object, const char *name);
 static inline int env_create_stack_frame(env_t *__restrict env, function_t *__restrict function, flags_t flags);
 static inline int env_cleanup_call(env_t *__restrict env, int onlyStackCleanup);
 
 static int env_handle_static_function_callv(env_t *__restrict env, function_t *__restrict function, frame_flags_t flags, va_list ls);
 static int env_handle_dynamic_function_callv(env_t *__restrict env, function_t *__restrict function, frame_flags_t flags, object_t *object, va_list ls);
+static int env_push_frame(env_t *__restrict env, function_t *__restrict function, object_t *object, va_list ls);
+static int env_enter_static(env_t *env, function_t *function, va_list ls);
 
 static va_list env_gen_call_arg_list(env_t *env, function_t *function);
-static inline void env_free_call_arg_list(env_t *env, va_list callArgs);
 
 static void *stack_push(env_t *env, value_t *value);
 static void *stack_alloc(env_t *env, size_t words);
 static int stack_pop(env_t *env, size_t words, qword_t *dstWords);
 
 static int is_varname_avaliable(env_t *env, const char *name);
+static inline value_t *env_find_local(env_t *env, const char *name);
+static int env_resolve_array_index(env_t *env, array_t *arr, char *name, char *indBeg, data_t **data, flags_t *flags);
+static int env_resolve_array_element(env_t *env, array_t *arr, luint index, const char *name, data_t **data, flags_t *flags);
 
 static int static_set(data_t *dst, flags_t dstFlags, data_t *src, flags_t srcFlags);
 
 static int try_link_function(vm_t *__restrict vm, function_t *__restrict func);
+static int try_link_aot_function(vm_t *__restrict vm, function_t *__restrict func);
+static void link_aot_functions(vm_t *__restrict vm, class_t *__restrict clazz);
+static int build_native_arg_types(function_t *func);
 
 static void vm_start_routine(start_args_t *args);
 
-static void print_stack_trace(FILE *file, env_t *env, int printVars);
+static void vm_mark_roots(manager_t *manager, void *param);
+
+static const char *parse_format_spec(const char *spec, int *argKind);
 
 static size_t default_write_stdout(const char *buf, size_t count);
 static size_t default_write_stderr(const char *buf, size_t count);
@@ -108,6 +185,42 @@ Implemented in hooks.asm
 */
 extern qword_t __cdecl vm_call_extern_asm(size_t argCount, const byte_t *argTypes, const void *args, void *proc);
 
+#if !defined(_WIN32)
+/*
+Calls a function with the System V x86-64 calling convention. Integer arguments are passed in rdi,
+rsi, rdx, rcx, r8 and r9, real arguments in xmm0 to xmm7, and the rest on the stack in order.
+
+Implemented in hooks_sysv.c
+
+@param argCount The number of arguments the function takes, including the environment and class.
+@param argTypes How each argument after the environment and class was staged (lb_byte to lb_real8).
+@param args A pointer to the start of the arguments. Each argument should be 8-bytes wide.
+@param proc The function to execute.
+@param returnType The function's return type, which decides whether the result is read from rax or xmm0.
+
+@return The return value. A real is returned bit for bit in the low bytes.
+*/
+extern qword_t vm_call_extern_sysv(size_t argCount, const byte_t *argTypes, const void *args, void *proc, byte_t returnType);
+
+/*
+Checks whether vm_call_extern_sysv can pass a function's arguments.
+
+@param argCount The number of arguments the function takes, including the environment and class.
+@param argTypes How each argument after the environment and class is staged (lb_byte to lb_real8).
+
+@return Nonzero if the arguments left over once the registers are full fit in the thunk's stack space.
+*/
+extern int vm_sysv_can_call(size_t argCount, const byte_t *argTypes);
+#endif
+
+static inline void env_write_barrier(env_t *env, data_t *dst)
+{
+	// Frames are roots, so only stores into fields and array elements need to be remembered
+	if ((byte_t *)dst >= env->stack && (byte_t *)dst < env->stack + env->vm->stackSize)
+		return;
+	manager_write_barrier(env->vm->manager, (void **)dst);
+}
+
 static inline void store_return(env_t *env, data_t *dst, flags_t dstFlags)
 {
 	byte_t type = value_typeof((value_t *)&dstFlags);
@@ -159,9 +272,65 @@ static inline int is_numeric(const char *string)
 	return 1;
 }
 
+static inline int env_compare(env_t *env)
+{
+	return *env->rip == lb_ifi || *env->rip == lb_whilei ? vmc_compare_int(env, &env->rip) : vmc_compare(env, &env->rip);
+}
+
+static inline int decoded_int(env_t *env, const decoded_operand_t *operand, luint *value, byte_t *type)
+{
+	byte_t *loc;
+	data_t *data;
+	flags_t flags;
+
+	switch (operand->kind)
+	{
+	case decoded_imm:
+		*value = operand->imm;
+		*type = operand->type;
+		return 1;
+	case decoded_slot:
+		*value = FRAME_SLOT(env->rbp, operand->slot)->uivalue;
+		*type = operand->type;
+		return 1;
+	default:
+		loc = operand->operand;
+		if (!env_resolve_operand(env, &loc, &data, &flags))
+			return 0;
+
+		// Integers narrower than 32 bits compare as the int they are promoted to
+		*type = lb_int;
+		switch (TYPEOF(flags))
+		{
+		case lb_char:
+			*value = (luint)(lint)data->cvalue;
+			return 1;
+		case lb_uchar:
+			*value = data->ucvalue;
+			return 1;
+		case lb_short:
+			*value = (luint)(lint)data->svalue;
+			return 1;
+		case lb_ushort:
+			*value = data->usvalue;
+			return 1;
+		case lb_bool:
+			*value = (luint)(lint)data->bvalue;
+			return 1;
+		case lb_int:
+		case lb_uint:
+			*value = data->uivalue;
+			*type = TYPEOF(flags);
+			return 1;
+		default:
+			return 0;
+		}
+	}
+}
+
 static inline int handle_if(env_t *env)
 {
-	if (!vmc_compare(env, &env->rip))
+	if (!env_compare(env))
 	{
 		if (env->exception)
 			return env->exception;
@@ -179,7 +348,90 @@ static inline int handle_if(env_t *env)
 	return 0;
 }
 
-vm_t *vm_create(size_t heapSize, size_t stackSize, void *lsAPILib, vm_flags_t flags, int pathCount, const char *const paths[], const ls_stdio_t *stdio)
+static inline int handle_switch(env_t *env)
+{
+	class_t *c = CURR_FUNC(env)->parentClass;
+	data_t *data;
+	flags_t flags;
+	qword_t value;
+	qword_t index;
+	dword_t count;
+	dword_t low, high, mid;
+	size_t *targets;
+	qword_t *entries;
+
+	env->rip++;
+	if (!env_resolve_operand(env, &env->rip, &data, &flags))
+		return env->exception;
+
+	// Cases are 64-bit, so narrower values are widened by their signedness
+	switch (TYPEOF(flags))
+	{
+	case lb_char:
+		value = (qword_t)(llong)data->cvalue;
+		break;
+	case lb_uchar:
+		value = data->ucvalue;
+		break;
+	case lb_short:
+		value = (qword_t)(llong)data->svalue;
+		break;
+	case lb_ushort:
+		value = data->usvalue;
+		break;
+	case lb_int:
+		value = (qword_t)(llong)data->ivalue;
+		break;
+	case lb_uint:
+		value = data->uivalue;
+		break;
+	case lb_long:
+		value = (qword_t)data->lvalue;
+		break;
+	case lb_ulong:
+		value = data->ulvalue;
+		break;
+	case lb_bool:
+		value = data->bvalue;
+		break;
+	default:
+		return env_raise_exception(env, exception_bad_command, "switch on a value of type 0x%02x", (unsigned int)TYPEOF(flags));
+	}
+
+	if (*env->rip == lb_dense)
+	{
+		index = value - *((qword_t *)(env->rip + 1));
+		count = *((dword_t *)(env->rip + 1 + sizeof(qword_t)));
+		targets = (size_t *)(env->rip + 1 + sizeof(qword_t) + sizeof(dword_t));
+
+		// The default target comes first
+		env->rip = c->data + (index < count ? targets[index + 1] : targets[0]);
+		return 0;
+	}
+
+	count = *((dword_t *)(env->rip + 1));
+	targets = (size_t *)(env->rip + 1 + sizeof(dword_t));
+	entries = (qword_t *)(targets + 1);
+
+	low = 0;
+	high = count;
+	while (low < high)
+	{
+		mid = low + (high - low) / 2;
+		if ((llong)entries[mid * 2] < (llong)value)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low < count && entries[low * 2] == value)
+		env->rip = c->data + entries[low * 2 + 1];
+	else
+		env->rip = c->data + targets[0];
+	return 0;
+}
+
+vm_t *vm_create(size_t heapSize, size_t stackSize, size_t gcThreshold, void *lsAPILib, vm_flags_t flags, int pathCount, const char *const paths[], const ls_stdio_t *stdio)
 {
 	vm_t *vm = (vm_t *)MALLOC(sizeof(vm_t));
 	if (!vm)
@@ -207,10 +459,15 @@ vm_t *vm_create(size_t heapSize, size_t stackSize, void *lsAPILib, vm_flags_t fl
 		return NULL;
 	}
 
+	vm->unresolvedNames = map_create(16, string_hash_func, string_compare_func, string_copy_func, NULL, (free_func_t)free);
+	vm->callSites = map_create(64, NULL, NULL, NULL, NULL, NULL);
+	vm->fieldSites = map_create(64, NULL, NULL, NULL, NULL, NULL);
+	vm->strings = map_create(64, NULL, NULL, NULL, NULL, NULL);
+
 	vm->envs = NULL;
 	vm->envsLast = vm->envs;
 
-	vm->manager = manager_create(heapSize);
+	vm->manager = manager_create(heapSize, gcThreshold);
 	if (!vm->manager)
 	{
 		list_free(vm->envs, 0);
@@ -252,8 +509,7 @@ vm_t *vm_create(size_t heapSize, size_t stackSize, void *lsAPILib, vm_flags_t fl
 	vm->loadedClassObjects = map_create(16, string_hash_func, string_compare_func, string_copy_func, NULL, (free_func_t)free);
 
 	vm->libraryCount = 4;
-#if defined(_WIN32)
-	vm->hLibraries = (HMODULE *)CALLOC(vm->libraryCount, sizeof(HMODULE));
+	vm->hLibraries = CALLOC(vm->libraryCount, sizeof(*vm->hLibraries));
 	if (!vm->hLibraries)
 	{
 		list_free(vm->paths, 1);
@@ -263,7 +519,8 @@ vm_t *vm_create(size_t heapSize, size_t stackSize, void *lsAPILib, vm_flags_t fl
 		FREE(vm);
 		return NULL;
 	}
-	vm->hLibraries[0] = (HMODULE)lsAPILib;//GetModuleHandleA(NULL);
+	vm->hLibraries[0] = lsAPILib;//GetModuleHandleA(NULL);
+#if defined(_WIN32)
 	vm->hVMThread = NULL;
 	vm->dwVMThreadID = 0;
 #else
@@ -321,8 +578,11 @@ vm_t *vm_create(size_t heapSize, size_t stackSize, void *lsAPILib, vm_flags_t fl
 		return NULL;
 	}
 
-	set_superclass(classClass, objectClass);
-	set_superclass(stringClass, objectClass);
+	if (!set_superclass(classClass, objectClass) || !set_superclass(stringClass, objectClass))
+	{
+		vm_free(vm, 0);
+		return NULL;
+	}
 
 	class_load_to_vm(vm, objectClass);
 	class_load_to_vm(vm, classClass);
@@ -423,6 +683,8 @@ vm_t *vm_create(size_t heapSize, size_t stackSize, void *lsAPILib, vm_flags_t fl
 	object_set_ulong(stdHandles[1], "nativeHandle", (lulong)stderr);
 	object_set_ulong(stdHandles[2], "nativeHandle", (lulong)stdin);
 
+	// The handles were allocated after the streams, so if they are young the streams are too and
+	// no write barrier is needed
 	object_set_object(stdoutVal, "handle", stdHandles[0]);
 	object_set_object(stderrVal, "handle", stdHandles[1]);
 	object_set_object(stdinVal, "handle", stdHandles[2]);
@@ -495,7 +757,7 @@ class_t *vm_load_class(vm_t *__restrict vm, const char *__restrict classname)
 	if (result) return result;
 
 	char filename[MAX_PATH];
-	if (!class_resolve_filename(vm, classname, filename, sizeof(filename)))
+	if (!class_resolve_filename_cached(vm, classname, filename, sizeof(filename)))
 	{
 		if ((vm->flags & vm_flag_verbose) || (vm->flags & vm_flag_verbose_errors))
 			printf("Class load error for \"%s\": Failed to locate on classpath.\n", classname);
@@ -533,9 +795,28 @@ class_t *vm_load_class_file(vm_t *__restrict vm, const char *__restrict filename
 
 class_t *vm_load_class_binary(vm_t *vm, byte_t *binary, size_t size, int loadSuperclasses)
 {
+	char message[256];
 	class_t *clazz = class_load(binary, size, loadSuperclasses, (classloadproc_t)class_load_ext, vm);
-	if (clazz)
-		map_insert(vm->classes, clazz->name, clazz);
+	if (!clazz)
+		return NULL;
+
+	// Verification needs the slot types and body sizes which only version 2+ classes record
+	if (clazz->version >= LB_VERSION_SLOTS && clazz->functions)
+	{
+		if (!verify_class(clazz, message, sizeof(message), !(vm->flags & vm_flag_no_decode)))
+		{
+			// Always reported: without it a rejected class only shows up as a later failure to find it
+			printf("Class verification error for class \"%s\": %s\n", clazz->name, message);
+			class_free(clazz, 0);
+			return NULL;
+		}
+		clazz->flags |= CLASS_FLAG_VERIFIED;
+	}
+
+	if (vm->flags & vm_flag_aot)
+		link_aot_functions(vm, clazz);
+
+	map_insert(vm->classes, clazz->name, clazz);
 	return clazz;
 }
 
@@ -561,6 +842,13 @@ void vm_add_path(vm_t *vm, const char *path)
 		buf[size - 1] = 0;
 		list_insert(node, buf);
 	}
+
+	// Names which were not found before may be found on the new path
+	if (vm->unresolvedNames)
+	{
+		map_free(vm->unresolvedNames, 0);
+		vm->unresolvedNames = map_create(16, string_hash_func, string_compare_func, string_copy_func, NULL, (free_func_t)free);
+	}
 }
 
 int vm_load_library(vm_t *vm, const char *libpath)
@@ -578,10 +866,48 @@ int vm_load_library(vm_t *vm, const char *libpath)
 			if (!hmodLib)
 				return 0;
 			vm->hLibraries[i] = hmodLib;
+
+			// Classes loaded before the library may have functions it compiles
+			if (vm->flags & vm_flag_aot)
+			{
+				map_iterator_t *mit = map_create_iterator(vm->classes);
+				while (mit->node)
+				{
+					link_aot_functions(vm, (class_t *)mit->value);
+					mit = map_iterator_next(mit);
+				}
+				map_iterator_free(mit);
+			}
 			return 1;
 		}
 	}
 #else
+	char buf[512];
+	snprintf(buf, sizeof(buf), "%s.so", libpath);
+	// Slot 0 is reserved for the lsapi functions
+	for (size_t i = 1; i < vm->libraryCount; i++)
+	{
+		if (!vm->hLibraries[i])
+		{
+			void *lib = dlopen(buf, RTLD_NOW);
+			if (!lib)
+				return 0;
+			vm->hLibraries[i] = lib;
+
+			// Classes loaded before the library may have functions it compiles
+			if (vm->flags & vm_flag_aot)
+			{
+				map_iterator_t *mit = map_create_iterator(vm->classes);
+				while (mit->node)
+				{
+					link_aot_functions(vm, (class_t *)mit->value);
+					mit = map_iterator_next(mit);
+				}
+				map_iterator_free(mit);
+			}
+			return 1;
+		}
+	}
 #endif
 	return 0;
 }
@@ -627,6 +953,11 @@ void vm_free(vm_t *vm, unsigned long threadWaitTime)
 
 	map_free(vm->loadedClassObjects, 1);
 
+	map_free(vm->unresolvedNames, 0);
+	map_free(vm->callSites, 0);
+	map_free(vm->fieldSites, 1);
+	map_free(vm->strings, 1);
+
 #if defined(_WIN32)
 	// Don't free the first library - it is passed in vm_create by user
 	for (size_t i = 1; i < vm->libraryCount; i++)
@@ -638,6 +969,14 @@ void vm_free(vm_t *vm, unsigned long threadWaitTime)
 		}
 	}
 #else
+	for (size_t i = 1; i < vm->libraryCount; i++)
+	{
+		if (vm->hLibraries[i])
+		{
+			dlclose(vm->hLibraries[i]);
+			vm->hLibraries[i] = NULL;
+		}
+	}
 #endif
 
 	list_free(vm->paths, 1);
@@ -645,6 +984,19 @@ void vm_free(vm_t *vm, unsigned long threadWaitTime)
 	FREE(vm);
 }
 
+void vm_gc(vm_t *vm)
+{
+	vm_collect(vm, 1);
+}
+
+void vm_collect(vm_t *vm, int full)
+{
+	manager_gc(vm->manager, vm_mark_roots, vm, full);
+
+	if (vm->flags & vm_flag_verbose)
+		printf("Collected garbage: %llu bytes promoted, %llu bytes freed, %llu bytes live\n", (unsigned long long)vm->manager->promoted, (unsigned long long)vm->manager->freed, (unsigned long long)vm->manager->live);
+}
+
 vm_snapshot_t *vm_take_snapshot(vm_t *vm)
 {
 	return NULL;
@@ -686,7 +1038,12 @@ env_t *env_create(vm_t *vm)
 
 	env->rip = NULL;
 	env->vm = vm;
+	env->executed = 0;
+	env->nativeCalls = 0;
 	env->exception = exception_none;
+	env->format = NULL;
+	env->exceptionRip = NULL;
+	env->exceptionRbp = NULL;
 	env->message[0] = 0;
 	env->qret = 0;
 
@@ -699,7 +1056,7 @@ env_t *env_create(vm_t *vm)
 	if (vm->envsLast)
 	{
 		vm->envsLast->next = list_create();
-		vm->envsLast->prev = vm->envsLast;
+		vm->envsLast->next->prev = vm->envsLast;
 		vm->envsLast = vm->envsLast->next;
 		vm->envsLast->data = env;
 	}
@@ -777,7 +1134,7 @@ void env_free_snapshot(env_snapshot_t *ss)
 
 int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 {
-	map_node_t *mapNode;
+	value_t *local;
 	char *beg = strchr(name, '.');
 	char *indBeg;
 	size_t valsize;
@@ -786,13 +1143,13 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 	if (beg)
 	{
 		*beg = 0;
-		mapNode = map_find((map_t *)env->variables->data, name);
+		local = env_find_local(env, name);
 
-		if (mapNode)
+		if (local)
 		{
 			*beg = '.';
 			beg++;
-			return env_resolve_object_field(env, (object_t *)((value_t *)mapNode->value)->ovalue, beg, data, flags);
+			return env_resolve_object_field(env, (object_t *)local->ovalue, beg, data, flags);
 		}
 		else
 		{
@@ -804,7 +1161,7 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 
 			if (!clazz)
 			{
-				env_raise_exception(env, exception_bad_variable_name, name);
+				env_raise_exception(env, exception_bad_variable_name, "%s", name);
 				return 0;
 			}
 
@@ -820,7 +1177,7 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 				*nbeg = '.';
 				if (!fieldVal)
 				{
-					env_raise_exception(env, exception_bad_variable_name, name);
+					env_raise_exception(env, exception_bad_variable_name, "%s", name);
 					return 0;
 				}
 				nbeg++;
@@ -835,7 +1192,7 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 					fieldVal = class_get_static_field(clazz, beg);
 					if (!fieldVal)
 					{
-						env_raise_exception(env, exception_bad_variable_name, name);
+						env_raise_exception(env, exception_bad_variable_name, "%s", name);
 						return 0;
 					}
 					*indBeg = '[';
@@ -845,7 +1202,7 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 					luint index;
 					if (!numEnd)
 					{
-						env_raise_exception(env, exception_bad_variable_name, name);
+						env_raise_exception(env, exception_bad_variable_name, "%s", name);
 						return 0;
 					}
 
@@ -857,7 +1214,7 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 						if (!env_resolve_variable(env, num, &indexData, &indexFlags))
 						{
 							*numEnd = ']';
-							env_raise_exception(env, exception_bad_variable_name, name);
+							env_raise_exception(env, exception_bad_variable_name, "%s", name);
 							return 0;
 						}
 						*numEnd = ']';
@@ -872,7 +1229,7 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 					array_t *arr = (array_t *)(fieldVal->ovalue);
 					if (!arr)
 					{
-						env_raise_exception(env, exception_null_dereference, name);
+						env_raise_exception(env, exception_null_dereference, "%s", name);
 						return 0;
 					}
 
@@ -895,7 +1252,7 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 					fieldVal = class_get_static_field(clazz, beg);
 					if (!fieldVal)
 					{
-						env_raise_exception(env, exception_bad_variable_name, name);
+						env_raise_exception(env, exception_bad_variable_name, "%s", name);
 						return 0;
 					}
 					*data = (data_t *)&fieldVal->ovalue;
@@ -911,79 +1268,104 @@ int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags)
 	if (indBeg)
 	{
 		*indBeg = 0;
-		mapNode = map_find((map_t *)env->variables->data, name);
+		local = env_find_local(env, name);
 		*indBeg = '[';
-		if (!mapNode)
+		if (!local)
 		{
 			
-			env_raise_exception(env, exception_bad_variable_name, name);
+			env_raise_exception(env, exception_bad_variable_name, "%s", name);
 			return 0;
 		}
 
-		char *num = indBeg + 1;
-		char *numEnd = strchr(num, ']');
-		luint index;
-		if (!numEnd)
-		{
-			env_raise_exception(env, exception_bad_variable_name, name);
-			return 0;
-		}
+		return env_resolve_array_index(env, (array_t *)local->ovalue, name, indBeg, data, flags);
+	}
+
+	// If all the other checks didn't pass, this variable is just normal
+	local = env_find_local(env, name);
+	if (!local)
+	{
+		env_raise_exception(env, exception_bad_variable_name, "%s", name);
+		return 0;
+	}
 
-		*numEnd = 0;
-		if (!is_numeric(num))
+	*flags = local->flags;
+	*data = (data_t *)&local->ovalue;
+
+	return 1;
+}
+
+int env_resolve_operand(env_t *env, byte_t **location, data_t **data, flags_t *flags)
+{
+	byte_t *loc = *location;
+	value_t *slot;
+	char *path;
+	data_t *indexData;
+	flags_t indexFlags;
+	luint index;
+	array_t *arr;
+	byte_t elemType;
+
+	switch (*loc)
+	{
+	case lb_element:
+		loc++;
+		if (!env_resolve_operand(env, &loc, data, flags))
+			return 0;
+		if (*loc == lb_index)
 		{
-			data_t *indexData;
-			flags_t indexFlags;
-			if (!env_resolve_variable(env, num, &indexData, &indexFlags))
-			{
-				*numEnd = ']';
-				env_raise_exception(env, exception_bad_variable_name, name);
-				return 0;
-			}
-			*numEnd = ']';
-			index = indexData->uivalue;
+			index = *((luint *)(loc + 1));
+			loc += 1 + sizeof(luint);
 		}
 		else
 		{
-			index = (luint)atoll(num);
-			*numEnd = ']';
-		}
-
-		array_t *arr = (array_t *)(((value_t *)mapNode->value)->ovalue);
-		if (!arr)
-		{
-			env_raise_exception(env, exception_null_dereference, name);
-			return 0;
+			if (!env_resolve_operand(env, &loc, &indexData, &indexFlags))
+				return 0;
+			index = indexData->uivalue;
 		}
-
-
-		if (index >= arr->length)
-		{
-			env_raise_exception(env, exception_bad_array_index, "%s at %u", name, index);
+		*location = loc;
+		return env_resolve_array_element(env, (array_t *)(*data)->ovalue, index, NULL, data, flags);
+	case lb_element_unchecked:
+		// The verifier proved the array is not null and the index is within its length
+		loc++;
+		if (!env_resolve_operand(env, &loc, data, flags))
 			return 0;
-		}
+		index = FRAME_SLOT(env->rbp, *((word_t *)(loc + 1)))->uivalue;
+		*location = loc + 1 + sizeof(word_t) + 1;
 
-		byte_t elemType = value_typeof((value_t *)arr) - lb_object + lb_char - 1;
-		valsize = sizeof_type(elemType);
+		arr = (array_t *)(*data)->ovalue;
+		elemType = value_typeof((value_t *)arr) - lb_object + lb_char - 1;
 		*flags = 0;
 		value_set_type((value_t *)flags, elemType);
-		*data = (data_t *)((byte_t *)&arr->data + (valsize * index));
+		*data = array_get_data(arr, index, sizeof_type(elemType));
+		return 1;
+	case lb_slot:
+		slot = FRAME_SLOT(env->rbp, *((word_t *)(loc + 1)));
+		break;
+	case lb_static_slot:
+		slot = CURR_FUNC(env)->parentClass->statics[*((word_t *)(loc + 1))];
+		break;
+	default:
+		if (!env_resolve_variable(env, (char *)loc, data, flags))
+			return 0;
+		*location = loc + strlen(loc) + 1;
 		return 1;
 	}
 
-	// If all the other checks didn't pass, this variable is just normal
-	mapNode = map_find((map_t *)env->variables->data, name);
-	if (!mapNode)
+	path = (char *)(loc + 1 + sizeof(word_t));
+
+	// Most operands are a plain local, which is fully resolved by the slot index
+	if (!*path)
 	{
-		env_raise_exception(env, exception_bad_variable_name, name);
-		return 0;
+		*data = (data_t *)&slot->ovalue;
+		*flags = slot->flags;
+		*location = (byte_t *)path + 1;
+		return 1;
 	}
 
-	value_t *val = (value_t *)mapNode->value;
-	*flags = val->flags;
-	*data = (data_t *)&val->ovalue;
-
-	return 1;
+	*location = (byte_t *)path + strlen(path) + 1;
+	if (*path == '.')
+		return env_resolve_object_field(env, (object_t *)slot->ovalue, path + 1, data, flags);
+	return env_resolve_array_index(env, (array_t *)slot->ovalue, path, path, data, flags);
 }
 
 int env_resolve_object_field(env_t *env, object_t *object, char *name, data_t **data, flags_t *flags)
@@ -1004,7 +1386,7 @@ int env_resolve_object_field(env_t *env, object_t *object, char *name, data_t **
 		bracEnd = strchr(name, ']');
 		if (!bracEnd)
 		{
-			env_raise_exception(env, exception_bad_variable_name, name);
+			env_raise_exception(env, exception_bad_variable_name, "%s", name);
 			return 0;
 		}
 		char *indBegin = bracBeg + 1;
@@ -1025,7 +1407,7 @@ int env_resolve_object_field(env_t *env, object_t *object, char *name, data_t **
 			if (!env_resolve_variable(env, indBegin, &indexData, &indexFlags))
 			{
 				*bracEnd = ']';
-				env_raise_exception(env, exception_bad_variable_name, name);
+				env_raise_exception(env, exception_bad_variable_name, "%s", name);
 				return 0;
 			}
 
@@ -1033,7 +1415,7 @@ int env_resolve_object_field(env_t *env, object_t *object, char *name, data_t **
 		}
 
 		*bracBeg = 0;
-		fieldData = object_get_field_data(object, name);
+		fieldData = env_get_field_at_site(env, object, name);
 		if (!fieldData)
 		{
 			env_raise_exception(env, exception_bad_variable_name, "field %s", name);
@@ -1046,7 +1428,7 @@ int env_resolve_object_field(env_t *env, object_t *object, char *name, data_t **
 		array_t *arr = (array_t *)(*data)->ovalue;
 		if (!arr)
 		{
-			env_raise_exception(env, exception_null_dereference, name);
+			env_raise_exception(env, exception_null_dereference, "%s", name);
 			return 0;
 		}
 		
@@ -1072,12 +1454,12 @@ int env_resolve_object_field(env_t *env, object_t *object, char *name, data_t **
 		void *objectData;
 
 		*beg = 0;
-		fieldData = object_get_field_data(object, name);
+		fieldData = env_get_field_at_site(env, object, name);
 		*beg = '.';
 
 		if (!fieldData)
 		{
-			env_raise_exception(env, exception_bad_variable_name, name);
+			env_raise_exception(env, exception_bad_variable_name, "%s", name);
 			return 0;
 		}
 
@@ -1098,7 +1480,7 @@ int env_resolve_object_field(env_t *env, object_t *object, char *name, data_t **
 		switch (type)
 		{
 		case lb_object:
-			fieldData = object_get_field_data(object, name);
+			fieldData = env_get_field_at_site(env, object, name);
 			if (!fieldData)
 			{
 				env_raise_exception(env, exception_bad_variable_name, "field %s.%s", object->clazz->name, name);
@@ -1132,18 +1514,43 @@ int env_resolve_object_field(env_t *env, object_t *object, char *name, data_t **
 			return 1;
 			break;
 		default:
-			env_raise_exception(env, exception_bad_variable_name, name);
+			env_raise_exception(env, exception_bad_variable_name, "%s", name);
 			return 0;
 			break;
 		}
 	}
 }
 
+field_t *env_get_field_at_site(env_t *env, object_t *object, const char *name)
+{
+	field_site_t *site = (field_site_t *)map_at(env->vm->fieldSites, name);
+	field_t *field;
+
+	// Repeated accesses from the same site usually see the same class
+	if (site && site->clazz == object->clazz)
+		return site->field;
+
+	field = object_get_field_data(object, name);
+	if (!field)
+		return NULL;
+
+	if (!site)
+	{
+		site = (field_site_t *)MALLOC(sizeof(field_site_t));
+		if (!site)
+			return field;
+		map_insert(env->vm->fieldSites, name, site);
+	}
+	site->clazz = object->clazz;
+	site->field = field;
+	return field;
+}
+
 int env_resolve_function_name(env_t *env, char *name, function_t **function)
 {
 	if (!name)
 	{
-		env_raise_exception(env, exception_function_not_found, name);
+		env_raise_exception(env, exception_function_not_found, "%s", name);
 		return 0;
 	}
 
@@ -1169,7 +1576,7 @@ int env_resolve_function_name(env_t *env, char *name, function_t **function)
 			byte_t type = TYPEOF(flags);
 			if (type != lb_object)
 			{
-				env_raise_exception(env, exception_function_not_found, name);
+				env_raise_exception(env, exception_function_not_found, "%s", name);
 				return 0;
 			}
 			object_t *obj = (object_t *)data->ovalue;
@@ -1189,7 +1596,7 @@ int env_resolve_function_name(env_t *env, char *name, function_t **function)
 
 			if (!clazz)
 			{
-				env_raise_exception(env, exception_class_not_found, name);
+				env_raise_exception(env, exception_class_not_found, "%s", name);
 				return 0;
 			}
 
@@ -1199,7 +1606,7 @@ int env_resolve_function_name(env_t *env, char *name, function_t **function)
 			result = class_get_function(clazz, funcname);
 			if (!result)
 			{
-				env_raise_exception(env, exception_function_not_found, name);
+				env_raise_exception(env, exception_function_not_found, "%s", name);
 				return 0;
 			}
 			*function = result;
@@ -1212,17 +1619,75 @@ int env_resolve_function_name(env_t *env, char *name, function_t **function)
 		result = class_get_function(clazz, name);
 		if (!result)
 		{
-			env_raise_exception(env, exception_function_not_found, name);
+			env_raise_exception(env, exception_function_not_found, "%s", name);
 			return 0;
 		}
 		*function = result;
 		return 1;
 	}
 
-	env_raise_exception(env, exception_function_not_found, name);
+	env_raise_exception(env, exception_function_not_found, "%s", name);
 	return 0;
 }
 
+char *env_read_call_name(env_t *env)
+{
+	class_t *clazz = CURR_FUNC(env)->parentClass;
+	char *name;
+	word_t index;
+
+	if (clazz->version < LB_VERSION_POOL)
+	{
+		name = env->rip;
+		env->rip += strlen(name) + 1;
+		return name;
+	}
+
+	// Pool indices in verified classes were already checked against the pool
+	index = *((word_t *)env->rip);
+	if (!(clazz->flags & CLASS_FLAG_VERIFIED) && index >= clazz->poolsize)
+	{
+		env_raise_exception(env, exception_bad_command, "constant pool index %hu", index);
+		return NULL;
+	}
+	env->rip += sizeof(word_t);
+	return clazz->pool[index];
+}
+
+int env_resolve_static_call(env_t *env, const char *site, char *name, function_t **function)
+{
+	char *paren;
+	char *last;
+	int cacheable;
+
+	*function = (function_t *)map_at(env->vm->callSites, site);
+	if (*function)
+		return 1;
+
+	if (!env_resolve_function_name(env, name, function))
+		return 0;
+
+	// Calls through an object depend on its runtime class, so only calls which name a loaded class are cached
+	paren = strchr(name, '(');
+	*paren = 0;
+	last = strrchr(name, '.');
+	if (last)
+	{
+		*last = 0;
+		cacheable = vm_get_class(env->vm, name) != NULL;
+		if (cacheable && !strchr(name, '.'))
+			cacheable = !env_find_local(env, name); // A local can shadow a class which has no package
+		*last = '.';
+	}
+	else
+		cacheable = 1;
+	*paren = '(';
+
+	if (cacheable)
+		map_insert(env->vm->callSites, site, *function);
+	return 1;
+}
+
 int env_resolve_dynamic_function_name(env_t *env, char *name, function_t **function, data_t **data, flags_t *flags)
 {
 	char *funend = strchr(name, '(');
@@ -1241,46 +1706,77 @@ int env_resolve_dynamic_function_name(env_t *env, char *name, function_t **funct
 	byte_t type = TYPEOF(*flags);
 	if (type != lb_object)
 	{
-		env_raise_exception(env, exception_function_not_found, name);
+		env_raise_exception(env, exception_function_not_found, "%s", name);
 		return 0;
 	}
 
 	object_t *object = (object_t *)(*data)->ovalue;
 	if (!object)
 	{
-		env_raise_exception(env, exception_null_dereference, name);
-		return 0;
-	}
-
-	const char *funcName = last + 1;
-	*function = class_get_function(object->clazz, funcName);
-	if (!(*function))
-	{
-		env_raise_exception(env, exception_function_not_found, name);
+		env_raise_exception(env, exception_null_dereference, "%s", name);
 		return 0;
 	}
 
-	return 1;
+	return env_resolve_virtual_call(env, object, name, last + 1, function);
+}
+
+int env_resolve_virtual_call(env_t *env, object_t *object, const char *site, const char *name, function_t **function)
+{
+	class_t *clazz;
+	function_t *cached = (function_t *)map_at(env->vm->callSites, site);
+
+	// A vtable slot means the same function in every class deriving from the class which introduced it
+	if (cached)
+	{
+		for (clazz = object->clazz; clazz; clazz = clazz->super)
+		{
+			if (clazz == cached->vtableOwner)
+			{
+				*function = object->clazz->vtable[cached->vtableIndex];
+				return 1;
+			}
+		}
+	}
+
+	*function = class_get_function(object->clazz, name);
+	if (!(*function))
+	{
+		env_raise_exception(env, exception_function_not_found, "%s", name);
+		return 0;
+	}
+
+	if (!cached && (*function)->vtableOwner)
+		map_insert(env->vm->callSites, site, *function);
+	return 1;
 }
 
 int env_run_func_staticv(env_t *env, function_t *function, va_list ls)
 {
 	int code;
-	code = env_handle_static_function_callv(env, function, frame_flag_return_native, ls);
-	if (code)
-		return code;
-	if (!(function->flags & FUNCTION_FLAG_NATIVE))
-		code = env_run(env, env->rip);
+
+	// The caller may hold object pointers which a collection would move, so none runs until it returns
+	env->nativeCalls++;
+	code = env_enter_static(env, function, ls);
+	env->nativeCalls--;
 	return code;
 }
 
 int env_run_funcv(env_t *env, function_t *function, object_t *object, va_list ls)
 {
 	int code;
+	env->nativeCalls++;
 	code = env_handle_dynamic_function_callv(env, function, frame_flag_return_native,  object, ls);
-	if (code)
-		return code;
-	code = env_run(env, env->rip);
+	if (!code)
+		code = env_run(env, env->rip);
+	env->nativeCalls--;
+	return code;
+}
+
+int env_enter_static(env_t *env, function_t *function, va_list ls)
+{
+	int code = env_handle_static_function_callv(env, function, frame_flag_return_native, ls);
+	if (!code && !(function->flags & FUNCTION_FLAG_NATIVE))
+		code = env_run(env, env->rip);
 	return code;
 }
 
@@ -1312,33 +1808,246 @@ object_t *env_new_string(env_t *env, const char *cstring)
 	return stringObj;
 }
 
+object_t *env_get_string_literal(env_t *env, const char *literal)
+{
+	reference_t *ref = (reference_t *)map_at(env->vm->strings, literal);
+	if (ref)
+		return ref->object;
+
+	object_t *stringObj = env_new_string(env, literal);
+	if (!stringObj)
+		return NULL;
+
+	// Without the reference the string is still usable, it just won't be reused
+	ref = manager_create_strong_object_reference(env->vm->manager, stringObj);
+	if (ref)
+		map_insert(env->vm->strings, literal, ref);
+
+	return stringObj;
+}
+
 array_t *env_new_string_array(env_t *env, unsigned int count, const char *const strings[])
 {
 	array_t *arr = manager_alloc_array(env->vm->manager, lb_objectarray, count);
 	if (!arr)
 		return NULL;
 	for (unsigned int i = 0; i < count; i++)
+	{
 		array_set_object(arr, i, env_new_string(env, strings[i]));
+		manager_write_barrier(env->vm->manager, (void **)array_get_data(arr, i, sizeof(lobject)));
+	}
 
 	return arr;
 }
 
 int env_raise_exceptionv(env_t *env, int exception, const char *format, va_list ls)
 {
+	const char *cursor, *end;
+	const char *str;
+	size_t count = 0;
+	size_t used = 0;
+	size_t length;
+	int argKind;
+	real8_t real;
+
 	CLEAR_EXCEPTION(env);
 	env->exception = exception;
-	if (format)
-		vsprintf_s(env->message, sizeof(env->message), format, ls);
+
+	// Frames are not popped while an exception unwinds, so the frame chain is enough for a trace
+	env->exceptionRip = env->cmdStart;
+	env->exceptionRbp = env->rbp;
+
+	// Exceptions are often raised and cleared without the message ever being read, so only the
+	// arguments are copied here
+	env->format = format;
+	if (!format)
+		return exception;
+
+	cursor = strchr(format, '%');
+	while (cursor && count < EXCEPTION_MAX_ARGS)
+	{
+		end = parse_format_spec(cursor, &argKind);
+
+		// A '*' width or precision takes an int before the converted argument
+		for (; cursor < end && count < EXCEPTION_MAX_ARGS; cursor++)
+		{
+			if (*cursor == '*')
+				env->formatArgs[count++] = (qword_t)va_arg(ls, int);
+		}
+		if (cursor < end || (argKind != format_arg_none && count >= EXCEPTION_MAX_ARGS))
+			break;
+
+		switch (argKind)
+		{
+		case format_arg_int:
+			env->formatArgs[count++] = (qword_t)va_arg(ls, unsigned int);
+			break;
+		case format_arg_long:
+			env->formatArgs[count++] = (qword_t)va_arg(ls, unsigned long);
+			break;
+		case format_arg_qword:
+			env->formatArgs[count++] = va_arg(ls, qword_t);
+			break;
+		case format_arg_double:
+			real = va_arg(ls, real8_t);
+			MEMCPY(&env->formatArgs[count++], &real, sizeof(real8_t));
+			break;
+		case format_arg_string:
+			// Strings are often names which are freed or rewritten after the raise, so a copy is
+			// kept. Copies are truncated once the buffer fills, as the message can't hold more anyway
+			str = va_arg(ls, const char *);
+			if (!str)
+			{
+				env->formatArgs[count++] = 0;
+				break;
+			}
+			length = strnlen(str, sizeof(env->formatStrings) - used - 1);
+			MEMCPY(env->formatStrings + used, str, length);
+			env->formatStrings[used + length] = 0;
+			env->formatArgs[count++] = (qword_t)(env->formatStrings + used);
+			used += length + 1;
+			if (used >= sizeof(env->formatStrings))
+				used = sizeof(env->formatStrings) - 1;
+			break;
+		case format_arg_pointer:
+			env->formatArgs[count++] = (qword_t)va_arg(ls, void *);
+			break;
+		}
+		cursor = strchr(end, '%');
+	}
+
 	return exception;
 }
 
+const char *env_get_exception_message(env_t *env)
+{
+	const char *cursor, *end;
+	char *out = env->message;
+	size_t left = sizeof(env->message);
+	size_t count = 0;
+	char spec[32];
+	size_t length;
+	int argKind;
+	int written;
+	qword_t arg;
+	real8_t real;
+
+	if (env->message[0] || !env->exception || !env->format)
+		return env->message;
+
+	// Each conversion is formatted on its own with the argument kept for it
+	cursor = env->format;
+	while (*cursor && left > 1)
+	{
+		if (*cursor != '%')
+		{
+			*out++ = *cursor++;
+			left--;
+			continue;
+		}
+
+		// Each '*' is replaced by the width or precision kept for it
+		end = parse_format_spec(cursor, &argKind);
+		length = 0;
+		while (cursor < end && length < sizeof(spec) - 1)
+		{
+			if (*cursor != '*')
+				spec[length++] = *cursor;
+			else
+			{
+				if (count >= EXCEPTION_MAX_ARGS)
+					break;
+				written = _snprintf_s(spec + length, sizeof(spec) - length, _TRUNCATE, "%d", (int)env->formatArgs[count++]);
+				if (written < 0)
+					break;
+				length += written;
+			}
+			cursor++;
+		}
+		if (cursor < end || (argKind != format_arg_none && count >= EXCEPTION_MAX_ARGS))
+			break;
+		spec[length] = 0;
+
+		arg = argKind == format_arg_none ? 0 : env->formatArgs[count++];
+		switch (argKind)
+		{
+		case format_arg_none:
+			written = _snprintf_s(out, left, _TRUNCATE, spec);
+			break;
+		case format_arg_int:
+			written = _snprintf_s(out, left, _TRUNCATE, spec, (unsigned int)arg);
+			break;
+		case format_arg_long:
+			written = _snprintf_s(out, left, _TRUNCATE, spec, (unsigned long)arg);
+			break;
+		case format_arg_qword:
+			written = _snprintf_s(out, left, _TRUNCATE, spec, arg);
+			break;
+		case format_arg_double:
+			MEMCPY(&real, &arg, sizeof(real8_t));
+			written = _snprintf_s(out, left, _TRUNCATE, spec, real);
+			break;
+		case format_arg_string:
+			written = _snprintf_s(out, left, _TRUNCATE, spec, (const char *)arg);
+			break;
+		default:
+			written = _snprintf_s(out, left, _TRUNCATE, spec, (void *)arg);
+			break;
+		}
+
+		// The message was truncated
+		if (written < 0)
+			return env->message;
+
+		out += written;
+		left -= written;
+		cursor = end;
+	}
+
+	*out = 0;
+	return env->message;
+}
+
+void env_print_stack_trace(FILE *file, env_t *env)
+{
+	byte_t *bottomStack = env->stack + env->vm->stackSize;
+	byte_t *rbp = env->exceptionRbp;
+	byte_t *rip = env->exceptionRip;
+	function_t *func;
+	class_t *clazz;
+	debug_elem_t *elem;
+
+	if (!env->exception)
+		return;
+
+	while (rbp < bottomStack)
+	{
+		func = FRAME_FUNC(rbp);
+		clazz = func->parentClass;
+
+		// Source lines are only looked up once a trace is actually printed
+		elem = NULL;
+		if (clazz->debug && !(func->flags & FUNCTION_FLAG_NATIVE))
+			elem = find_debug_elem(clazz->debug, (unsigned int)(rip - clazz->data));
+
+		if (elem)
+			fprintf(file, "%s.%d\n", clazz->debug->srcFile, elem->srcLine);
+		else
+			fprintf(file, "<class %s>.<function %s>\n", clazz->name, func->qualifiedName);
+
+		// Each frame saves the caller's rip, which is where the caller was when it made the call
+		rip = FRAME_RIP(rbp);
+		rbp = PREV_FRAME(rbp);
+	}
+}
+
 int env_get_exception_data(env_t *env, function_t **function, void **location)
 {
 	if (!env->exception)
 		return 0;
 	
-	*function = CURR_FUNC(env);
-	*location = env->cmdStart;
+	*function = FRAME_FUNC(env->exceptionRbp);
+	*location = env->exceptionRip;
 
 	return env->exception;
 }
@@ -1372,10 +2081,14 @@ void env_free(env_t *env)
 			curr->next = NULL;
 			list_free(curr, 0);
 
-			if (next == NULL)
+			if (next)
+				next->prev = prev;
+			else
 				vm->envsLast = prev;
 
-			if (prev == NULL)
+			if (prev)
+				prev->next = next;
+			else
 				vm->envs = next;
 
 			break;
@@ -1431,6 +2144,18 @@ int class_resolve_filename(vm_t *__restrict vm, const char *__restrict classname
 	return 0;
 }
 
+int class_resolve_filename_cached(vm_t *__restrict vm, const char *__restrict classname, char *filename, size_t filenameLen)
+{
+	if (map_find(vm->unresolvedNames, classname))
+		return 0;
+
+	if (class_resolve_filename(vm, classname, filename, filenameLen))
+		return 1;
+
+	map_insert(vm->unresolvedNames, classname, NULL);
+	return 0;
+}
+
 class_t *class_load_to_vm(vm_t *__restrict vm, class_t *__restrict clazz)
 {
 	assert(clazz);
@@ -1450,6 +2175,8 @@ class_t *class_load_to_vm(vm_t *__restrict vm, class_t *__restrict clazz)
 	size_t classnameSize = strlen(clazz->name);
 	array_t *classnameCharArray = manager_alloc_array(vm->manager, lb_chararray, classnameSize);
 	memcpy(&classnameCharArray->data, clazz->name, classnameSize); // normal memcpy - arrays on manager heap
+	// Each object is allocated before the one stored in it, so if the stored one is young so is
+	// the object holding it and no write barrier is needed
 	object_set_object(classnameObject, "chars", classnameCharArray);
 
 	object_set_object(classObject, "name", classnameObject);
@@ -1509,7 +2236,12 @@ static char *resolve_first_class(vm_t *vm, char *name, class_t **result)
 		buildCursor += strsize;
 		*beg = '.';
 
-		if (class_resolve_filename(vm, classBuild, filename, sizeof(filename)))
+		// Classes which are already loaded do not need to be found on the classpath
+		*result = (class_t *)map_at(vm->classes, classBuild);
+		if (*result)
+			return beg;
+
+		if (class_resolve_filename_cached(vm, classBuild, filename, sizeof(filename)))
 		{
 			*result = class_load_filename_override(vm, classBuild, filename, 1, 1, 1);
 			return beg;
@@ -1525,8 +2257,8 @@ static char *resolve_first_class(vm_t *vm, char *name, class_t **result)
 	} while (beg);
 	start += strlen(start);
 
-	*result = NULL;
-	if (class_resolve_filename(vm, name, filename, sizeof(filename)))
+	*result = (class_t *)map_at(vm->classes, name);
+	if (!*result && class_resolve_filename_cached(vm, name, filename, sizeof(filename)))
 		*result = class_load_filename_override(vm, name, filename, 1, 1, 1);
 	return start;
 }
@@ -1556,135 +2288,242 @@ int env_run(env_t *__restrict env, void *__restrict location)
 	class_t *clazz;				// A pointer to a class_t used for holding some class
 	size_t off;					// An arbitrary value for storing an offset
 	byte_t type;				// An arbitrary value for storing a type
+	const char *site;			// Where a call's name operand starts, which keys the call's cache entry
+	int verified;				// Whether the running function's class passed verification, updated whenever the frame changes
+	decoded_t *ip;				// The decoded entry of the command at env->rip, or NULL if the function was not decoded
+	byte_t op;					// The command being dispatched
+	luint ivalue, ivalue2;		// Arbitrary 32-bit integers
+	byte_t type2;				// An arbitrary value for storing a type
+	size_t executed = 0;		// The number of commands dispatched, added to env->executed on return
+
+#if defined(THREADED_DISPATCH)
+	static const void *const dispatch[256] =
+	{
+		[0 ... 255] = &&cmd_unknown,
+		[lb_noop] = &&cmd_lb_noop,
+		[lb_char] = &&cmd_lb_char,
+		[lb_uchar] = &&cmd_lb_uchar,
+		[lb_short] = &&cmd_lb_short,
+		[lb_ushort] = &&cmd_lb_ushort,
+		[lb_int] = &&cmd_lb_int,
+		[lb_uint] = &&cmd_lb_uint,
+		[lb_long] = &&cmd_lb_long,
+		[lb_ulong] = &&cmd_lb_ulong,
+		[lb_bool] = &&cmd_lb_bool,
+		[lb_float] = &&cmd_lb_float,
+		[lb_double] = &&cmd_lb_double,
+		[lb_object] = &&cmd_lb_object,
+		[lb_chararray] = &&cmd_lb_chararray,
+		[lb_uchararray] = &&cmd_lb_uchararray,
+		[lb_shortarray] = &&cmd_lb_shortarray,
+		[lb_ushortarray] = &&cmd_lb_ushortarray,
+		[lb_intarray] = &&cmd_lb_intarray,
+		[lb_uintarray] = &&cmd_lb_uintarray,
+		[lb_longarray] = &&cmd_lb_longarray,
+		[lb_ulongarray] = &&cmd_lb_ulongarray,
+		[lb_boolarray] = &&cmd_lb_boolarray,
+		[lb_floatarray] = &&cmd_lb_floatarray,
+		[lb_doublearray] = &&cmd_lb_doublearray,
+		[lb_objectarray] = &&cmd_lb_objectarray,
+		[lb_setb] = &&cmd_lb_setb,
+		[lb_setw] = &&cmd_lb_setw,
+		[lb_setd] = &&cmd_lb_setd,
+		[lb_setq] = &&cmd_lb_setq,
+		[lb_setr4] = &&cmd_lb_setr4,
+		[lb_setr8] = &&cmd_lb_setr8,
+		[lb_seto] = &&cmd_lb_seto,
+		[lb_setv] = &&cmd_lb_setv,
+		[lb_setr] = &&cmd_lb_setr,
+		[lb_retb] = &&cmd_lb_retb,
+		[lb_retw] = &&cmd_lb_retw,
+		[lb_retd] = &&cmd_lb_retd,
+		[lb_retq] = &&cmd_lb_retq,
+		[lb_retr4] = &&cmd_lb_retr4,
+		[lb_retr8] = &&cmd_lb_retr8,
+		[lb_retv] = &&cmd_lb_retv,
+		[lb_ret] = &&cmd_lb_ret,
+		[lb_retr] = &&cmd_lb_retr,
+		[lb_static_call] = &&cmd_lb_static_call,
+		[lb_dynamic_call] = &&cmd_lb_dynamic_call,
+		[lb_add] = &&cmd_lb_add,
+		[lb_sub] = &&cmd_lb_sub,
+		[lb_mul] = &&cmd_lb_mul,
+		[lb_div] = &&cmd_lb_div,
+		[lb_mod] = &&cmd_lb_mod,
+		[lb_and] = &&cmd_lb_and,
+		[lb_or] = &&cmd_lb_or,
+		[lb_xor] = &&cmd_lb_xor,
+		[lb_lsh] = &&cmd_lb_lsh,
+		[lb_rsh] = &&cmd_lb_rsh,
+		[lb_neg] = &&cmd_lb_neg,
+		[lb_not] = &&cmd_lb_not,
+		[lb_addi] = &&cmd_lb_addi,
+		[lb_subi] = &&cmd_lb_subi,
+		[lb_while] = &&cmd_lb_while,
+		[lb_whilei] = &&cmd_lb_whilei,
+		[lb_if] = &&cmd_lb_if,
+		[lb_ifi] = &&cmd_lb_ifi,
+		[lb_elif] = &&cmd_lb_elif,
+		[lb_else] = &&cmd_lb_else,
+		[lb_end] = &&cmd_lb_end,
+		[lb_switch] = &&cmd_lb_switch,
+		[lb_case] = &&cmd_lb_case,
+		[lb_default] = &&cmd_lb_default,
+		[lb_push] = &&cmd_lb_push,
+		[lb_pop] = &&cmd_lb_pop,
+		[lb_castc] = &&cmd_lb_castc,
+		[lb_castuc] = &&cmd_lb_castuc,
+		[lb_casts] = &&cmd_lb_casts,
+		[lb_castus] = &&cmd_lb_castus,
+		[lb_casti] = &&cmd_lb_casti,
+		[lb_castui] = &&cmd_lb_castui,
+		[lb_castl] = &&cmd_lb_castl,
+		[lb_castul] = &&cmd_lb_castul,
+		[lb_castb] = &&cmd_lb_castb,
+		[lb_castf] = &&cmd_lb_castf,
+		[lb_castd] = &&cmd_lb_castd,
+		[dop_branch] = &&cmd_dop_branch,
+		[dop_jump] = &&cmd_dop_jump,
+		[dop_add32] = &&cmd_dop_add32,
+		[dop_sub32] = &&cmd_dop_sub32,
+		[dop_set32] = &&cmd_dop_set32,
+		[dop_set64] = &&cmd_dop_set64,
+		[dop_move32] = &&cmd_dop_move32,
+		[dop_move64] = &&cmd_dop_move64,
+		[dop_declare] = &&cmd_dop_declare
+	};
+#endif
 
 	__retVal = exception_none;
+	ENTER_FRAME();
 
 	while (env->rip)
 	{
+		SYNC_DECODED();
+	run_decoded:
 		env->cmdStart = env->rip; // Save the start of the current command
+		executed++;
+		op = ip ? ip->op : *env->rip;
 
 		// Switch on the command
-		switch (*env->rip)
+	run_command:
+		switch (op)
 		{
-		case lb_noop:
+		COMMAND(lb_noop):
 			// noop command - just move forward 1 byte
 			env->rip++;
-			break;
-
-		case lb_char:
-		case lb_uchar:
-		case lb_short:
-		case lb_ushort:
-		case lb_int:
-		case lb_uint:
-		case lb_long:
-		case lb_ulong:
-		case lb_bool:
-		case lb_float:
-		case lb_object:
-		case lb_chararray:
-		case lb_uchararray:
-		case lb_shortarray:
-		case lb_ushortarray:
-		case lb_intarray:
-		case lb_uintarray:
-		case lb_longarray:
-		case lb_ulongarray:
-		case lb_boolarray:
-		case lb_floatarray:
-		case lb_doublearray:
-		case lb_objectarray:
+			NEXT_COMMAND();
+
+		COMMAND(lb_char):
+		COMMAND(lb_uchar):
+		COMMAND(lb_short):
+		COMMAND(lb_ushort):
+		COMMAND(lb_int):
+		COMMAND(lb_uint):
+		COMMAND(lb_long):
+		COMMAND(lb_ulong):
+		COMMAND(lb_bool):
+		COMMAND(lb_float):
+		COMMAND(lb_double):
+		COMMAND(lb_object):
+		COMMAND(lb_chararray):
+		COMMAND(lb_uchararray):
+		COMMAND(lb_shortarray):
+		COMMAND(lb_ushortarray):
+		COMMAND(lb_intarray):
+		COMMAND(lb_uintarray):
+		COMMAND(lb_longarray):
+		COMMAND(lb_ulongarray):
+		COMMAND(lb_boolarray):
+		COMMAND(lb_floatarray):
+		COMMAND(lb_doublearray):
+		COMMAND(lb_objectarray):
 			// Handle variable declaration
 
 			type = *env->rip;
 			env->rip++;
-			name = env->rip;
-			if (!is_varname_avaliable(env, name))
-				EXIT_RUN(env_raise_exception(env, exception_bad_variable_name, name));
-			env->rip += strlen(name) + 1;
 			val.flags = 0;
 			val.lvalue = 0;
 			value_set_type(&val, type);
+
+			if (*env->rip == lb_slot)
+			{
+				// The slot was reserved when the frame was created, so only reset it
+				*FRAME_SLOT(env->rbp, *((word_t *)(env->rip + 1))) = val;
+				env->rip += 1 + sizeof(word_t) + 1;
+				NEXT_COMMAND();
+			}
+
+			name = env->rip;
+			if (!is_varname_avaliable(env, name))
+				EXIT_RUN(env_raise_exception(env, exception_bad_variable_name, "%s", name));
+			env->rip += strlen(name) + 1;
 			stackAllocLoc = stack_push(env, &val);
 			if (!stackAllocLoc)
 				EXIT_RUN(env->exception);
 			map_insert((map_t *)env->variables->data, name, stackAllocLoc);
-			break;
+			NEXT_COMMAND();
 
-		case lb_setb:
+		COMMAND(lb_setb):
 			// Set variable to literal byte value
 
 			env->rip++;
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 			memcpy(data, env->rip, sizeof(byte_t));
 			env->rip += sizeof(byte_t);
-			break;
-		case lb_setw:
+			NEXT_COMMAND();
+		COMMAND(lb_setw):
 			// Set variable to literal word value
 
 			env->rip++;
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 			memcpy(data, env->rip, sizeof(word_t));
 			env->rip += sizeof(word_t);
-			break;
-		case lb_setd:
+			NEXT_COMMAND();
+		COMMAND(lb_setd):
 			// Set variable to literal dword value
 
 			env->rip++;
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 			memcpy(data, env->rip, sizeof(dword_t));
 			env->rip += sizeof(dword_t);
-			break;
-		case lb_setq:
+			NEXT_COMMAND();
+		COMMAND(lb_setq):
 			// Set variable to literal qword value
 
 			env->rip++;
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 			memcpy(data, env->rip, sizeof(qword_t));
 			env->rip += sizeof(qword_t);
-			break;
-		case lb_setr4:
+			NEXT_COMMAND();
+		COMMAND(lb_setr4):
 			// Set variable to literal real4 value
 
 			env->rip++;
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 			memcpy(data, env->rip, sizeof(real4_t));
 			env->rip += sizeof(real4_t);
-			break;
-		case lb_setr8:
+			NEXT_COMMAND();
+		COMMAND(lb_setr8):
 			// Set variable to literal real8 value
 
 			env->rip++;
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 			memcpy(data, env->rip, sizeof(real8_t));
 			env->rip += sizeof(real8_t);
-			break;
-		case lb_seto:
+			NEXT_COMMAND();
+		COMMAND(lb_seto):
 			// Set a variable to an object
 
 			env->rip++;
-			name = (const char *)env->rip;
-			if (!env_resolve_variable(env, name, &data2, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data2, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 			switch (*env->rip)
 			{
 			case lb_new:
@@ -1696,14 +2535,14 @@ int env_run(env_t *__restrict env, void *__restrict location)
 				name2 = (const char *)env->rip;
 				clazz = vm_load_class(env->vm, name2); // This function will only load the class if it is not loaded
 				if (!clazz)
-					EXIT_RUN(env_raise_exception(env, exception_class_not_found, name2));
+					EXIT_RUN(env_raise_exception(env, exception_class_not_found, "%s", name2));
 				env->rip += strlen(name2) + 1;
 
 				// Get the constructor function
 				name3 = (const char *)env->rip;
 				callFunc = class_get_function(clazz, name3);
 				if (!callFunc)
-					EXIT_RUN(env_raise_exception(env, exception_function_not_found, name3));
+					EXIT_RUN(env_raise_exception(env, exception_function_not_found, "%s", name3));
 				env->rip += strlen((const char *)env->rip) + 1;
 
 				// Allocate the new object
@@ -1711,6 +2550,7 @@ int env_run(env_t *__restrict env, void *__restrict location)
 				if (!object)
 					EXIT_RUN(env_raise_exception(env, exception_out_of_memory, NULL));
 				data2->ovalue = object;
+				env_write_barrier(env, data2);
 
 				goto handle_dynamic_call_after_resolve; // Call the constructor
 				break;
@@ -1736,9 +2576,8 @@ int env_run(env_t *__restrict env, void *__restrict location)
 					// The size we want to allocate is stored in a variable
 
 					env->rip++;
-					if (!env_resolve_variable(env, env->rip, &data, &flags))
+					if (!env_resolve_operand(env, &env->rip, &data, &flags))
 						EXIT_RUN(env->exception);
-					env->rip += strlen(env->rip) + 1;
 					switch (value_typeof((value_t *)&flags))
 					{
 					case lb_uint:
@@ -1792,7 +2631,7 @@ int env_run(env_t *__restrict env, void *__restrict location)
 				// Create new string
 
 				env->rip++;
-				data2->ovalue = env_new_string(env, env->rip);
+				data2->ovalue = env_get_string_literal(env, env->rip);
 				if (env->exception)
 					EXIT_RUN(env->exception);
 				env->rip += strlen(env->rip) + 1;
@@ -1806,97 +2645,95 @@ int env_run(env_t *__restrict env, void *__restrict location)
 				EXIT_RUN(env_raise_exception(env, exception_bad_command, "seto expected type"));
 				break;
 			}
-			break;
-		case lb_setv:
+			env_write_barrier(env, data2);
+			NEXT_COMMAND();
+		COMMAND(lb_setv):
 			// Set variable to other variable
 
 			env->rip++;
 
 			// Destination variable
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 
 			// Source variable
-			name2 = env->rip;
-			if (!env_resolve_variable(env, name2, &data2, &flags2))
+			if (!env_resolve_operand(env, &env->rip, &data2, &flags2))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name2) + 1;
 
 			// Set
 			if (!static_set(data, flags, data2, flags2))
 				EXIT_RUN(env_raise_exception(env, exception_bad_command, "On static set during setv"));
-			break;
-		case lb_setr:
+			if (IS_REFERENCE_TYPE(value_typeof((value_t *)&flags)))
+				env_write_barrier(env, data);
+			NEXT_COMMAND();
+		COMMAND(lb_setr):
 			// Set variable to the return value of the last function
 
 			env->rip++;
 
 			// Destination variable
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 
 			// Set
 			store_return(env, data, flags);
-			break;
+			if (IS_REFERENCE_TYPE(value_typeof((value_t *)&flags)))
+				env_write_barrier(env, data);
+			NEXT_COMMAND();
 
-		case lb_retb:
+		COMMAND(lb_retb):
 			// Return literal byte value
 			
 			env->rip++;
 			env->bret = *(byte_t *)env->rip;
 			goto general_ret_command_handle;
-			break;
-		case lb_retw:
+			NEXT_COMMAND();
+		COMMAND(lb_retw):
 			// Return literal word value
 
 			env->rip++;
 			env->wret = *(word_t *)env->rip;
 			goto general_ret_command_handle;
-			break;
-		case lb_retd:
+			NEXT_COMMAND();
+		COMMAND(lb_retd):
 			// Return literal dword value
 
 			env->rip++;
 			env->dret = *(dword_t *)env->rip;
 			goto general_ret_command_handle;
-			break;
-		case lb_retq:
+			NEXT_COMMAND();
+		COMMAND(lb_retq):
 			// Return literal qword value
 			
 			env->rip++;
 			env->qret = *(qword_t *)env->rip;
 			goto general_ret_command_handle;
-			break;
-		case lb_retr4:
+			NEXT_COMMAND();
+		COMMAND(lb_retr4):
 			// Return literal real4 value
 
 			env->rip++;
 			env->r4ret = *(real4_t *)env->rip;
 			goto general_ret_command_handle;
-			break;
-		case lb_retr8:
+			NEXT_COMMAND();
+		COMMAND(lb_retr8):
 			// Return literal real8 value
 
 			env->rip++;
 			env->r8ret = *(real8_t *)env->rip;
 			goto general_ret_command_handle;
-			break;
-		case lb_retv:
+			NEXT_COMMAND();
+		COMMAND(lb_retv):
 			// Return variable value
 
 			env->rip++;
-			name = env->rip;
-			if (!env_resolve_variable(env, name, &data, &flags))
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
 				EXIT_RUN(env->exception);
 			memcpy(&env->vret, data, value_sizeof((value_t *)&flags));
 			goto general_ret_command_handle;
-			break;
-		case lb_ret:
-		case lb_retr:
+			NEXT_COMMAND();
+		COMMAND(lb_ret):
+		COMMAND(lb_retr):
 		general_ret_command_handle:
 			// Pop stack frame
 			
@@ -1906,43 +2743,78 @@ int env_run(env_t *__restrict env, void *__restrict location)
 				EXIT_RUN(env_cleanup_call(env, 0));
 			if (env_cleanup_call(env, 0))
 				EXIT_RUN(env->exception);
-			break;
+			ENTER_FRAME();
+			NEXT_COMMAND();
 
-		case lb_static_call:
+		COMMAND(lb_static_call):
 			// Call a static function
 
 			env->rip++;
 
 			// Find function
-			name = env->rip;
-			if (!env_resolve_function_name(env, name, &callFunc))
+			site = (const char *)env->rip;
+			if (!(name = env_read_call_name(env)))
+				EXIT_RUN(env->exception);
+			if (!env_resolve_static_call(env, site, name, &callFunc))
 				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
 			
 			// Get the function arguments as a list
 			callFuncArgs = env_gen_call_arg_list(env, callFunc);
 			if (!callFuncArgs)
 				EXIT_RUN(env->exception);
 
-			// Handle the function call
-			if (__retVal = env_handle_static_function_callv(env, callFunc, 0, callFuncArgs))
+			if (callFunc->intrinsic)
+			{
+				// Intrinsics skip the native call but keep its frame, so an exception they raise
+				// is reported in the function that raised it
+				if (env_create_stack_frame(env, callFunc, 0) != exception_none)
+					EXIT_RUN(env->exception);
+				__retVal = callFunc->intrinsic(env, callFuncArgs);
+				env_cleanup_call(env, 1);
+				if (__retVal)
+					EXIT_RUN(__retVal);
+			}
+			else if (__retVal = env_handle_static_function_callv(env, callFunc, 0, callFuncArgs))
 				EXIT_RUN(__retVal);
 
-			FREE(callFuncArgs);
+			if (callFuncArgs != env->callArgs)
+				FREE(callFuncArgs);
 
-			break;
-		case lb_dynamic_call:
+			ENTER_FRAME();
+			NEXT_COMMAND();
+		COMMAND(lb_dynamic_call):
 			// Call a dynamic function
 
 			env->rip++;
 
 			// Find funuction
-			name = env->rip;
-			if (!env_resolve_dynamic_function_name(env, name, &callFunc, &data, &flags))
-				EXIT_RUN(env->exception);
-			env->rip += strlen(name) + 1;
+			if (CURR_FUNC(env)->parentClass->version >= LB_VERSION_SLOTS)
+			{
+				// The object is a separate operand, followed by the function's qualified name
+				if (!env_resolve_operand(env, &env->rip, &data, &flags))
+					EXIT_RUN(env->exception);
+				site = (const char *)env->rip;
+				if (!(name = env_read_call_name(env)))
+					EXIT_RUN(env->exception);
+				if (TYPEOF(flags) != lb_object)
+					EXIT_RUN(env_raise_exception(env, exception_function_not_found, "%s", name));
+
+				object = data->ovalue;
+				if (!object)
+					EXIT_RUN(env_raise_exception(env, exception_null_dereference, "%s", name));
+
+				if (!env_resolve_virtual_call(env, object, site, name, &callFunc))
+					EXIT_RUN(env->exception);
+			}
+			else
+			{
+				name = env->rip;
+				if (!env_resolve_dynamic_function_name(env, name, &callFunc, &data, &flags))
+					EXIT_RUN(env->exception);
+				env->rip += strlen(name) + 1;
 
-			object = data->ovalue;
+				object = data->ovalue;
+			}
 
 			handle_dynamic_call_after_resolve:
 
@@ -1955,100 +2827,121 @@ int env_run(env_t *__restrict env, void *__restrict location)
 			if (__retVal = env_handle_dynamic_function_callv(env, callFunc, 0, object, (va_list)callFuncArgs))
 				EXIT_RUN(__retVal);
 
-			FREE(callFuncArgs);
-			break;
+			if (callFuncArgs != env->callArgs)
+				FREE(callFuncArgs);
+
+			ENTER_FRAME();
+			NEXT_COMMAND();
 
-		case lb_add:
+		COMMAND(lb_add):
 			// add
 			
 			env->rip++;
 			if (!vmm_add(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_sub:
+			NEXT_COMMAND();
+		COMMAND(lb_sub):
 			// subtract
 
 			env->rip++;
 			if (!vmm_sub(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_mul:
+			NEXT_COMMAND();
+		COMMAND(lb_mul):
 			// multiply
 
 			env->rip++;
 			if (!vmm_mul(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_div:
+			NEXT_COMMAND();
+		COMMAND(lb_div):
 			// divide
 
 			env->rip++;
 			if (!vmm_div(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_mod:
+			NEXT_COMMAND();
+		COMMAND(lb_mod):
 			// modulus
 
 			env->rip++;
 			if (!vmm_mod(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_and:
+			NEXT_COMMAND();
+		COMMAND(lb_and):
 			// bitwise and
 
 			env->rip++;
 			if (!vmm_and(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_or:
+			NEXT_COMMAND();
+		COMMAND(lb_or):
 			// birwise or
 
 			env->rip++;
 			if (!vmm_or(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_xor:
+			NEXT_COMMAND();
+		COMMAND(lb_xor):
 			// exclusive or
 
 			env->rip++;
 			if (!vmm_xor(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_lsh:
+			NEXT_COMMAND();
+		COMMAND(lb_lsh):
 			// left shift
 
 			env->rip++;
 			if (!vmm_lsh(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_rsh:
+			NEXT_COMMAND();
+		COMMAND(lb_rsh):
 			// right shift
 
 			env->rip++;
 			if (!vmm_rsh(env, &env->rip))
 				return env->exception;
-			break;
+			NEXT_COMMAND();
 
-		case lb_neg:
+		COMMAND(lb_neg):
 			// negate
 
 			env->rip++;
 			if (!vmm_neg(env, &env->rip))
 				return env->exception;
-			break;
-		case lb_not:
+			NEXT_COMMAND();
+		COMMAND(lb_not):
 			// bitwise not
 
 			env->rip++;
 			if (!vmm_not(env, &env->rip))
 				return env->exception;
-			break;
+			NEXT_COMMAND();
+
+		COMMAND(lb_addi):
+			// add, quickened to 32-bit integer slots
+
+			env->rip++;
+			if (!vmm_addi(env, &env->rip))
+				EXIT_RUN(env->exception);
+			NEXT_COMMAND();
+		COMMAND(lb_subi):
+			// subtract, quickened to 32-bit integer slots
 
-		case lb_while:
+			env->rip++;
+			if (!vmm_subi(env, &env->rip))
+				EXIT_RUN(env->exception);
+			NEXT_COMMAND();
+
+		COMMAND(lb_while):
+		COMMAND(lb_whilei):
 			// while loop
 
+			GC_SAFEPOINT(env);
+
 			// Perform comparison
-			if (!vmc_compare(env, &env->rip))
+			if (!env_compare(env))
 			{
 				if (env->exception)
 					EXIT_RUN(env->exception);
@@ -2058,17 +2951,18 @@ int env_run(env_t *__restrict env, void *__restrict location)
 			}
 			else
 				env->rip += sizeof(size_t); // comparison suceeds, proceed into body
-			break;
+			NEXT_COMMAND();
 
-		case lb_if:
+		COMMAND(lb_if):
+		COMMAND(lb_ifi):
 			// if or elif statement
 
  			if (handle_if(env))
 				EXIT_RUN(env->exception);
-			break;
-		case lb_elif:
-		case lb_else:
-		case lb_end:
+			NEXT_COMMAND();
+		COMMAND(lb_elif):
+		COMMAND(lb_else):
+		COMMAND(lb_end):
 			// end command
 
 			env->rip++;
@@ -2078,77 +2972,148 @@ int env_run(env_t *__restrict env, void *__restrict location)
 				env->rip += sizeof(size_t); // -1 indicates to proceed directly forward
 			else
 				env->rip = CURR_FUNC(env)->parentClass->data + off; // otherwise, an offset from class data
-			break;
+			NEXT_COMMAND();
+
+		COMMAND(lb_switch):
+			// multi-way branch
 
-		case lb_push:
+			if (handle_switch(env))
+				EXIT_RUN(env->exception);
+			NEXT_COMMAND();
+		COMMAND(lb_case):
+		COMMAND(lb_default):
+			// the previous case ran into the next label, so leave the switch
+
+			env->rip = CURR_FUNC(env)->parentClass->data + *((size_t *)(env->rip + 1));
+			NEXT_COMMAND();
+
+		COMMAND(lb_push):
 			// Pushes 1 qword onto the stack
 
 			env->rip++;
-			switch (*(env->rip))
+			if (*(env->rip) == lb_ret)
 			{
-			case lb_ret:
-				env->rip++;
-				{
-					qword_t *allocated = (qword_t *)stack_alloc(env, 1);
-					if (!allocated)
-						EXIT_RUN(env->exception);
-					*allocated = env->qret;
-				}
-				break;
-			case lb_value:
 				env->rip++;
-				{
-					if (!env_resolve_variable(env, env->rip, &data, &flags))
-						EXIT_RUN(env->exception);
-					qword_t *allocated = (qword_t *)stack_alloc(env, 1);
-					if (!allocated)
-						EXIT_RUN(env->exception);
-					*allocated = data->ulvalue;
-				}
-				break;
-			default:
-				EXIT_RUN(env_raise_exception(env, exception_bad_command, "Invalid push format, must be either ret or value"));
+				qword_t *allocated = (qword_t *)stack_alloc(env, 1);
+				if (!allocated)
+					EXIT_RUN(env->exception);
+				*allocated = env->qret;
+				NEXT_COMMAND();
 			}
 
-			break;
-		case lb_pop:
-			// Pops 1 qword off the stack
-
+			// Verified code only pushes a return value or an operand
+			if (!verified && *(env->rip) != lb_value)
+				EXIT_RUN(env_raise_exception(env, exception_bad_command, "Invalid push format, must be either ret or value"));
 			env->rip++;
-			switch (*(env->rip))
 			{
-			case lb_null:
-				if (!stack_pop(env, 1, NULL))
+				if (!env_resolve_operand(env, &env->rip, &data, &flags))
 					EXIT_RUN(env->exception);
-				break;
-			default:
-				EXIT_RUN(env_raise_exception(env, exception_bad_command, "Invalid pop format, must be null"));
+				qword_t *allocated = (qword_t *)stack_alloc(env, 1);
+				if (!allocated)
+					EXIT_RUN(env->exception);
+				*allocated = data->ulvalue;
 			}
-			break;
+			NEXT_COMMAND();
+		COMMAND(lb_pop):
+			// Pops 1 qword off the stack
 
-		case lb_castc:
-		case lb_castuc:
-		case lb_casts:
-		case lb_castus:
-		case lb_casti:
-		case lb_castui:
-		case lb_castl:
-		case lb_castul:
-		case lb_castb:
-		case lb_castf:
-		case lb_castd:
+			env->rip++;
+			if (!verified && *(env->rip) != lb_null)
+				EXIT_RUN(env_raise_exception(env, exception_bad_command, "Invalid pop format, must be null"));
+			env->rip++;
+			if (!stack_pop(env, 1, NULL))
+				EXIT_RUN(env->exception);
+			NEXT_COMMAND();
+
+		COMMAND(lb_castc):
+		COMMAND(lb_castuc):
+		COMMAND(lb_casts):
+		COMMAND(lb_castus):
+		COMMAND(lb_casti):
+		COMMAND(lb_castui):
+		COMMAND(lb_castl):
+		COMMAND(lb_castul):
+		COMMAND(lb_castb):
+		COMMAND(lb_castf):
+		COMMAND(lb_castd):
 			// Cast variables
 
 			if (!handle_cast(env, &env->rip))
 				EXIT_RUN(env->exception);
-			break;
+			NEXT_COMMAND();
 
-		default:
+		COMMAND(dop_branch):
+			// if or while decoded to compare two integers of up to 32 bits
+
+			if (ip->loop)
+				GC_SAFEPOINT(env);
+
+			if (!decoded_int(env, &ip->lhs, &ivalue, &type) || !decoded_int(env, &ip->rhs, &ivalue2, &type2))
+			{
+				if (env->exception)
+					EXIT_RUN(env->exception);
+				RUN_AS_BYTECODE();
+			}
+
+			// Mixed signedness compares unsigned, as the bytecode comparison does
+			if (type == lb_int && type2 == lb_int)
+				type = (lint)ivalue < (lint)ivalue2 ? compare_less : ivalue == ivalue2 ? compare_equal : compare_greater;
+			else
+				type = ivalue < ivalue2 ? compare_less : ivalue == ivalue2 ? compare_equal : compare_greater;
+
+			if (type & ip->cmp)
+				NEXT_DECODED(ip + 1);
+			NEXT_DECODED(ip->target);
+		COMMAND(dop_jump):
+			// end, else, elif, case or default decoded to their target
+
+			NEXT_DECODED(ip->target);
+		COMMAND(dop_add32):
+			// add decoded to 32-bit integer slots
+
+			ivalue = ip->rhs.kind == decoded_slot ? FRAME_SLOT(env->rbp, ip->rhs.slot)->uivalue : ip->rhs.imm;
+			FRAME_SLOT(env->rbp, ip->dst)->uivalue = FRAME_SLOT(env->rbp, ip->lhs.slot)->uivalue + ivalue;
+			NEXT_DECODED(ip + 1);
+		COMMAND(dop_sub32):
+			// sub decoded to 32-bit integer slots
+
+			ivalue = ip->rhs.kind == decoded_slot ? FRAME_SLOT(env->rbp, ip->rhs.slot)->uivalue : ip->rhs.imm;
+			FRAME_SLOT(env->rbp, ip->dst)->uivalue = FRAME_SLOT(env->rbp, ip->lhs.slot)->uivalue - ivalue;
+			NEXT_DECODED(ip + 1);
+		COMMAND(dop_set32):
+			// setd or setr4 decoded to a plain slot
+
+			FRAME_SLOT(env->rbp, ip->dst)->uivalue = (luint)ip->value;
+			NEXT_DECODED(ip + 1);
+		COMMAND(dop_set64):
+			// setq or setr8 decoded to a plain slot
+
+			FRAME_SLOT(env->rbp, ip->dst)->ulvalue = ip->value;
+			NEXT_DECODED(ip + 1);
+		COMMAND(dop_move32):
+			// setv decoded to plain slots of the same 32-bit type
+
+			FRAME_SLOT(env->rbp, ip->dst)->uivalue = FRAME_SLOT(env->rbp, ip->lhs.slot)->uivalue;
+			NEXT_DECODED(ip + 1);
+		COMMAND(dop_move64):
+			// setv decoded to plain slots of the same 64-bit or reference type, which need no write barrier on the stack
+
+			FRAME_SLOT(env->rbp, ip->dst)->ulvalue = FRAME_SLOT(env->rbp, ip->lhs.slot)->ulvalue;
+			NEXT_DECODED(ip + 1);
+		COMMAND(dop_declare):
+			// Declaration decoded to reset its slot
+
+			FRAME_SLOT(env->rbp, ip->dst)->flags = ip->flags;
+			FRAME_SLOT(env->rbp, ip->dst)->lvalue = 0;
+			NEXT_DECODED(ip + 1);
+
+		default: cmd_unknown:
 			EXIT_RUN(env_raise_exception(env, exception_bad_command, "Unknown instruction 0x%02x", (unsigned int)(*env->rip)));
 		}
 	}
 
 done_call:
+	env->executed += executed;
 
 	return __retVal;
 }
@@ -2170,7 +3135,7 @@ inline int env_create_stack_frame(env_t *__restrict env, function_t *__restrict
 
 inline int env_cleanup_call(env_t *__restrict env, int onlyStackCleanup)
 {
-	if (!onlyStackCleanup)
+	if (!onlyStackCleanup && !(CURR_FLAGS(env) & frame_flag_slots))
 	{
 		map_t *vars = (map_t *)env->variables->data;
 		if (!vars)
@@ -2200,6 +3165,9 @@ inline int env_cleanup_call(env_t *__restrict env, int onlyStackCleanup)
 
 int env_handle_static_function_callv(env_t *__restrict env, function_t *__restrict function, frame_flags_t flags, va_list ls)
 {
+	if (function->slots && !(function->flags & FUNCTION_FLAG_NATIVE))
+		flags |= frame_flag_slots;
+
 	if (env_create_stack_frame(env, function, flags) != exception_none)
 		return env->exception;
 
@@ -2208,116 +3176,56 @@ int env_handle_static_function_callv(env_t *__restrict env, function_t *__restri
 		if (!function->location)
 		{
 			if (!try_link_function(env->vm, function))
-				return env_raise_exception(env, exception_link_error, function->name);
+				return env_raise_exception(env, exception_link_error, "%s", function->name);
 		}
 
-		void *args = CALLOC(function->numargs + 2, sizeof(qword_t));
-
-		//MALLOC((function->numargs * sizeof(qword_t)) + (2 * sizeof(qword_t)));
+		// Arguments are staged in the call's frame, so they are released with it
+		qword_t *args = (qword_t *)stack_alloc(env, function->numargs + 2);
 		if (!args)
-			return env_raise_exception(env, exception_vm_error, "allocate native function arguments");
+			return env->exception;
 
-		void **temp = (void **)args;
-		temp[0] = env;
-		temp[1] = function->parentClass;
+		args[0] = (qword_t)env;
+		args[1] = (qword_t)function->parentClass;
 
-		byte_t *types = NULL;
-		
-		if (function->numargs > 0)
+		char *lsCursor = ls;
+		for (size_t i = 0; i < function->numargs; i++)
 		{
-			types = (byte_t *)MALLOC(sizeof(byte_t) * function->numargs);
-			if (!types)
+			qword_t *outArg = args + 2 + i;
+			*outArg = 0;
+			switch (function->nativeArgTypes[i])
 			{
-				FREE(args);
-				return env_raise_exception(env, exception_vm_error, "allocate native function arguments");
-			}
-
-			if (function->numargs > 0)
-			{
-				size_t i;
-				for (i = 0; i < function->numargs; i++)
-				{
-					switch ((byte_t)map_at(function->argTypes, function->args[i]))
-					{
-					case lb_char:
-					case lb_uchar:
-					case lb_bool:
-						types[i] = lb_byte;
-						break;
-					case lb_short:
-					case lb_ushort:
-						types[i] = lb_word;
-						break;
-					case lb_int:
-					case lb_uint:
-						types[i] = lb_dword;
-						break;
-					case lb_long:
-					case lb_ulong:
-					case lb_object:
-					case lb_boolarray:
-					case lb_chararray:
-					case lb_uchararray:
-					case lb_shortarray:
-					case lb_ushortarray:
-					case lb_intarray:
-					case lb_uintarray:
-					case lb_longarray:
-					case lb_ulongarray:
-					case lb_floatarray:
-					case lb_doublearray:
-					case lb_objectarray:
-						types[i] = lb_qword;
-						break;
-					case lb_float:
-						types[i] = lb_real4;
-						break;
-					case lb_double:
-						types[i] = lb_real8;
-						break;
-					}
-				}
-			}
-
-			size_t *outArgsCursor = (size_t *)args;
-			char *lsCursor = ls;
-			outArgsCursor += 2;
-			for (size_t i = 0; i < function->numargs; i++, outArgsCursor++)
-			{
-				switch (types[i])
-				{
-				case lb_byte:
-					*((byte_t *)outArgsCursor) = *((byte_t *)lsCursor);
-					lsCursor += sizeof(byte_t);
-					break;
-				case lb_word:
-					*((word_t *)outArgsCursor) = *((word_t *)*lsCursor);
-					lsCursor += sizeof(word_t);
-					break;
-				case lb_dword:
-					*((dword_t *)outArgsCursor) = *((dword_t *)lsCursor);
-					lsCursor += sizeof(dword_t);
-					break;
-				case lb_qword:
-					*((qword_t *)outArgsCursor) = *((qword_t *)lsCursor);
-					lsCursor += sizeof(qword_t);
-					break;
-				case lb_real4:
-					*((real4_t *)outArgsCursor) = *((real4_t *)lsCursor);
-					lsCursor += sizeof(real4_t);
-					break;
-				case lb_real8:
-					*((real8_t *)outArgsCursor) = *((real8_t *)lsCursor);
-					lsCursor += sizeof(real8_t);
-					break;
-				}
+			case lb_byte:
+				*((byte_t *)outArg) = *((byte_t *)lsCursor);
+				lsCursor += sizeof(byte_t);
+				break;
+			case lb_word:
+				*((word_t *)outArg) = *((word_t *)lsCursor);
+				lsCursor += sizeof(word_t);
+				break;
+			case lb_dword:
+				*((dword_t *)outArg) = *((dword_t *)lsCursor);
+				lsCursor += sizeof(dword_t);
+				break;
+			case lb_qword:
+				*outArg = *((qword_t *)lsCursor);
+				lsCursor += sizeof(qword_t);
+				break;
+			case lb_real4:
+				*((real4_t *)outArg) = *((real4_t *)lsCursor);
+				lsCursor += sizeof(real4_t);
+				break;
+			case lb_real8:
+				*((real8_t *)outArg) = *((real8_t *)lsCursor);
+				lsCursor += sizeof(real8_t);
+				break;
 			}
 		}
 
+#if defined(_WIN32)
 		env->qret = vm_call_extern_asm(function->numargs + 2, NULL, args, function->location);
-
-		FREE(types);
-		FREE(args);
+#else
+		env->qret = vm_call_extern_sysv(function->numargs + 2, function->nativeArgTypes, args, function->location, function->returnType);
+#endif
 
 		env_cleanup_call(env, 1);
 
@@ -2333,6 +3241,18 @@ int env_handle_static_function_callv(env_t *__restrict env, function_t *__restri
 		}
 		assert(function->location);
 
+		if (flags & frame_flag_slots)
+		{
+			// Arguments and locals are addressed by slot, no name map is needed
+			if (!env_push_frame(env, function, NULL, ls))
+				return env->exception;
+
+			GC_SAFEPOINT(env);
+
+			env->rip = function->location;
+			return exception_none;
+		}
+
 		env->variables->next = list_create();
 		env->variables->next->prev = env->variables;
 		env->variables = env->variables->next;
@@ -2359,16 +3279,7 @@ int env_handle_static_function_callv(env_t *__restrict env, function_t *__restri
 			map_insert((map_t *)env->variables->data, argname, loc);
 		}
 
-		// Register static variables
-		map_iterator_t *sfieldIt = map_create_iterator(function->parentClass->staticFields);
-		while (sfieldIt->node)
-		{
-			const char *fieldName = (const char *)sfieldIt->key;
-			if (!map_find((map_t *)env->variables->data, fieldName))
-				map_insert((map_t *)env->variables->data, fieldName, sfieldIt->value);
-			sfieldIt = map_iterator_next(sfieldIt);
-		}
-		map_iterator_free(sfieldIt);
+		GC_SAFEPOINT(env);
 
 		env->rip = function->location;
 		return exception_none;
@@ -2377,11 +3288,31 @@ int env_handle_static_function_callv(env_t *__restrict env, function_t *__restri
 
 int env_handle_dynamic_function_callv(env_t *__restrict env, function_t *__restrict function, frame_flags_t flags, object_t *object, va_list ls)
 {
+	// An abstract or unlinked vtable entry has no body, so running it would end the run silently
+	if (function->flags & FUNCTION_FLAG_ABSTRACT)
+		return env_raise_exception(env, exception_illegal_state, "attempting to call abstract virtual function %s.%s", function->parentClass->name, function->qualifiedName);
+	if (!function->location)
+		return env_raise_exception(env, exception_illegal_state, "attempting to call unlinked virtual function %s.%s", function->parentClass->name, function->qualifiedName);
+
 	// push the arg list to the stack
 
+	if (function->slots)
+		flags |= frame_flag_slots;
+
 	if (env_create_stack_frame(env, function, flags) != exception_none)
 		return env->exception;
 
+	if (flags & frame_flag_slots)
+	{
+		if (!env_push_frame(env, function, object, ls))
+			return env->exception;
+
+		GC_SAFEPOINT(env);
+
+		env->rip = (byte_t *)function->location;
+		return exception_none;
+	}
+
 	env->variables->next = list_create();
 	env->variables->next->prev = env->variables;
 	env->variables = env->variables->next;
@@ -2405,17 +3336,6 @@ int env_handle_dynamic_function_callv(env_t *__restrict env, function_t *__restr
 		map_insert((map_t *)env->variables->data, argname, loc);
 	}
 
-	// Register static variables
-	map_iterator_t *sfieldIt = map_create_iterator(function->parentClass->staticFields);
-	while (sfieldIt->node)
-	{
-		const char *fieldName = (const char *)sfieldIt->key;
-		if (!map_find((map_t *)env->variables->data, fieldName))
-			map_insert((map_t *)env->variables->data, fieldName, sfieldIt->value);
-		sfieldIt = map_iterator_next(sfieldIt);
-	}
-	map_iterator_free(sfieldIt);
-
 	// Register "this" variable
 	void *thisLoc;
 	value_t thisVal;
@@ -2436,10 +3356,41 @@ int env_handle_dynamic_function_callv(env_t *__restrict env, function_t *__restr
 	}
 	map_iterator_free(mit);*/
 
+	GC_SAFEPOINT(env);
+
 	env->rip = (byte_t *)function->location;
 	return exception_none;
 }
 
+int env_push_frame(env_t *__restrict env, function_t *__restrict function, object_t *object, va_list ls)
+{
+	value_t *slot;
+	size_t size;
+
+	if (function->framesize == 0)
+		return 1;
+
+	// Reserve every slot at once and start from the function's prebuilt frame
+	slot = (value_t *)stack_alloc(env, function->framesize * (sizeof(value_t) / WORD_SIZE));
+	if (!slot)
+		return 0;
+	memcpy(slot, function->frame, function->framesize * sizeof(value_t));
+
+	// Slot order is arguments, "this", then locals
+	for (size_t i = 0; i < function->numargs; i++)
+	{
+		slot = FRAME_SLOT(env->rbp, i);
+		size = value_sizeof(slot);
+		memcpy(&slot->ovalue, ls, size);
+		ls += size;
+	}
+
+	if (object)
+		FRAME_SLOT(env->rbp, function->numargs)->ovalue = object;
+
+	return 1;
+}
+
 va_list env_gen_call_arg_list(env_t *env, function_t *function)
 {
 	byte_t *result;
@@ -2455,7 +3406,8 @@ va_list env_gen_call_arg_list(env_t *env, function_t *function)
 	size_t valueSize;
 	size_t moveSize;
 
-	result = MALLOC(function->argSize);
+	// Arguments are copied into the callee's frame before it runs, so most calls can share one buffer
+	result = function->argSize <= sizeof(env->callArgs) ? env->callArgs : MALLOC(function->argSize);
 	if (!result)
 	{
 		env_raise_exception(env, exception_out_of_memory, "on malloc call arg list");
@@ -2498,6 +3450,18 @@ va_list env_gen_call_arg_list(env_t *env, function_t *function)
 			cursor += 8;
 			env->rip += 8;
 			break;
+		case lb_real4:
+			env->rip++;
+			*((real4_t *)cursor) = *((real4_t *)env->rip);
+			cursor += 4;
+			env->rip += 4;
+			break;
+		case lb_real8:
+			env->rip++;
+			*((real8_t *)cursor) = *((real8_t *)env->rip);
+			cursor += 8;
+			env->rip += 8;
+			break;
 		case lb_ret:
 			env->rip++;
 			switch (callArgType)
@@ -2517,6 +3481,7 @@ va_list env_gen_call_arg_list(env_t *env, function_t *function)
 			case lb_uint:
 			case lb_float:
 				*((dword_t *)cursor) = env->dret;
+				cursor += 4;
 				break;
 			case lb_long:
 			case lb_ulong:
@@ -2535,29 +3500,25 @@ va_list env_gen_call_arg_list(env_t *env, function_t *function)
 			case lb_doublearray:
 			case lb_objectarray:
 				*((qword_t *)cursor) = env->qret;
+				cursor += 8;
 				break;
 			default:
-				FREE(result);
 				env_raise_exception(env, exception_bad_command, "dynamic_call");
-				return NULL;
-				break;
+				goto failed;
 			}
 			break;
 		case lb_string:
 			env->rip++;
-			*((qword_t *)cursor) = (qword_t)env_new_string(env, env->rip);
+			*((qword_t *)cursor) = (qword_t)env_get_string_literal(env, env->rip);
 			if (env->exception)
-				return NULL;
+				goto failed;
 			env->rip += strlen(env->rip) + 1;
 			cursor += 8;
 			break;
 		case lb_value:
 			env->rip++;
-			if (!env_resolve_variable(env, env->rip, &data, &flags))
-			{
-				FREE(result);
-				return NULL;
-			}
+			if (!env_resolve_operand(env, &env->rip, &data, &flags))
+				goto failed;
 			valueType = TYPEOF(flags);
 			valueSize = sizeof_type(valueType);
 			switch (valueType)
@@ -2627,13 +3588,10 @@ va_list env_gen_call_arg_list(env_t *env, function_t *function)
 				//counter += 8;
 				break;
 			}
-			env->rip += strlen(env->rip) + 1;
 			break;
 		default:
-			FREE(result);
 			env_raise_exception(env, exception_bad_command, "dynamic_call");
-			return NULL;
-			break;
+			goto failed;
 		}
 
 		mip = map_iterator_next(mip);
@@ -2641,11 +3599,13 @@ va_list env_gen_call_arg_list(env_t *env, function_t *function)
 	map_iterator_free(mip);
 
 	return (va_list)result;
-}
 
-inline void env_free_call_arg_list(env_t *env, va_list callArgs)
-{
-	FREE(callArgs);
+failed:
+	// The shared buffer belongs to the environment and is only released with it
+	map_iterator_free(mip);
+	if (result != env->callArgs)
+		FREE(result);
+	return NULL;
 }
 
 void *stack_push(env_t *env, value_t *value)
@@ -2686,6 +3646,83 @@ int is_varname_avaliable(env_t *env, const char *name)
 	return 1;
 }
 
+value_t *env_find_local(env_t *env, const char *name)
+{
+	function_t *function = CURR_FUNC(env);
+
+	if (CURR_FLAGS(env) & frame_flag_slots)
+	{
+		size_t slot = (size_t)map_at(function->slots, name);
+		if (slot)
+			return FRAME_SLOT(env->rbp, slot - 1);
+	}
+	else
+	{
+		map_node_t *mapNode = map_find((map_t *)env->variables->data, name);
+		if (mapNode)
+			return (value_t *)mapNode->value;
+	}
+
+	// Statics are not copied into frames, so they are found on the function's class
+	return function ? class_get_static_field(function->parentClass, name) : NULL;
+}
+
+int env_resolve_array_index(env_t *env, array_t *arr, char *name, char *indBeg, data_t **data, flags_t *flags)
+{
+	char *num = indBeg + 1;
+	char *numEnd = strchr(num, ']');
+	luint index;
+	if (!numEnd)
+	{
+		env_raise_exception(env, exception_bad_variable_name, "%s", name);
+		return 0;
+	}
+
+	*numEnd = 0;
+	if (!is_numeric(num))
+	{
+		data_t *indexData;
+		flags_t indexFlags;
+		if (!env_resolve_variable(env, num, &indexData, &indexFlags))
+		{
+			*numEnd = ']';
+			env_raise_exception(env, exception_bad_variable_name, "%s", name);
+			return 0;
+		}
+		*numEnd = ']';
+		index = indexData->uivalue;
+	}
+	else
+	{
+		index = (luint)atoll(num);
+		*numEnd = ']';
+	}
+
+	return env_resolve_array_element(env, arr, index, name, data, flags);
+}
+
+int env_resolve_array_element(env_t *env, array_t *arr, luint index, const char *name, data_t **data, flags_t *flags)
+{
+	if (!arr)
+	{
+		env_raise_exception(env, exception_null_dereference, "%s", name);
+		return 0;
+	}
+
+	if (index >= arr->length)
+	{
+		env_raise_exception(env, exception_bad_array_index, "%s at %u", name ? name : "array", index);
+		return 0;
+	}
+
+	byte_t elemType = value_typeof((value_t *)arr) - lb_object + lb_char - 1;
+	size_t valsize = sizeof_type(elemType);
+	*flags = 0;
+	value_set_type((value_t *)flags, elemType);
+	*data = (data_t *)((byte_t *)&arr->data + (valsize * index));
+	return 1;
+}
+
 int static_set(data_t *dst, flags_t dstFlags, data_t *src, flags_t srcFlags)
 {
 	byte_t dstType, srcType;
@@ -2750,8 +3787,70 @@ int static_set(data_t *dst, flags_t dstFlags, data_t *src, flags_t srcFlags)
 	}
 }
 
+int build_native_arg_types(function_t *func)
+{
+	byte_t *types;
+
+	if (func->numargs == 0)
+		return 1;
+
+	types = (byte_t *)MALLOC(sizeof(byte_t) * func->numargs);
+	if (!types)
+		return 0;
+
+	// Each argument is passed in one 8-byte slot, so only the width of the copy depends on the type
+	for (size_t i = 0; i < func->numargs; i++)
+	{
+		switch ((byte_t)map_at(func->argTypes, func->args[i]))
+		{
+		case lb_char:
+		case lb_uchar:
+		case lb_bool:
+			types[i] = lb_byte;
+			break;
+		case lb_short:
+		case lb_ushort:
+			types[i] = lb_word;
+			break;
+		case lb_int:
+		case lb_uint:
+			types[i] = lb_dword;
+			break;
+		case lb_long:
+		case lb_ulong:
+		case lb_object:
+		case lb_boolarray:
+		case lb_chararray:
+		case lb_uchararray:
+		case lb_shortarray:
+		case lb_ushortarray:
+		case lb_intarray:
+		case lb_uintarray:
+		case lb_longarray:
+		case lb_ulongarray:
+		case lb_floatarray:
+		case lb_doublearray:
+		case lb_objectarray:
+			types[i] = lb_qword;
+			break;
+		case lb_float:
+			types[i] = lb_real4;
+			break;
+		case lb_double:
+			types[i] = lb_real8;
+			break;
+		}
+	}
+
+	func->nativeArgTypes = types;
+	return 1;
+}
+
 int try_link_function(vm_t *__restrict vm, function_t *__restrict func)
 {
+	if (!func->nativeArgTypes && !build_native_arg_types(func))
+		return 0;
+
 #if defined(_WIN32)
 	char decName[512];
 	sprintf_s(decName, sizeof(decName), "%s_%s", func->parentClass->safeName, func->name);
@@ -2766,10 +3865,70 @@ int try_link_function(vm_t *__restrict vm, function_t *__restrict func)
 		}
 	}
 #else
+	char decName[512];
+	snprintf(decName, sizeof(decName), "%s_%s", func->parentClass->safeName, func->name);
+
+	// Arguments which overflow the registers are passed on the stack, where the thunk has a fixed amount of room
+	if (!vm_sysv_can_call(func->numargs + 2, func->nativeArgTypes))
+		return 0;
+
+	for (size_t i = 0; i < vm->libraryCount; i++)
+	{
+		if (vm->hLibraries[i])
+		{
+			func->location = dlsym(vm->hLibraries[i], decName);
+			if (func->location)
+				return 1;
+		}
+	}
 #endif
 	return 0;
 }
 
+int try_link_aot_function(vm_t *__restrict vm, function_t *__restrict func)
+{
+	void *location;
+
+	if (!(func->flags & FUNCTION_FLAG_STATIC) || (func->flags & (FUNCTION_FLAG_NATIVE | FUNCTION_FLAG_ABSTRACT)))
+		return 0;
+
+#if defined(_WIN32)
+	// vm_call_extern_asm only passes arguments in the integer registers and reads the result from
+	// rax, so a translated function taking or returning a real stays interpreted
+	if (func->returnType == lb_float || func->returnType == lb_double)
+		return 0;
+	for (size_t i = 0; i < func->numargs; i++)
+	{
+		byte_t type = (byte_t)map_at(func->argTypes, func->args[i]);
+		if (type == lb_float || type == lb_double)
+			return 0;
+	}
+#endif
+
+	// An ahead-of-time compiled function is exported under the same name as a native one,
+	// and once found is called exactly like one
+	location = func->location;
+	if (try_link_function(vm, func))
+	{
+		func->flags |= FUNCTION_FLAG_NATIVE;
+		return 1;
+	}
+
+	func->location = location;
+	return 0;
+}
+
+void link_aot_functions(vm_t *__restrict vm, class_t *__restrict clazz)
+{
+	map_iterator_t *mit = map_create_iterator(clazz->functions);
+	while (mit->node)
+	{
+		try_link_aot_function(vm, (function_t *)mit->value);
+		mit = map_iterator_next(mit);
+	}
+	map_iterator_free(mit);
+}
+
 void vm_start_routine(start_args_t *args)
 {
 	class_t *clazz = NULL;
@@ -2793,21 +3952,35 @@ void vm_start_routine(start_args_t *args)
 		env_t *env = env_create(vm);
 		if (env)
 		{
-			int exception = env_run_func_static(env, func, args->args);
+			// Nothing waits on the main function but the thread itself, so it is entered without
+			// counting as a native call and collects garbage as it runs
+			qword_t start = GetTickCount64();
+			int exception = env_enter_static(env, func, (va_list)&args->args);
+			if (vm->flags & vm_flag_time)
+			{
+				qword_t elapsed = GetTickCount64() - start;
+				printf("Executed %llu commands in %llu ms", (qword_t)env->executed, elapsed);
+				if (elapsed)
+					printf(" (%llu commands per second)", (qword_t)env->executed * 1000 / elapsed);
+				putc('\n', stdout);
+			}
 			if (exception)
 			{
-				env_snapshot_t *ss = env_take_snapshot(env);
+				const char *message = env_get_exception_message(env);
+				function_t *exceptionFunc;
+				void *exceptionLocation;
+
+				env_get_exception_data(env, &exceptionFunc, &exceptionLocation);
 
 				putc('\n', stdout);
-				if (env->message[0])
-					printf("Internal exception %s raised with message \"%s\"\n", g_exceptionStrings[exception], env->message);
+				if (message[0])
+					printf("Internal exception %s raised with message \"%s\"\n", g_exceptionStrings[exception], message);
 				else
 					printf("Internal exception %s raised\n", g_exceptionStrings[exception]);
 				 
 				printf("Outputting known information up to exception:\n");
 				printf("Exception occurred during execution in environment %p\n", env);
 				
-				function_t *exceptionFunc = ss->function.handle;
 				/*printf("Top stack frame parameters of suspect environment:\n");
 				printf("(rbp + 0) (last stack frame rbp) = %p\n", *((size_t **)env->rbp));
 				printf("(rbp + 1) (last stack frame rip) = %p\n", *((size_t **)env->rbp + 1));
@@ -2817,12 +3990,16 @@ void vm_start_routine(start_args_t *args)
 				printf("\tname = \"%s\"\n", exceptionFunc->name);
 				printf("\tqualifiedName = \"%s\"\n", exceptionFunc->qualifiedName);
 				printf("\tparentClass = \"%s\"\n", exceptionFunc->parentClass->name);
-				printf("\trelativeLocation = %p\n", (void *)ss->function.relativeLocation);
+				// A native function's location is its address in a library, or NULL when it runs as
+				// an intrinsic, so neither is relative to the class
+				if (!(exceptionFunc->flags & FUNCTION_FLAG_NATIVE))
+					printf("\trelativeLocation = %p\n", (void *)((byte_t *)exceptionFunc->location - exceptionFunc->parentClass->data));
 				printf("}\n");
 
-				printf("Exception location relative to function: %p\n", (void *)ss->exec.execFuncOffset);
+				if (!(exceptionFunc->flags & FUNCTION_FLAG_NATIVE))
+					printf("Exception location relative to function: %p\n", (void *)((byte_t *)exceptionLocation - (byte_t *)exceptionFunc->location));
 
-				print_stack_trace(stdout, env, (vm->flags & vm_flag_verbose) || (vm->flags & vm_flag_verbose_errors));
+				env_print_stack_trace(stdout, env);
 
 				if ((vm->flags & vm_flag_verbose) || (vm->flags & vm_flag_verbose_errors))
 				{
@@ -2897,40 +4074,144 @@ void vm_start_routine(start_args_t *args)
 	}
 }
 
-void print_stack_trace(FILE *file, env_t *env, int printVars)
+void vm_mark_roots(manager_t *manager, void *param)
 {
-	byte_t *bottomStack = env->stack + env->vm->stackSize;
-	byte_t *rbp = env->rbp;
-	function_t *func;
+	vm_t *vm = (vm_t *)param;
+	list_iterator_t *lit;
+	map_iterator_t *mit;
+	list_t *variables;
+	env_t *env;
+	byte_t *rbp;
+	function_t *function;
+	value_t *value;
 	class_t *clazz;
-	unsigned int intOff;
-	debug_elem_t *elem;
 
-	while (rbp < bottomStack)
+	lit = list_create_iterator(vm->envs);
+	while (lit)
 	{
-		func = FRAME_FUNC(rbp);
-		clazz = func->parentClass;
+		env = (env_t *)lit->data;
+		if (!env)
+		{
+			lit = list_iterator_next(lit);
+			continue;
+		}
 
-		if (clazz->debug)
+		// Slot frames carry the type of every slot, so only references are followed
+		for (rbp = env->rbp; rbp != env->stack + vm->stackSize; rbp = PREV_FRAME(rbp))
 		{
-			intOff = (unsigned int)(FRAME_RIP(rbp) - clazz->data);
-			elem = find_debug_elem(clazz->debug, intOff);
-			if (elem)
+			function = FRAME_FUNC(rbp);
+			if (!(*((frame_flags_t *)rbp - 1) & frame_flag_slots))
+				continue;
+
+			for (size_t i = 0; i < function->framesize; i++)
 			{
-				fprintf(file, "%s.%d\n", clazz->debug->srcFile, elem->srcLine);
+				value = FRAME_SLOT(rbp, i);
+				if (IS_REFERENCE_TYPE(value_typeof(value)))
+					manager_mark(manager, (void **)&value->ovalue);
 			}
-			else
+		}
+
+		// Frames of earlier class versions keep their variables in name maps
+		for (variables = env->variables; variables->prev; variables = variables->prev)
+		{
+			mit = map_create_iterator((map_t *)variables->data);
+			while (mit->node)
 			{
-				fprintf(file, "<class %s>.<function %s>\n", clazz->name, func->qualifiedName);
+				value = (value_t *)mit->value;
+				if (IS_REFERENCE_TYPE(value_typeof(value)))
+					manager_mark(manager, (void **)&value->ovalue);
+				mit = map_iterator_next(mit);
 			}
+			map_iterator_free(mit);
 		}
-		else
+
+		lit = list_iterator_next(lit);
+	}
+
+	mit = map_create_iterator(vm->classes);
+	while (mit->node)
+	{
+		clazz = (class_t *)mit->value;
+		for (size_t i = 0; i < clazz->numstatics; i++)
 		{
-			fprintf(file, "<class %s>.<function %s>\n", clazz->name, func->qualifiedName);
+			value = clazz->statics[i];
+			if (IS_REFERENCE_TYPE(value_typeof(value)))
+				manager_mark(manager, (void **)&value->ovalue);
 		}
+		mit = map_iterator_next(mit);
+	}
+	map_iterator_free(mit);
+}
 
-		rbp = PREV_FRAME(rbp);
+const char *parse_format_spec(const char *spec, int *argKind)
+{
+	int longs = 0;
+
+	spec++;
+	if (*spec == '%')
+	{
+		*argKind = format_arg_none;
+		return spec + 1;
+	}
+
+	// Flags, width and precision, where '*' takes the value from an int argument
+	spec += strspn(spec, "-+ #0123456789.*");
+
+	// Length modifiers
+	while (*spec == 'h' || *spec == 'l' || *spec == 'z' || *spec == 'j' || *spec == 't' || *spec == 'I' || *spec == 'L')
+	{
+		if (*spec == 'l')
+			longs++;
+		else if (*spec == 'z' || *spec == 'j' || *spec == 't')
+			longs = 2;
+		else if (*spec == 'I')
+		{
+			// Microsoft's I, I32 and I64 prefixes
+			if (spec[1] == '6' && spec[2] == '4')
+			{
+				longs = 2;
+				spec += 2;
+			}
+			else if (spec[1] == '3' && spec[2] == '2')
+				spec += 2;
+			else
+				longs = 2;
+		}
+		spec++;
+	}
+
+	switch (*spec)
+	{
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+	case 'c':
+		*argKind = longs >= 2 ? format_arg_qword : longs == 1 ? format_arg_long : format_arg_int;
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		*argKind = format_arg_double;
+		break;
+	case 's':
+		*argKind = format_arg_string;
+		break;
+	case 'p':
+		*argKind = format_arg_pointer;
+		break;
+	default:
+		*argKind = format_arg_none;
+		return *spec ? spec + 1 : spec;
 	}
+	return spec + 1;
 }
 
 size_t default_write_stdout(const char *buf, size_t count)
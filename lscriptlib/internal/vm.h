@@ -5,6 +5,7 @@
 #include "types.h"
 #include "datau.h"
 #include <stdarg.h>
+#include <stdio.h>
 
 #if defined(_WIN32)
 #include <Windows.h>
@@ -18,7 +19,9 @@ The maximum length of an exception string.
 #define MAX_EXCEPTION_STRING_LENGTH 256
 
 #define EMSGLEN 256
+#define EXCEPTION_MAX_ARGS 4	// The most arguments an exception's message format may take
 #define HISTLEN 64
+#define CALLARGLEN 256
 
 #define CLASS_CLASSNAME "lscript.lang.Class"
 #define OBJECT_CLASSNAME "lscript.lang.Object"
@@ -29,6 +32,16 @@ Checks if verbose error messages should be used given flags.
 */
 #define DO_VERBOSE_ERR(flags) (((flags)&vm_flag_verbose)||((flags)&vm_flag_verbose_errors))
 
+/*
+Returns a pointer to the value_t in a slot of a stack frame, given the frame's base pointer.
+*/
+#define FRAME_SLOT(rbp, slot) (((value_t*)(rbp))-3-(slot))
+
+/*
+Returns the function_t running in an environment's current stack frame.
+*/
+#define CURR_FUNC(env) (*(((function_t**)(env)->rbp)-2))
+
 typedef struct vm_s vm_t;
 typedef struct vm_snapshot_s vm_snapshot_t;
 typedef struct env_snapshot_s env_snapshot_t;
@@ -56,7 +69,10 @@ enum
 {
 	vm_flag_verbose =			0x1,	// Print verbose output
 	vm_flag_no_load_debug =		0x2,	// Don't load debugging symbols
-	vm_flag_verbose_errors =	0x4		// Print verbose error output
+	vm_flag_verbose_errors =	0x4,	// Print verbose error output
+	vm_flag_aot =				0x8,	// Run static functions exported by loaded libraries instead of their bytecode
+	vm_flag_no_decode =			0x10,	// Run verified functions from their bytecode rather than decoding them when loaded
+	vm_flag_time =				0x20	// Print how long the main function ran and how many commands it executed
 };
 
 struct vm_s
@@ -72,6 +88,11 @@ struct vm_s
 
 	map_t *loadedClassObjects;	// A map which maps class names to Class object instances
 
+	map_t *unresolvedNames;		// Names which are known to not be classes on the classpath
+	map_t *callSites;			// A map which maps call sites in bytecode to their resolved functions (for dynamic calls, whose vtable slot to use)
+	map_t *fieldSites;			// A map which maps field names in bytecode to the class and field they last resolved to
+	map_t *strings;				// A map which maps string literals in bytecode to a strong reference to their interned String
+
 #if defined(WIN32)
 	HMODULE *hLibraries;		// Loaded modules
 	HANDLE hVMThread;			// The thread the virtual machine is running on
@@ -79,6 +100,7 @@ struct vm_s
 	
 	DWORD dwPadding;			// 4-byte padding
 #else
+	void **hLibraries;			// Loaded modules, as returned by dlopen
 #endif
 	size_t libraryCount;		// The maximum number of libraries which can be loaded
 
@@ -101,8 +123,19 @@ struct env_s
 
 	byte_t cmdHistory[HISTLEN];	// An array of the previous commands executed - updated if launched with -verbose
 
+	byte_t callArgs[CALLARGLEN];	// Scratch space for a call's arguments, which are copied out before the callee runs
+
+	size_t executed;			// The number of commands env_run has finished dispatching in this environment
+
+	int nativeCalls;			// The number of calls from native code into this environment in progress, its safepoints only collect garbage while 0
+
 	int exception;				// The most recent exception which was thrown
-	char message[EMSGLEN];		// The message associated with the exception
+	const char *format;			// The format of the exception's message, or NULL if it has none
+	qword_t formatArgs[EXCEPTION_MAX_ARGS];	// The format's arguments, kept raw until the message is needed
+	char formatStrings[EMSGLEN];	// Copies of the format's string arguments, which formatArgs points into
+	byte_t *exceptionRip;		// The start of the command which raised the exception
+	byte_t *exceptionRbp;		// The stack frame the exception was raised in, which links to its callers' frames
+	char message[EMSGLEN];		// The message associated with the exception, formatted by env_get_exception_message
 
 	union
 	{
@@ -167,6 +200,9 @@ Creates a new virtual machine with the designated parameters.
 
 @param heapSize The size of the heap.
 @param stackSize The size of the stack, per thread.
+@param gcThreshold The number of bytes which may be allocated on the heap before a garbage
+collection is run. The threshold grows with the amount of live data so collections never become
+more frequent than the program's allocations. If 0, garbage is never collected automatically.
 @param flags Creation flags.
 @param pathCount The length of paths.
 @param paths The paths for which the virtual machine will search for classes on. The first
@@ -178,7 +214,7 @@ each NULL field will cause the default IO function to be used for that field.
 
 @return The new virtual machine, or NULL if creation failed.
 */
-vm_t *vm_create(size_t heapSize, size_t stackSize, void *lsAPILib, vm_flags_t flags, int pathCount, const char *const paths[], const ls_stdio_t *stdio);
+vm_t *vm_create(size_t heapSize, size_t stackSize, size_t gcThreshold, void *lsAPILib, vm_flags_t flags, int pathCount, const char *const paths[], const ls_stdio_t *stdio);
 
 /*
 Starts the virtual machine on a main function with the given arguments.
@@ -257,7 +293,9 @@ void vm_add_path(vm_t *vm, const char *path);
 
 /*
 Loads a native library onto the virtual machine. The name of the library
-should not include native extensions (such as .dll).
+should not include native extensions (such as .dll). If the virtual machine was
+created with vm_flag_aot, the static functions of every loaded class are linked
+against the library.
 
 @param vm The virtual machine to load the library onto.
 @param libpath The path of the native library, excluding native extensions.
@@ -275,6 +313,33 @@ any threads, in milliseconds.
 */
 void vm_free(vm_t *vm, unsigned long threadWaitTime);
 
+/*
+Collects garbage on the virtual machine's heap. Every object reachable from a frame of some
+environment, a static field or a strong reference survives. The return value of a call is not
+a root, so native code holding onto an object across calls into the virtual machine must
+create a strong reference to it.
+
+Surviving young objects are moved onto the heap, which updates the frames, statics and strong
+references holding them. Any other pointer to an object native code holds is left dangling.
+
+@param vm The virtual machine to collect garbage on.
+*/
+void vm_gc(vm_t *vm);
+
+/*
+Collects garbage on the virtual machine's heap, as vm_gc does. The young generation is always
+collected, the rest of the heap only when full is nonzero or the heap's collection threshold is
+crossed.
+
+The virtual machine calls this itself at loop heads and function entries once the young
+generation fills up or the threshold is crossed, unless native code is waiting on a call into
+the environment reaching the safepoint.
+
+@param vm The virtual machine to collect garbage on.
+@param full Whether to collect the whole heap.
+*/
+void vm_collect(vm_t *vm, int full);
+
 /*
 Creates a snapshot of the current execution status of an environment and virtual
 machine. Snapshots can be expensive, especially with large heap and stack sizes as
@@ -333,12 +398,32 @@ raised in the environment.
 */
 int env_resolve_variable(env_t *env, char *name, data_t **data, flags_t *flags);
 
+/*
+Resolves a variable operand in the bytecode. The operand is either a variable name or, in
+version 2 classes, an lb_slot or lb_static_slot reference followed by a field path, or an
+lb_element pairing an array operand with its index. If the find fails, an exception will be
+raised in the environment.
+
+@param env The environment to resolve the operand in.
+@param location A pointer to the location of the operand, which will be advanced past the
+operand on success.
+@param data A pointer to a pointer which will point to the data stored in the variable on success.
+@param flags A pointer to a flags_t which will store the flags carried by the variable on success.
+
+@return 1 on success and 0 otherwise.
+*/
+int env_resolve_operand(env_t *env, byte_t **location, data_t **data, flags_t *flags);
+
 /*
 Resolves an object field in an environment. If the find fails, an exception will be
 raised in the environment.
 
+Each field in name is cached by its address, so name must point into a loaded class's
+bytecode.
+
 @param env The environment to resolve the field in.
 @param object The source object.
+@param name The field path, relative to object.
 @param data A pointer to a pointer which will point to the data stored in the field on success.
 @param flags A pointer to a flags_t which will store the flags carried by the field on success.
 
@@ -406,6 +491,18 @@ Creates a new String object on the virtual machine heap from a C-style string.
 */
 object_t *env_new_string(env_t *env, const char *cstring);
 
+/*
+Gets the interned String for a string literal. The String is created on the first call and
+kept alive by a strong reference, so every later call for the same literal returns the same
+object without allocating.
+
+@param env The environment to create the string in.
+@param literal The string literal, which must point into a class's bytecode.
+
+@return The interned String object, or NULL if creation failed.
+*/
+object_t *env_get_string_literal(env_t *env, const char *literal);
+
 /*
 Creates a new array of Strings on the virtual machine heap from an array of
 C-style strings.
@@ -421,7 +518,10 @@ creation failed.
 array_t *env_new_string_array(env_t *env, unsigned int count, const char *const strings[]);
 
 /*
-Raises an exception on an environment.
+Raises an exception on an environment. Only the arguments are stored, the message is
+formatted by env_get_exception_message, so format must stay valid until the exception is
+cleared. String arguments are copied. At most EXCEPTION_MAX_ARGS arguments are kept, counting
+each '*' width or precision.
 
 @param env The environment to raise the exception in.
 @param exception The exception to raise.
@@ -433,7 +533,7 @@ Raises an exception on an environment.
 int env_raise_exceptionv(env_t *env, int exception, const char *format, va_list ls);
 
 /*
-Raises an exception on an environment.
+Raises an exception on an environment. See env_raise_exceptionv.
 
 @param env The environment to raise the exception in.
 @param exception The exception to raise.
@@ -451,6 +551,26 @@ inline int env_raise_exception(env_t *env, int exception, const char *format, ..
 	return result;
 }
 
+/*
+Returns the message of the exception raised in an environment. The message is formatted the
+first time it is requested, rather than when the exception is raised.
+
+@param env The environment the exception was raised in.
+
+@return The message, which is empty if no exception was raised or it had no message.
+*/
+const char *env_get_exception_message(env_t *env);
+
+/*
+Prints the stack trace of the exception raised in an environment, innermost frame first. Each
+frame is printed as a source line if its class has debug information, or by its function's
+name otherwise.
+
+@param file The file to print to.
+@param env The environment the exception was raised in.
+*/
+void env_print_stack_trace(FILE *file, env_t *env);
+
 /*
 Returns the data surrounding an exception if one was raised.
 
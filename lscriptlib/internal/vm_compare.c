@@ -126,6 +126,9 @@ break; \
 };
 
 static int resolve_data(env_t *env, byte_t **counterPtr, data_t **data, flags_t *flags);
+static int resolve_int(env_t *env, byte_t **counterPtr, luint *value, int *isSigned);
+
+#define IS_INT32_TYPE(type) ((type) == lb_int || (type) == lb_uint)
 
 int vmc_compare(void *envPtr, byte_t **counterPtr)
 {
@@ -133,6 +136,7 @@ int vmc_compare(void *envPtr, byte_t **counterPtr)
 
     data_t *lhs, *rhs;
     flags_t lhf, rhf;
+    byte_t *command = *counterPtr;
 
     (*counterPtr)++;
     byte_t count = **counterPtr;
@@ -162,6 +166,15 @@ int vmc_compare(void *envPtr, byte_t **counterPtr)
             return 0;
         }
 
+        // Integer comparisons are the common loop condition, so later runs skip the type switch
+        if (IS_INT32_TYPE(TYPEOF(lhf)) && IS_INT32_TYPE(TYPEOF(rhf)))
+        {
+            if (*command == lb_while)
+                *command = lb_whilei;
+            else if (*command == lb_if)
+                *command = lb_ifi;
+        }
+
         switch (comparator)
         {
         case lb_equal:
@@ -253,9 +266,8 @@ int resolve_data(env_t *env, byte_t **counterPtr, data_t **data, flags_t *flags)
         counter += sizeof(lbool);
         break;
     case lb_value:
-        if (!env_resolve_variable(env, (const char *)counter, data, flags))
+        if (!env_resolve_operand(env, &counter, data, flags))
             return 0;
-        counter += strlen(counter) + 1;
         *counterPtr = counter;
         return 1;
         break;
@@ -267,3 +279,91 @@ int resolve_data(env_t *env, byte_t **counterPtr, data_t **data, flags_t *flags)
     *counterPtr = counter;
     return 1;
 }
+
+int vmc_compare_int(void *envPtr, byte_t **counterPtr)
+{
+    env_t *env = (env_t *)envPtr;
+    byte_t *command = *counterPtr;
+    byte_t *counter = command + 2; // Skip the command and the count, which is always two
+    luint lhs, rhs;
+    int lhsSigned, rhsSigned;
+    int status;
+    byte_t comparator;
+
+    status = resolve_int(env, &counter, &lhs, &lhsSigned);
+    if (status == 1)
+    {
+        comparator = *counter;
+        counter++;
+        status = resolve_int(env, &counter, &rhs, &rhsSigned);
+    }
+
+    if (status == -1)
+        return 0;
+    if (status == 0)
+    {
+        *command = *command == lb_whilei ? lb_while : lb_if;
+        return vmc_compare(env, counterPtr);
+    }
+
+    *counterPtr = counter;
+
+    // Mixed signedness compares unsigned, as the generic comparison does
+    if (lhsSigned && rhsSigned)
+    {
+        switch (comparator)
+        {
+        case lb_equal:
+            return (lint)lhs == (lint)rhs;
+        case lb_nequal:
+            return (lint)lhs != (lint)rhs;
+        case lb_greater:
+            return (lint)lhs > (lint)rhs;
+        case lb_gequal:
+            return (lint)lhs >= (lint)rhs;
+        case lb_less:
+            return (lint)lhs < (lint)rhs;
+        case lb_lequal:
+            return (lint)lhs <= (lint)rhs;
+        }
+    }
+    else
+    {
+        switch (comparator)
+        {
+        case lb_equal:
+            return lhs == rhs;
+        case lb_nequal:
+            return lhs != rhs;
+        case lb_greater:
+            return lhs > rhs;
+        case lb_gequal:
+            return lhs >= rhs;
+        case lb_less:
+            return lhs < rhs;
+        case lb_lequal:
+            return lhs <= rhs;
+        }
+    }
+
+    env_raise_exception(env, exception_bad_command, "invalid comparator %x", (unsigned int)comparator);
+    return 0;
+}
+
+int resolve_int(env_t *env, byte_t **counterPtr, luint *value, int *isSigned)
+{
+    data_t *data;
+    flags_t flags;
+    byte_t type;
+
+    if (!resolve_data(env, counterPtr, &data, &flags))
+        return env->exception ? -1 : 0;
+
+    type = TYPEOF(flags);
+    if (!IS_INT32_TYPE(type))
+        return 0;
+
+    *value = data->uivalue;
+    *isSigned = type == lb_int;
+    return 1;
+}
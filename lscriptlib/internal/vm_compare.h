@@ -14,6 +14,18 @@ enum
 };
 
 int vmc_compare(void *envPtr, byte_t **counterPtr);
+
+/*
+Performs the comparison of an if or while command which has been quickened into ifi or whilei,
+comparing both sides directly as 32-bit integers. If either side is no longer a 32-bit integer,
+the command is turned back into if or while and compared generically.
+
+@param envPtr A pointer to the env_t the command is running in
+@param counterPtr A pointer to the location of the command, which will be advanced to the branch offset
+
+@return 1 if the comparison passed, 0 if it failed or an exception was thrown
+*/
+int vmc_compare_int(void *envPtr, byte_t **counterPtr);
 int vmc_compare_data(data_t *lhs, flags_t lhf, data_t *rhs, flags_t rhf);
 
 #endif
\ No newline at end of file
@@ -10,6 +10,15 @@
 #define FMUL(a, b) a * b
 #define FDIV(a, b) a / b
 
+// Size of a math command quickened to slots: dst slot, src slot, then an immediate or slot argument
+#define QUICK_SLOT_SIZE (1 + sizeof(word_t) + 1)
+#define QUICK_ARG_SIZE (1 + sizeof(luint))
+#define QUICK_CMD_SIZE (2 * QUICK_SLOT_SIZE + QUICK_ARG_SIZE)
+
+static int is_int32_slot(env_t *env, const byte_t *operand);
+static void try_quicken(env_t *env, byte_t quickCmd);
+static int fetch_quick_operands(env_t *env, byte_t *loc, value_t **dst, value_t **src, luint *arg);
+
 /*
 Tries to fetch the next named variable stored in the add command, throwing a vm
 exception and returning 0 if it fails.
@@ -23,9 +32,8 @@ exception and returning 0 if it fails.
 */
 #define TRY_FETCH_NEXT_VAR(env, argLocPtrPtr, nextNameStringPtr, dataPtrPtr, typePtr, flagPtr) \
 *nextNameStringPtr = (const char *)*argLocPtrPtr; \
-if (!env_resolve_variable(env, *nextNameStringPtr, dataPtrPtr, flagPtr)) return 0; \
-*typePtr = TYPEOF(*flagPtr); \
-*argLocPtrPtr += strlen(*nextNameStringPtr) + 1;
+if (!env_resolve_operand(env, argLocPtrPtr, dataPtrPtr, flagPtr)) return 0; \
+*typePtr = TYPEOF(*flagPtr);
 
 /*
 Tries to fetch the argument field data of an add command, throwing a vm
@@ -67,10 +75,8 @@ case lb_double: \
 	break; \
 case lb_value: \
 { \
-	const char *__argName = (const char *)*argLoc; \
-	if (!env_resolve_variable(env, __argName, argDataPtrPtr, argFlagsPtr)) \
+	if (!env_resolve_operand(env, argLoc, argDataPtrPtr, argFlagsPtr)) \
 		return 0; \
-	*argLoc += strlen(__argName) + 1; \
 	*argTypePtr = TYPEOF(*argFlagsPtr); \
 } \
 	break; \
@@ -275,6 +281,7 @@ int vmm_add(env_t *env, byte_t **argLoc)
 	// Perform the addition, placing the result in the destination variable
 	DO_OP(dstData, &srcCast, &argCast, dstType, +, FADD, FADD);
 
+	try_quicken(env, lb_addi);
 	return 1;
 }
 
@@ -306,6 +313,7 @@ int vmm_sub(env_t *env, byte_t **argLoc)
 	// Perform the subtraction, placing the result in the destination variable
 	DO_OP(dstData, &srcCast, &argCast, dstType, -, FSUB, FSUB);
 
+	try_quicken(env, lb_subi);
 	return 1;
 }
 
@@ -605,3 +613,102 @@ int vmm_not(env_t *env, byte_t **argLoc)
 
 	return 1;
 }
+
+int vmm_addi(env_t *env, byte_t **argLoc)
+{
+	value_t *dst, *src;
+	luint arg;
+
+	if (!fetch_quick_operands(env, *argLoc, &dst, &src, &arg))
+	{
+		*(*argLoc - 1) = lb_add;
+		return vmm_add(env, argLoc);
+	}
+
+	// Signed and unsigned addition produce the same bits, so both are done unsigned
+	dst->uivalue = src->uivalue + arg;
+	*argLoc += QUICK_CMD_SIZE;
+	return 1;
+}
+
+int vmm_subi(env_t *env, byte_t **argLoc)
+{
+	value_t *dst, *src;
+	luint arg;
+
+	if (!fetch_quick_operands(env, *argLoc, &dst, &src, &arg))
+	{
+		*(*argLoc - 1) = lb_sub;
+		return vmm_sub(env, argLoc);
+	}
+
+	dst->uivalue = src->uivalue - arg;
+	*argLoc += QUICK_CMD_SIZE;
+	return 1;
+}
+
+int is_int32_slot(env_t *env, const byte_t *operand)
+{
+	byte_t type;
+
+	if (operand[0] != lb_slot || operand[1 + sizeof(word_t)] != 0)
+		return 0;
+
+	type = value_typeof(FRAME_SLOT(env->rbp, *((word_t *)(operand + 1))));
+	return type == lb_int || type == lb_uint;
+}
+
+void try_quicken(env_t *env, byte_t quickCmd)
+{
+	byte_t *loc = env->cmdStart + 1;
+
+	// Only commands whose operands are all plain 32-bit integer slots, or an integer immediate, qualify
+	if (!is_int32_slot(env, loc) || !is_int32_slot(env, loc + QUICK_SLOT_SIZE))
+		return;
+
+	loc += 2 * QUICK_SLOT_SIZE;
+	if (*loc == lb_value)
+	{
+		if (!is_int32_slot(env, loc + 1))
+			return;
+	}
+	else if (*loc != lb_int && *loc != lb_uint)
+		return;
+
+	*env->cmdStart = quickCmd;
+}
+
+int fetch_quick_operands(env_t *env, byte_t *loc, value_t **dst, value_t **src, luint *arg)
+{
+	byte_t dstType, srcType, argType;
+	value_t *argSlot;
+
+	*dst = FRAME_SLOT(env->rbp, *((word_t *)(loc + 1)));
+	*src = FRAME_SLOT(env->rbp, *((word_t *)(loc + QUICK_SLOT_SIZE + 1)));
+	loc += 2 * QUICK_SLOT_SIZE;
+
+	// Verified classes only ever redeclare a slot with its own type
+	if (CURR_FUNC(env)->parentClass->flags & CLASS_FLAG_VERIFIED)
+	{
+		*arg = *loc == lb_value ? FRAME_SLOT(env->rbp, *((word_t *)(loc + 2)))->uivalue : *((luint *)(loc + 1));
+		return 1;
+	}
+
+	// The slot types were checked when the command was quickened, but recheck them in case they changed
+	dstType = value_typeof(*dst);
+	srcType = value_typeof(*src);
+	if ((dstType != lb_int && dstType != lb_uint) || (srcType != lb_int && srcType != lb_uint))
+		return 0;
+
+	if (*loc == lb_value)
+	{
+		argSlot = FRAME_SLOT(env->rbp, *((word_t *)(loc + 2)));
+		argType = value_typeof(argSlot);
+		if (argType != lb_int && argType != lb_uint)
+			return 0;
+		*arg = argSlot->uivalue;
+	}
+	else
+		*arg = *((luint *)(loc + 1));
+	return 1;
+}
@@ -68,4 +68,26 @@ int vmm_rsh(env_t *env, byte_t **argLoc);
 
 int vmm_not(env_t *env, byte_t **argLoc);
 
+/*
+Handles the add command after it has been quickened into addi. If the operands are no
+longer all 32-bit integers, the command is turned back into add and run generically.
+
+@param env A pointer to a valid env_t structure
+@param argLoc A pointer to the current execution location
+
+@return 1 if the add was a success or 0 if an exception was thrown
+*/
+int vmm_addi(env_t *env, byte_t **argLoc);
+
+/*
+Handles the sub command after it has been quickened into subi. If the operands are no
+longer all 32-bit integers, the command is turned back into sub and run generically.
+
+@param env A pointer to a valid env_t structure
+@param argLoc A pointer to the current execution location
+
+@return 1 if the sub was a success or 0 if an exception was thrown
+*/
+int vmm_subi(env_t *env, byte_t **argLoc);
+
 #endif
\ No newline at end of file
@@ -20,6 +20,7 @@
 
 #define DEFAULT_HEAP_SIZE GB_TO_B(2)
 #define DEFAULT_STACK_SIZE KB_TO_B(2)
+#define DEFAULT_GC_THRESHOLD MB_TO_B(64)
 
 #define DEFAULT_WRITE_STDOUT (ls_write_func)(-1)
 #define DEFAULT_WRITE_STDERR (ls_write_func)(-2)
@@ -0,0 +1,1575 @@
+#include "aot.h"
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <internal/lb.h>
+#include <internal/value.h>
+
+#include "dump.h"
+
+#define MAX_SLOTS 512		// Up to 255 arguments and 255 locals
+#define MAX_QUALIFIED_NAME 512
+#define EXPR_SIZE 128
+#define REASON_SIZE 256
+
+typedef struct aot_buffer_s
+{
+	char *data;
+	size_t length;
+	size_t capacity;
+	int failed;			// An allocation failed, so the contents are incomplete
+} aot_buffer_t;
+
+typedef struct aot_function_s
+{
+	const char *name;
+	byte_t isStatic;
+	byte_t execType;
+	byte_t returnType;
+	byte_t numargs;
+	byte_t numlocals;
+	byte_t types[MAX_SLOTS];			// Arguments, then locals
+	const char *names[MAX_SLOTS];
+	const char *argClasses[MAX_SLOTS];	// The class of each object or objectarray argument
+	char qualifiedName[MAX_QUALIFIED_NAME];
+	byte_t *body;
+	byte_t *bodyEnd;
+
+	int translate;						// Whether the function is still expected to translate
+	char reason[REASON_SIZE];			// Why the function was left to the interpreter
+	aot_buffer_t code;					// The translated function
+} aot_function_t;
+
+typedef struct aot_class_s
+{
+	byte_t *data;
+	unsigned int version;
+	const char *name;
+	char *safeName;						// The name with '.' replaced by '_', as the VM exports it
+	const char **pool;
+	size_t poolsize;
+	aot_function_t *functions;
+	size_t functionCount;
+	int realHelpers[2];					// Whether aot_real4 and aot_real8 are used
+} aot_class_t;
+
+typedef struct aot_state_s
+{
+	aot_class_t *clazz;
+	aot_function_t *func;
+	byte_t *cursor;
+	byte_t *end;
+	int indent;
+	int started;		// A command other than a declaration has been translated
+	int returned;		// The last command translated always returns
+	int lastCall;		// The temporary holding the last call's result, or -1 if it is not known
+	byte_t lastType;	// The return type of the last call
+	int calls;			// The number of call temporaries declared
+} aot_state_t;
+
+static int parse_class(aot_class_t *clazz, byte_t *end);
+static int parse_function(aot_function_t *func, byte_t **cursorPtr, byte_t *end);
+static void check_candidate(aot_class_t *clazz, aot_function_t *func);
+
+static int translate_function(aot_class_t *clazz, aot_function_t *func);
+static int translate_block(aot_state_t *state);
+static int translate_command(aot_state_t *state);
+static int translate_declaration(aot_state_t *state);
+static int translate_set(aot_state_t *state);
+static int translate_ret(aot_state_t *state);
+static int translate_call(aot_state_t *state);
+static int translate_math(aot_state_t *state);
+static int translate_unary_math(aot_state_t *state);
+static int translate_cast(aot_state_t *state);
+static int translate_if(aot_state_t *state);
+static int translate_while(aot_state_t *state);
+
+static int has(aot_state_t *state, size_t size);
+static int read_slot(aot_state_t *state, word_t *slot);
+static int read_value(aot_state_t *state, char *buf, byte_t *type);
+static int read_condition(aot_state_t *state, char *buf, qword_t *target);
+static int read_jump(aot_state_t *state, qword_t *target);
+static int last_call_as(aot_state_t *state, byte_t type, char *buf);
+static int reinterpret(aot_state_t *state, const char *expr, byte_t from, byte_t to, char *buf);
+static void convert(const char *expr, byte_t from, byte_t to, char *buf);
+static int fail(aot_state_t *state, const char *format, ...);
+
+static void put(aot_buffer_t *buf, const char *format, ...);
+static void put_line(aot_state_t *state, const char *format, ...);
+static void put_signature(aot_class_t *clazz, aot_function_t *func, aot_buffer_t *buf);
+static void put_source_signature(aot_function_t *func, aot_buffer_t *buf);
+
+static void format_constant(aot_class_t *clazz, byte_t type, const byte_t *bytes, char *buf);
+static const char *c_type(byte_t type);
+static const char *unsigned_c_type(byte_t type);
+static char qualified_letter(byte_t type);
+static aot_function_t *find_function(aot_class_t *clazz, const char *qualifiedName);
+
+#define IS_INTEGER(type) ((type) >= lb_char && (type) <= lb_ulong)
+#define IS_REAL(type) ((type) == lb_float || (type) == lb_double)
+#define IS_PRIMITIVE(type) (IS_INTEGER(type) || IS_REAL(type) || (type) == lb_bool)
+#define IS_RET(cmd) ((cmd) >= lb_ret && (cmd) <= lb_retr)
+
+// The VM passes an argument narrower than an int in a register it only zeroes, so it is read whole
+#define IS_WIDENED_ARG(type) (sizeof_type(type) < sizeof(luint))
+
+#define OFFSET(state, p) ((qword_t)((p) - (state)->clazz->data))
+
+int aot_translate(FILE *out, byte_t *data, long datalen)
+{
+	aot_class_t clazz;
+	aot_function_t *func;
+	aot_buffer_t line;
+	byte_t *end = data + datalen;
+	int changed;
+	int err = dump_no_error;
+	size_t i;
+
+	memset(&clazz, 0, sizeof(clazz));
+	memset(&line, 0, sizeof(line));
+	clazz.data = data;
+
+	if (datalen < 5)
+		return dump_not_supported;
+
+	// Only classes addressing locals by slot give every function its size and frame layout
+	clazz.version = *((unsigned int *)(data + 1));
+	if (clazz.version < LB_VERSION_SLOTS || clazz.version > LB_VERSION_POOL)
+		return dump_not_supported;
+
+	if (clazz.version >= LB_VERSION_POOL && !read_pool(data, &end, &clazz.pool, &clazz.poolsize))
+		return dump_not_supported;
+
+	err = parse_class(&clazz, end);
+	if (err)
+		goto finalize;
+
+	for (i = 0; i < clazz.functionCount; i++)
+		check_candidate(&clazz, &clazz.functions[i]);
+
+	// A function calling one which is left to the interpreter is left there too, so translate
+	// until every remaining function only calls others which were translated
+	do
+	{
+		changed = 0;
+		clazz.realHelpers[0] = clazz.realHelpers[1] = 0;
+		for (i = 0; i < clazz.functionCount; i++)
+		{
+			func = &clazz.functions[i];
+			if (func->translate && !translate_function(&clazz, func))
+			{
+				func->translate = 0;
+				changed = 1;
+			}
+			if (func->code.failed)
+			{
+				err = dump_out_of_memory;
+				goto finalize;
+			}
+		}
+	} while (changed);
+
+	fprintf(out, "/*\n");
+	fprintf(out, "Translated from %s by lsdump -c. Build this into a library which the class loads\n", clazz.name);
+	fprintf(out, "with System.loadLibrary, and a VM started with -aot runs these functions in place of their\n");
+	fprintf(out, "bytecode.\n");
+	fprintf(out, "*/\n\n");
+	fprintf(out, "#include <string.h>\n");
+	fprintf(out, "#include <math.h>\n");
+	fprintf(out, "#include <lscript.h>\n\n");
+
+	for (i = 0; i < clazz.functionCount; i++)
+	{
+		func = &clazz.functions[i];
+		if (func->translate)
+			continue;
+
+		line.length = 0;
+		put_source_signature(func, &line);
+		fprintf(out, "// Not translated, %s: %s\n", func->reason, line.failed ? "?" : line.data);
+	}
+
+	// Infinities and NaNs have no literal, so they are built from their bits
+	if (clazz.realHelpers[0])
+		fprintf(out, "\nstatic lfloat aot_real4(luint bits)\n{\n\tlfloat value;\n\tmemcpy(&value, &bits, sizeof(value));\n\treturn value;\n}\n");
+	if (clazz.realHelpers[1])
+		fprintf(out, "\nstatic ldouble aot_real8(lulong bits)\n{\n\tldouble value;\n\tmemcpy(&value, &bits, sizeof(value));\n\treturn value;\n}\n");
+
+	fprintf(out, "\n");
+	for (i = 0; i < clazz.functionCount; i++)
+	{
+		func = &clazz.functions[i];
+		if (!func->translate)
+			continue;
+
+		line.length = 0;
+		put_signature(&clazz, func, &line);
+		fprintf(out, "%s;\n", line.failed ? "?" : line.data);
+	}
+
+	for (i = 0; i < clazz.functionCount; i++)
+	{
+		func = &clazz.functions[i];
+		if (func->translate)
+			fprintf(out, "\n%s", func->code.data);
+	}
+
+	if (line.failed)
+		err = dump_out_of_memory;
+
+finalize:
+	for (i = 0; i < clazz.functionCount; i++)
+		free(clazz.functions[i].code.data);
+	free(clazz.functions);
+	free(clazz.safeName);
+	free((void *)clazz.pool);
+	free(line.data);
+
+	return err;
+}
+
+int parse_class(aot_class_t *clazz, byte_t *end)
+{
+	byte_t *cursor = clazz->data + 5;
+	byte_t *nul;
+	aot_function_t *functions;
+	size_t capacity = 0;
+	size_t len;
+
+	if (cursor >= end || *cursor != lb_class)
+		return dump_not_supported;
+	cursor++;
+
+	nul = (byte_t *)memchr(cursor, 0, end - cursor);
+	if (!nul)
+		return dump_not_supported;
+	clazz->name = (const char *)cursor;
+	cursor = nul + 1;
+
+	len = strlen(clazz->name) + 1;
+	clazz->safeName = (char *)malloc(len);
+	if (!clazz->safeName)
+		return dump_out_of_memory;
+	for (size_t i = 0; i < len; i++)
+		clazz->safeName[i] = clazz->name[i] == '.' ? '_' : clazz->name[i];
+
+	if (cursor < end && *cursor == lb_extends)
+	{
+		cursor++;
+		nul = (byte_t *)memchr(cursor, 0, end - cursor);
+		if (!nul)
+			return dump_not_supported;
+		cursor = nul + 1;
+	}
+
+	while (cursor < end)
+	{
+		switch (*cursor)
+		{
+		case lb_noop:
+		case lb_align:
+			cursor++;
+			break;
+		case lb_global:
+			// The name, the flags, then the value of a static field
+			cursor++;
+			nul = (byte_t *)memchr(cursor, 0, end - cursor);
+			if (!nul || (size_t)(end - nul - 1) < sizeof(flags_t))
+				return dump_not_supported;
+			cursor = nul + 1;
+			len = value_access_type((value_t *)cursor) == lb_static ? value_sizeof((value_t *)cursor) : 0;
+			cursor += sizeof(flags_t);
+			if ((size_t)(end - cursor) < len)
+				return dump_not_supported;
+			cursor += len;
+			break;
+		case lb_function:
+			if (clazz->functionCount == capacity)
+			{
+				capacity = capacity ? capacity * 2 : 16;
+				functions = (aot_function_t *)realloc(clazz->functions, capacity * sizeof(aot_function_t));
+				if (!functions)
+					return dump_out_of_memory;
+				clazz->functions = functions;
+			}
+
+			memset(&clazz->functions[clazz->functionCount], 0, sizeof(aot_function_t));
+			if (!parse_function(&clazz->functions[clazz->functionCount], &cursor, end))
+				return dump_not_supported;
+			clazz->functionCount++;
+			break;
+		default:
+			return dump_not_supported;
+		}
+	}
+
+	return dump_no_error;
+}
+
+int parse_function(aot_function_t *func, byte_t **cursorPtr, byte_t *end)
+{
+	byte_t *cursor = *cursorPtr + 1;
+	byte_t *nul;
+	byte_t type;
+	size_t slot;
+	size_t len;
+	dword_t size;
+
+	if (end - cursor < 4)
+		return 0;
+	func->isStatic = *cursor++ == lb_static;
+	func->execType = *cursor++;
+	func->returnType = *cursor++;
+
+	nul = (byte_t *)memchr(cursor, 0, end - cursor);
+	if (!nul || nul + 1 >= end)
+		return 0;
+	func->name = (const char *)cursor;
+	cursor = nul + 1;
+
+	// The name calls use, built as the VM builds it when loading the class
+	snprintf(func->qualifiedName, MAX_QUALIFIED_NAME, "%s(", func->name);
+
+	func->numargs = *cursor++;
+	for (slot = 0; slot < func->numargs; slot++)
+	{
+		if (cursor >= end)
+			return 0;
+		type = func->types[slot] = *cursor++;
+
+		if (type == lb_object || type == lb_objectarray)
+		{
+			nul = (byte_t *)memchr(cursor, 0, end - cursor);
+			if (!nul)
+				return 0;
+			func->argClasses[slot] = (const char *)cursor;
+			cursor = nul + 1;
+		}
+
+		nul = (byte_t *)memchr(cursor, 0, end - cursor);
+		if (!nul)
+			return 0;
+		func->names[slot] = (const char *)cursor;
+		cursor = nul + 1;
+
+		len = strlen(func->qualifiedName);
+		if (type >= lb_chararray && type <= lb_objectarray)
+		{
+			snprintf(func->qualifiedName + len, MAX_QUALIFIED_NAME - len, "[");
+			len++;
+			type = type == lb_objectarray ? lb_object : type - lb_chararray + lb_char;
+		}
+
+		if (type == lb_object)
+			snprintf(func->qualifiedName + len, MAX_QUALIFIED_NAME - len, "L%s;", func->argClasses[slot]);
+		else
+			snprintf(func->qualifiedName + len, MAX_QUALIFIED_NAME - len, "%c", qualified_letter(type));
+	}
+
+	if (cursor >= end)
+		return 0;
+	func->numlocals = *cursor++;
+	for (slot = func->numargs; slot < (size_t)func->numargs + func->numlocals; slot++)
+	{
+		if (cursor >= end)
+			return 0;
+		func->types[slot] = *cursor++;
+
+		nul = (byte_t *)memchr(cursor, 0, end - cursor);
+		if (!nul)
+			return 0;
+		func->names[slot] = (const char *)cursor;
+		cursor = nul + 1;
+	}
+
+	if ((size_t)(end - cursor) < sizeof(dword_t))
+		return 0;
+	size = *((dword_t *)cursor);
+	cursor += sizeof(dword_t);
+	if ((size_t)(end - cursor) < size)
+		return 0;
+
+	func->body = cursor;
+	func->bodyEnd = cursor + size;
+	*cursorPtr = func->bodyEnd;
+	return 1;
+}
+
+void check_candidate(aot_class_t *clazz, aot_function_t *func)
+{
+	const char *c;
+	size_t i;
+
+	func->translate = 0;
+
+	if (!func->isStatic)
+	{
+		snprintf(func->reason, REASON_SIZE, "it is dynamic");
+		return;
+	}
+
+	if (func->execType != lb_interp)
+	{
+		snprintf(func->reason, REASON_SIZE, "it has no bytecode");
+		return;
+	}
+
+	for (c = func->name; *c; c++)
+	{
+		if (!isalnum((unsigned char)*c) && *c != '_')
+			break;
+	}
+	if (*c || isdigit((unsigned char)*func->name))
+	{
+		snprintf(func->reason, REASON_SIZE, "its name is not a C identifier");
+		return;
+	}
+
+	// The VM finds a function's export by the function's name alone
+	for (i = 0; i < clazz->functionCount; i++)
+	{
+		if (&clazz->functions[i] != func && !strcmp(clazz->functions[i].name, func->name))
+		{
+			snprintf(func->reason, REASON_SIZE, "it is overloaded");
+			return;
+		}
+	}
+
+	if (func->returnType != lb_void && !IS_PRIMITIVE(func->returnType))
+	{
+		snprintf(func->reason, REASON_SIZE, "it returns an object");
+		return;
+	}
+
+	for (i = 0; i < (size_t)func->numargs + func->numlocals; i++)
+	{
+		if (!IS_PRIMITIVE(func->types[i]))
+		{
+			snprintf(func->reason, REASON_SIZE, "%s is an object", func->names[i]);
+			return;
+		}
+	}
+
+	func->translate = 1;
+}
+
+int translate_function(aot_class_t *clazz, aot_function_t *func)
+{
+	aot_state_t state;
+	byte_t type;
+	size_t slot;
+
+	memset(&state, 0, sizeof(state));
+	state.clazz = clazz;
+	state.func = func;
+	state.cursor = func->body;
+	state.end = func->bodyEnd;
+	state.lastCall = -1;
+
+	func->code.length = 0;
+	put(&func->code, "// ");
+	put_source_signature(func, &func->code);
+	put(&func->code, "\n");
+	put_signature(clazz, func, &func->code);
+	put(&func->code, "\n{\n");
+	state.indent = 1;
+
+	// Every local starts at zero, as the VM clears the frame
+	for (slot = 0; slot < (size_t)func->numargs + func->numlocals; slot++)
+	{
+		type = func->types[slot];
+		if (slot >= func->numargs)
+			put_line(&state, "%s s%zu = 0;\t// %s", c_type(type), slot, func->names[slot]);
+		else if (IS_WIDENED_ARG(type))
+			put_line(&state, "%s s%zu = (%s)a%zu;\t// %s", c_type(type), slot, c_type(type), slot, func->names[slot]);
+	}
+
+	if (!translate_block(&state))
+		return 0;
+	if (state.cursor != state.end)
+		return fail(&state, "it has an end outside of any block");
+	if (func->returnType != lb_void && !state.returned)
+		return fail(&state, "it can run past the end of its body");
+
+	put(&func->code, "}\n");
+	return 1;
+}
+
+int translate_block(aot_state_t *state)
+{
+	state->returned = 0;
+	while (state->cursor < state->end)
+	{
+		switch (*state->cursor)
+		{
+		case lb_end:
+		case lb_elif:
+		case lb_else:
+			return 1;
+		}
+
+		if (!translate_command(state))
+			return 0;
+	}
+	return 1;
+}
+
+int translate_command(aot_state_t *state)
+{
+	byte_t cmd = *state->cursor;
+	int result;
+
+	if (cmd < lb_char || cmd > lb_objectarray)
+		state->started = 1;
+
+	switch (cmd)
+	{
+	case lb_noop:
+		state->cursor++;
+		return 1;
+	case lb_char:
+	case lb_uchar:
+	case lb_short:
+	case lb_ushort:
+	case lb_int:
+	case lb_uint:
+	case lb_long:
+	case lb_ulong:
+	case lb_bool:
+	case lb_float:
+	case lb_double:
+	case lb_object:
+	case lb_chararray:
+	case lb_uchararray:
+	case lb_shortarray:
+	case lb_ushortarray:
+	case lb_intarray:
+	case lb_uintarray:
+	case lb_longarray:
+	case lb_ulongarray:
+	case lb_boolarray:
+	case lb_floatarray:
+	case lb_doublearray:
+	case lb_objectarray:
+		result = translate_declaration(state);
+		break;
+	case lb_setb:
+	case lb_setw:
+	case lb_setd:
+	case lb_setq:
+	case lb_setr4:
+	case lb_setr8:
+	case lb_setv:
+	case lb_setr:
+		result = translate_set(state);
+		break;
+	case lb_ret:
+	case lb_retb:
+	case lb_retw:
+	case lb_retd:
+	case lb_retq:
+	case lb_retr4:
+	case lb_retr8:
+	case lb_reto:
+	case lb_retv:
+	case lb_retr:
+		result = translate_ret(state);
+		break;
+	case lb_static_call:
+		result = translate_call(state);
+		break;
+	case lb_add:
+	case lb_sub:
+	case lb_mul:
+	case lb_div:
+	case lb_mod:
+	case lb_and:
+	case lb_or:
+	case lb_xor:
+	case lb_lsh:
+	case lb_rsh:
+		result = translate_math(state);
+		break;
+	case lb_neg:
+	case lb_not:
+		result = translate_unary_math(state);
+		break;
+	case lb_castc:
+	case lb_castuc:
+	case lb_casts:
+	case lb_castus:
+	case lb_casti:
+	case lb_castui:
+	case lb_castl:
+	case lb_castul:
+	case lb_castb:
+	case lb_castf:
+	case lb_castd:
+		result = translate_cast(state);
+		break;
+	case lb_if:
+		return translate_if(state);
+	case lb_while:
+		return translate_while(state);
+	case lb_seto:
+		return fail(state, "it creates an object");
+	case lb_dynamic_call:
+		return fail(state, "it calls a dynamic function");
+	case lb_switch:
+		return fail(state, "it has a switch");
+	default:
+		return fail(state, "it has command 0x%02X", (unsigned int)cmd);
+	}
+
+	state->returned = result && IS_RET(cmd);
+	return result;
+}
+
+int translate_declaration(aot_state_t *state)
+{
+	byte_t type = *state->cursor;
+	word_t slot;
+
+	state->cursor++;
+	if (!read_slot(state, &slot))
+		return 0;
+	if (state->func->types[slot] != type)
+		return fail(state, "it declares %s as another type", state->func->names[slot]);
+
+	// A declaration clears its slot, which the locals already are before the first command
+	if (state->started)
+		put_line(state, "s%hu = 0;", slot);
+	return 1;
+}
+
+int translate_set(aot_state_t *state)
+{
+	byte_t cmd = *state->cursor;
+	byte_t type;
+	word_t dst, src;
+	size_t width;
+	char expr[EXPR_SIZE], value[EXPR_SIZE];
+
+	state->cursor++;
+	if (!read_slot(state, &dst))
+		return 0;
+	type = state->func->types[dst];
+
+	switch (cmd)
+	{
+	case lb_setv:
+		if (!read_slot(state, &src))
+			return 0;
+		snprintf(expr, sizeof(expr), "s%hu", src);
+		if (type == lb_bool)
+			snprintf(value, sizeof(value), "(lbool)(%s ? 1 : 0)", expr);
+		else
+			convert(expr, state->func->types[src], type, value);
+		put_line(state, "s%hu = %s;", dst, value);
+		return 1;
+	case lb_setr:
+		if (!last_call_as(state, type, value))
+			return 0;
+		put_line(state, "s%hu = %s;", dst, value);
+		return 1;
+	case lb_setb:
+		width = sizeof(byte_t);
+		break;
+	case lb_setw:
+		width = sizeof(word_t);
+		break;
+	case lb_setd:
+	case lb_setr4:
+		width = sizeof(dword_t);
+		break;
+	default:
+		width = sizeof(qword_t);
+		break;
+	}
+
+	// The verifier only lets a literal be stored into a slot of the same size
+	if (!has(state, width))
+		return 0;
+	if (width != sizeof_type(type))
+		return fail(state, "it stores a literal of another size into %s", state->func->names[dst]);
+
+	format_constant(state->clazz, type, state->cursor, value);
+	put_line(state, "s%hu = %s;", dst, value);
+	state->cursor += width;
+	return 1;
+}
+
+int translate_ret(aot_state_t *state)
+{
+	byte_t cmd = *state->cursor;
+	byte_t type = state->func->returnType;
+	size_t width;
+	word_t slot;
+	char expr[EXPR_SIZE], value[EXPR_SIZE];
+
+	state->cursor++;
+	switch (cmd)
+	{
+	case lb_ret:
+		// The caller is left with whatever the last call returned
+		if (type != lb_void)
+			return fail(state, "it returns without a value");
+		put_line(state, "return;");
+		return 1;
+	case lb_retr:
+		if (type == lb_void)
+			put_line(state, "return;");
+		else if (!last_call_as(state, type, value))
+			return 0;
+		else
+			put_line(state, "return %s;", value);
+		return 1;
+	case lb_retv:
+		if (!read_slot(state, &slot))
+			return 0;
+		if (type == lb_void)
+		{
+			put_line(state, "return;");
+			return 1;
+		}
+
+		// The whole slot is copied, and the caller reads as much of it as the return type needs
+		if (sizeof_type(state->func->types[slot]) < sizeof_type(type))
+			return fail(state, "it returns %s, which is narrower than its return type", state->func->names[slot]);
+		snprintf(expr, sizeof(expr), "s%hu", slot);
+		if (!reinterpret(state, expr, state->func->types[slot], type, value))
+			return 0;
+		put_line(state, "return %s;", value);
+		return 1;
+	case lb_reto:
+		return fail(state, "it returns an object");
+	case lb_retb:
+		width = sizeof(byte_t);
+		break;
+	case lb_retw:
+		width = sizeof(word_t);
+		break;
+	case lb_retd:
+	case lb_retr4:
+		width = sizeof(dword_t);
+		break;
+	default:
+		width = sizeof(qword_t);
+		break;
+	}
+
+	if (!has(state, width))
+		return 0;
+	if (type == lb_void)
+		put_line(state, "return;");
+	else if (width < sizeof_type(type))
+		return fail(state, "it returns a literal narrower than its return type");
+	else
+	{
+		format_constant(state->clazz, type, state->cursor, value);
+		put_line(state, "return %s;", value);
+	}
+	state->cursor += width;
+	return 1;
+}
+
+int translate_call(aot_state_t *state)
+{
+	const char *name;
+	const char *dot = NULL;
+	const char *c;
+	byte_t *nul;
+	aot_function_t *callee;
+	aot_buffer_t args;
+	byte_t type;
+	size_t width;
+	word_t index, slot;
+	char expr[EXPR_SIZE], value[EXPR_SIZE];
+
+	state->cursor++;
+	if (state->clazz->version >= LB_VERSION_POOL)
+	{
+		if (!has(state, sizeof(word_t)))
+			return 0;
+		index = *((word_t *)state->cursor);
+		state->cursor += sizeof(word_t);
+		if (index >= state->clazz->poolsize)
+			return fail(state, "it calls a function missing from the constant pool");
+		name = state->clazz->pool[index];
+	}
+	else
+	{
+		nul = (byte_t *)memchr(state->cursor, 0, state->end - state->cursor);
+		if (!nul)
+			return fail(state, "it is truncated");
+		name = (const char *)state->cursor;
+		state->cursor = nul + 1;
+	}
+
+	// Functions of the same class may be called with or without the class's name
+	for (c = name; *c && *c != '('; c++)
+	{
+		if (*c == '.')
+			dot = c;
+	}
+	if (dot)
+	{
+		if ((size_t)(dot - name) != strlen(state->clazz->name) || strncmp(name, state->clazz->name, dot - name))
+			return fail(state, "it calls %s", name);
+		name = dot + 1;
+	}
+
+	callee = find_function(state->clazz, name);
+	if (!callee)
+		return fail(state, "it calls %s", name);
+	if (!callee->translate)
+		return fail(state, "it calls %s, which is not translated", callee->name);
+
+	memset(&args, 0, sizeof(args));
+	for (size_t i = 0; i < callee->numargs; i++)
+	{
+		type = callee->types[i];
+		if (!has(state, 1))
+			goto failed;
+
+		switch (*state->cursor++)
+		{
+		case lb_byte:
+			width = sizeof(byte_t);
+			goto literal_arg;
+		case lb_word:
+			width = sizeof(word_t);
+			goto literal_arg;
+		case lb_dword:
+		case lb_real4:
+			width = sizeof(dword_t);
+			goto literal_arg;
+		case lb_qword:
+		case lb_real8:
+			width = sizeof(qword_t);
+		literal_arg:
+			// Arguments are passed as raw bytes, which the callee reads as its argument's type
+			if (width != sizeof_type(type))
+			{
+				fail(state, "it passes %s a literal of another size", name);
+				goto failed;
+			}
+			if (!has(state, width))
+				goto failed;
+			format_constant(state->clazz, type, state->cursor, value);
+			state->cursor += width;
+			break;
+		case lb_value:
+			if (!read_slot(state, &slot))
+				goto failed;
+			if (sizeof_type(state->func->types[slot]) != sizeof_type(type))
+			{
+				fail(state, "it passes %s a value of another size", name);
+				goto failed;
+			}
+			snprintf(expr, sizeof(expr), "s%hu", slot);
+			if (!reinterpret(state, expr, state->func->types[slot], type, value))
+				goto failed;
+			break;
+		case lb_ret:
+			if (!last_call_as(state, type, value))
+				goto failed;
+			break;
+		default:
+			fail(state, "it passes %s a string", name);
+			goto failed;
+		}
+
+		put(&args, ", %s", value);
+	}
+
+	if (args.failed)
+	{
+		state->func->code.failed = 1;
+		goto failed;
+	}
+
+	if (callee->returnType == lb_void)
+	{
+		put_line(state, "%s_%s(env, clazz%s);", state->clazz->safeName, callee->name, args.data ? args.data : "");
+		state->lastCall = -1;
+	}
+	else
+	{
+		put_line(state, "%s c%d = %s_%s(env, clazz%s);", c_type(callee->returnType), state->calls,
+			state->clazz->safeName, callee->name, args.data ? args.data : "");
+		state->lastCall = state->calls++;
+		state->lastType = callee->returnType;
+	}
+
+	free(args.data);
+	return 1;
+
+failed:
+	free(args.data);
+	return 0;
+}
+
+int translate_math(aot_state_t *state)
+{
+	byte_t cmd = *state->cursor;
+	byte_t type, srcType, argType;
+	word_t dst, src;
+	const char *op;
+	char expr[EXPR_SIZE], arg[EXPR_SIZE], lhs[EXPR_SIZE], rhs[EXPR_SIZE];
+
+	state->cursor++;
+	if (!read_slot(state, &dst) || !read_slot(state, &src) || !read_value(state, arg, &argType))
+		return 0;
+	type = state->func->types[dst];
+	srcType = state->func->types[src];
+	if (type == lb_bool || srcType == lb_bool || argType == lb_bool)
+		return fail(state, "it does math on a bool");
+
+	// Both operands are converted to the destination's type first
+	snprintf(expr, sizeof(expr), "s%hu", src);
+	convert(expr, srcType, type, lhs);
+	convert(arg, argType, type, rhs);
+
+	switch (cmd)
+	{
+	case lb_add:
+		op = "+";
+		break;
+	case lb_sub:
+		op = "-";
+		break;
+	case lb_mul:
+		op = "*";
+		break;
+	case lb_div:
+		op = "/";
+		break;
+	case lb_mod:
+		op = "%";
+		break;
+	case lb_and:
+		op = "&";
+		break;
+	case lb_or:
+		op = "|";
+		break;
+	case lb_xor:
+		op = "^";
+		break;
+	case lb_lsh:
+		op = ">>"; // The interpreter shifts right for lsh and left for rsh
+		break;
+	default:
+		op = "<<";
+		break;
+	}
+
+	if (IS_REAL(type))
+	{
+		if (cmd == lb_mod)
+			put_line(state, "s%hu = %s(%s, %s);", dst, type == lb_float ? "fmodf" : "fmod", lhs, rhs);
+		else if (cmd == lb_add || cmd == lb_sub || cmd == lb_mul || cmd == lb_div)
+			put_line(state, "s%hu = %s %s %s;", dst, lhs, op, rhs);
+		else
+			return fail(state, "it does bitwise math on a real");
+	}
+	else if (cmd == lb_rsh)
+		put_line(state, "s%hu = (%s)((%s)%s << %s);", dst, c_type(type), unsigned_c_type(type), lhs, rhs);
+	else if (cmd == lb_add || cmd == lb_sub || cmd == lb_mul)
+	{
+		// Worked out unsigned, so overflow wraps around as it does in the interpreter
+		put_line(state, "s%hu = (%s)((%s)%s %s (%s)%s);", dst, c_type(type), unsigned_c_type(type), lhs, op,
+			unsigned_c_type(type), rhs);
+	}
+	else
+		put_line(state, "s%hu = (%s)(%s %s %s);", dst, c_type(type), lhs, op, rhs);
+	return 1;
+}
+
+int translate_unary_math(aot_state_t *state)
+{
+	byte_t cmd = *state->cursor;
+	byte_t type, srcType;
+	word_t dst, src;
+	char expr[EXPR_SIZE], value[EXPR_SIZE];
+
+	state->cursor++;
+	if (!read_slot(state, &dst) || !read_slot(state, &src))
+		return 0;
+	type = state->func->types[dst];
+	srcType = state->func->types[src];
+	if (type == lb_bool || srcType == lb_bool)
+		return fail(state, "it does math on a bool");
+
+	snprintf(expr, sizeof(expr), "s%hu", src);
+	convert(expr, srcType, type, value);
+
+	if (cmd == lb_not)
+	{
+		if (IS_REAL(type))
+			return fail(state, "it does bitwise math on a real");
+		put_line(state, "s%hu = (%s)~%s;", dst, c_type(type), value);
+	}
+	else if (IS_REAL(type))
+		put_line(state, "s%hu = -%s;", dst, value);
+	else if (type == lb_char || type == lb_short || type == lb_int || type == lb_long)
+		put_line(state, "s%hu = (%s)(0 - (%s)%s);", dst, c_type(type), unsigned_c_type(type), value);
+	else
+		return fail(state, "it negates %s, which the interpreter leaves unchanged", state->func->names[dst]);
+	return 1;
+}
+
+int translate_cast(aot_state_t *state)
+{
+	static const byte_t castTypes[] = { lb_char, lb_uchar, lb_short, lb_ushort, lb_int, lb_uint, lb_long, lb_ulong, lb_bool, lb_float, lb_double };
+	byte_t castType = castTypes[*state->cursor - lb_castc];
+	byte_t type;
+	word_t dst, src;
+	char expr[EXPR_SIZE], cast[EXPR_SIZE], value[EXPR_SIZE];
+
+	state->cursor++;
+	if (!read_slot(state, &dst) || !read_slot(state, &src))
+		return 0;
+	type = state->func->types[dst];
+
+	// The result is stored as the cast's type, whatever the type of the destination
+	if (sizeof_type(castType) < sizeof_type(type))
+		return fail(state, "it casts %s to a narrower type", state->func->names[dst]);
+
+	snprintf(expr, sizeof(expr), "s%hu", src);
+	if (castType == lb_bool)
+		snprintf(cast, sizeof(cast), "(lbool)(%s ? 1 : 0)", expr);
+	else
+		convert(expr, state->func->types[src], castType, cast);
+
+	if (!reinterpret(state, cast, castType, type, value))
+		return 0;
+	put_line(state, "s%hu = %s;", dst, value);
+	return 1;
+}
+
+int translate_if(aot_state_t *state)
+{
+	char cond[EXPR_SIZE * 2 + 16];
+	qword_t falseTarget, target, position, exitTarget = 0;
+	int haveExit = 0, hasElse = 0, allReturn = 1;
+	byte_t cmd;
+
+	// An if, else if and else chain jumps to the next condition when one fails, and from the end
+	// of each body to the chain's end
+	state->cursor++;
+	if (!read_condition(state, cond, &falseTarget))
+		return 0;
+	put_line(state, "if (%s)", cond);
+
+	for (;;)
+	{
+		put_line(state, "{");
+		state->lastCall = -1;
+		state->indent++;
+		if (!translate_block(state))
+			return 0;
+		state->indent--;
+		put_line(state, "}");
+		allReturn = allReturn && state->returned;
+
+		if (state->cursor >= state->end)
+			return fail(state, "it has an if without an end");
+
+		cmd = *state->cursor;
+		position = OFFSET(state, state->cursor);
+		if (!read_jump(state, &target))
+			return 0;
+
+		// The chain is left through its end, which goes straight on
+		if (cmd == lb_end)
+		{
+			if (target != (qword_t)-1 || (!hasElse && falseTarget != position) || (haveExit && exitTarget != position))
+				return fail(state, "it has an if whose jumps do not match its blocks");
+			break;
+		}
+
+		if (hasElse || falseTarget != OFFSET(state, state->cursor) || (haveExit && target != exitTarget))
+			return fail(state, "it has an if whose jumps do not match its blocks");
+		exitTarget = target;
+		haveExit = 1;
+
+		if (cmd == lb_else)
+		{
+			hasElse = 1;
+			put_line(state, "else");
+			continue;
+		}
+
+		if (!has(state, 1) || *state->cursor != lb_if)
+			return fail(state, "it has an else if without a condition");
+		state->cursor++;
+		if (!read_condition(state, cond, &falseTarget))
+			return 0;
+		put_line(state, "else if (%s)", cond);
+	}
+
+	state->lastCall = -1;
+	state->returned = hasElse && allReturn;
+	return 1;
+}
+
+int translate_while(aot_state_t *state)
+{
+	char cond[EXPR_SIZE * 2 + 16];
+	qword_t start = OFFSET(state, state->cursor);
+	qword_t exitTarget, target;
+
+	state->cursor++;
+	if (!read_condition(state, cond, &exitTarget))
+		return 0;
+	put_line(state, "while (%s)", cond);
+	put_line(state, "{");
+
+	// The result of a call made before the loop is gone after its first iteration
+	state->lastCall = -1;
+	state->indent++;
+	if (!translate_block(state))
+		return 0;
+	state->indent--;
+	put_line(state, "}");
+
+	if (state->cursor >= state->end || *state->cursor != lb_end)
+		return fail(state, "it has a while without an end");
+	if (!read_jump(state, &target))
+		return 0;
+	if (target != start || exitTarget != OFFSET(state, state->cursor))
+		return fail(state, "it has a while whose jumps do not match its block");
+
+	state->lastCall = -1;
+	state->returned = 0;
+	return 1;
+}
+
+int has(aot_state_t *state, size_t size)
+{
+	if ((size_t)(state->end - state->cursor) < size)
+		return fail(state, "it is truncated");
+	return 1;
+}
+
+int read_slot(aot_state_t *state, word_t *slot)
+{
+	if (!has(state, 1 + sizeof(word_t) + 1))
+		return 0;
+	if (*state->cursor != lb_slot)
+		return fail(state, "it uses a static field or an array element");
+
+	*slot = *((word_t *)(state->cursor + 1));
+	if (state->cursor[1 + sizeof(word_t)])
+		return fail(state, "it uses a field");
+	if (*slot >= (size_t)state->func->numargs + state->func->numlocals)
+		return fail(state, "it uses slot %hu, which it does not have", *slot);
+
+	state->cursor += 1 + sizeof(word_t) + 1;
+	return 1;
+}
+
+int read_value(aot_state_t *state, char *buf, byte_t *type)
+{
+	word_t slot;
+
+	if (!has(state, 1))
+		return 0;
+	*type = *state->cursor++;
+
+	if (*type == lb_value)
+	{
+		if (!read_slot(state, &slot))
+			return 0;
+		*type = state->func->types[slot];
+		snprintf(buf, EXPR_SIZE, "s%hu", slot);
+		return 1;
+	}
+
+	if (!IS_PRIMITIVE(*type))
+		return fail(state, "it has a value of type 0x%02X", (unsigned int)*type);
+	if (!has(state, sizeof_type(*type)))
+		return 0;
+	format_constant(state->clazz, *type, state->cursor, buf);
+	state->cursor += sizeof_type(*type);
+	return 1;
+}
+
+int read_condition(aot_state_t *state, char *buf, qword_t *target)
+{
+	const size_t size = EXPR_SIZE * 2 + 16;
+	char lhs[EXPR_SIZE], rhs[EXPR_SIZE];
+	byte_t count, comparator;
+	byte_t lhsType, rhsType;
+	int real;
+
+	if (!has(state, 1))
+		return 0;
+	count = *state->cursor++;
+	if (!read_value(state, lhs, &lhsType))
+		return 0;
+
+	if (count == lb_one)
+	{
+		// Only the first byte of the value is tested
+		if (IS_REAL(lhsType))
+			return fail(state, "it tests a real as a bool");
+		snprintf(buf, size, lhsType == lb_bool ? "%s" : "(luchar)%s", lhs);
+	}
+	else if (count == lb_two)
+	{
+		if (!has(state, 1))
+			return 0;
+		comparator = *state->cursor++;
+		if (!read_value(state, rhs, &rhsType))
+			return 0;
+
+		// A comparison which is neither equal nor greater is less, so a NaN is less than anything
+		real = IS_REAL(lhsType) || IS_REAL(rhsType);
+		switch (comparator)
+		{
+		case lb_equal:
+			snprintf(buf, size, "%s == %s", lhs, rhs);
+			break;
+		case lb_nequal:
+			snprintf(buf, size, "%s != %s", lhs, rhs);
+			break;
+		case lb_greater:
+			snprintf(buf, size, "%s > %s", lhs, rhs);
+			break;
+		case lb_gequal:
+			snprintf(buf, size, "%s >= %s", lhs, rhs);
+			break;
+		case lb_less:
+			snprintf(buf, size, real ? "!(%s >= %s)" : "%s < %s", lhs, rhs);
+			break;
+		case lb_lequal:
+			snprintf(buf, size, real ? "!(%s > %s)" : "%s <= %s", lhs, rhs);
+			break;
+		default:
+			return fail(state, "it has comparator 0x%02X", (unsigned int)comparator);
+		}
+	}
+	else
+		return fail(state, "it has a condition of 0x%02X values", (unsigned int)count);
+
+	if (!has(state, sizeof(qword_t)))
+		return 0;
+	*target = *((qword_t *)state->cursor);
+	state->cursor += sizeof(qword_t);
+	return 1;
+}
+
+int read_jump(aot_state_t *state, qword_t *target)
+{
+	if (!has(state, 1 + sizeof(qword_t)))
+		return 0;
+	*target = *((qword_t *)(state->cursor + 1));
+	state->cursor += 1 + sizeof(qword_t);
+	return 1;
+}
+
+int last_call_as(aot_state_t *state, byte_t type, char *buf)
+{
+	char expr[EXPR_SIZE];
+
+	// Only results of calls in the same block are followed, and a result is read from the
+	// start of what the call returned
+	if (state->lastCall < 0)
+		return fail(state, "it uses the result of a call it cannot follow");
+	if (sizeof_type(type) > sizeof_type(state->lastType))
+		return fail(state, "it reads more of a result than the call returned");
+
+	snprintf(expr, sizeof(expr), "c%d", state->lastCall);
+	return reinterpret(state, expr, state->lastType, type, buf);
+}
+
+int reinterpret(aot_state_t *state, const char *expr, byte_t from, byte_t to, char *buf)
+{
+	// The start of an integer is the same integer truncated, but a real has to be the same type
+	if (from == to)
+		snprintf(buf, EXPR_SIZE, "%s", expr);
+	else if (IS_REAL(from) || IS_REAL(to))
+		return fail(state, "it reads a %s as a %s", type_name(from), type_name(to));
+	else
+		snprintf(buf, EXPR_SIZE, "(%s)%s", c_type(to), expr);
+	return 1;
+}
+
+void convert(const char *expr, byte_t from, byte_t to, char *buf)
+{
+	if (from == to)
+		snprintf(buf, EXPR_SIZE, "%s", expr);
+	else
+		snprintf(buf, EXPR_SIZE, "(%s)%s", c_type(to), expr);
+}
+
+int fail(aot_state_t *state, const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(state->func->reason, REASON_SIZE, format, args);
+	va_end(args);
+	return 0;
+}
+
+void put(aot_buffer_t *buf, const char *format, ...)
+{
+	va_list args;
+	int len;
+	size_t capacity;
+	char *data;
+
+	if (buf->failed)
+		return;
+
+	va_start(args, format);
+	len = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	if (len < 0)
+	{
+		buf->failed = 1;
+		return;
+	}
+
+	if (buf->length + len + 1 > buf->capacity)
+	{
+		capacity = buf->capacity ? buf->capacity : 256;
+		while (buf->length + len + 1 > capacity)
+			capacity *= 2;
+
+		data = (char *)realloc(buf->data, capacity);
+		if (!data)
+		{
+			buf->failed = 1;
+			return;
+		}
+		buf->data = data;
+		buf->capacity = capacity;
+	}
+
+	va_start(args, format);
+	vsnprintf(buf->data + buf->length, buf->capacity - buf->length, format, args);
+	va_end(args);
+	buf->length += len;
+}
+
+void put_line(aot_state_t *state, const char *format, ...)
+{
+	char line[EXPR_SIZE * 4];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	for (int i = 0; i < state->indent; i++)
+		put(&state->func->code, "\t");
+	put(&state->func->code, "%s\n", line);
+}
+
+void put_signature(aot_class_t *clazz, aot_function_t *func, aot_buffer_t *buf)
+{
+	byte_t type;
+
+	put(buf, "LNIFUNC %s LNICALL %s_%s(LEnv env, lclass clazz", c_type(func->returnType), clazz->safeName, func->name);
+	for (size_t i = 0; i < func->numargs; i++)
+	{
+		type = func->types[i];
+		if (IS_WIDENED_ARG(type))
+			put(buf, ", lulong a%zu", i);
+		else
+			put(buf, ", %s s%zu", c_type(type), i);
+	}
+	put(buf, ")");
+}
+
+void put_source_signature(aot_function_t *func, aot_buffer_t *buf)
+{
+	const char *name;
+
+	name = type_name(func->returnType);
+	put(buf, "%s %s(", name ? name : "?", func->name);
+	for (size_t i = 0; i < func->numargs; i++)
+	{
+		name = type_name(func->types[i]);
+		put(buf, "%s%s ", i ? ", " : "", name ? name : "?");
+		if (func->argClasses[i])
+			put(buf, "%s ", func->argClasses[i]);
+		put(buf, "%s", func->names[i]);
+	}
+	put(buf, ")");
+}
+
+void format_constant(aot_class_t *clazz, byte_t type, const byte_t *bytes, char *buf)
+{
+	lchar c;
+	lshort s;
+	lint i;
+	llong l;
+	lfloat f;
+	ldouble d;
+	char real[64];
+
+	switch (type)
+	{
+	case lb_char:
+	case lb_bool:
+		memcpy(&c, bytes, sizeof(c));
+		snprintf(buf, EXPR_SIZE, "((%s)%d)", c_type(type), (int)c);
+		break;
+	case lb_uchar:
+		snprintf(buf, EXPR_SIZE, "((luchar)%u)", (unsigned int)*bytes);
+		break;
+	case lb_short:
+		memcpy(&s, bytes, sizeof(s));
+		snprintf(buf, EXPR_SIZE, "((lshort)%d)", (int)s);
+		break;
+	case lb_ushort:
+		memcpy(&s, bytes, sizeof(s));
+		snprintf(buf, EXPR_SIZE, "((lushort)%u)", (unsigned int)(lushort)s);
+		break;
+	case lb_int:
+		memcpy(&i, bytes, sizeof(i));
+		if (i == INT_MIN)
+			snprintf(buf, EXPR_SIZE, "((lint)(-2147483647 - 1))");
+		else
+			snprintf(buf, EXPR_SIZE, "((lint)%d)", i);
+		break;
+	case lb_uint:
+		memcpy(&i, bytes, sizeof(i));
+		snprintf(buf, EXPR_SIZE, "((luint)%uU)", (luint)i);
+		break;
+	case lb_long:
+		memcpy(&l, bytes, sizeof(l));
+		if (l == LLONG_MIN)
+			snprintf(buf, EXPR_SIZE, "((llong)(-9223372036854775807LL - 1))");
+		else
+			snprintf(buf, EXPR_SIZE, "((llong)%lldLL)", l);
+		break;
+	case lb_ulong:
+		memcpy(&l, bytes, sizeof(l));
+		snprintf(buf, EXPR_SIZE, "((lulong)%lluULL)", (lulong)l);
+		break;
+	case lb_float:
+		memcpy(&f, bytes, sizeof(f));
+		if (!isfinite(f))
+		{
+			clazz->realHelpers[0] = 1;
+			memcpy(&i, bytes, sizeof(i));
+			snprintf(buf, EXPR_SIZE, "aot_real4(0x%08XU)", (luint)i);
+			break;
+		}
+
+		// Nine significant digits are enough to read back the same float
+		snprintf(real, sizeof(real), "%.9g", (double)f);
+		if (!strpbrk(real, ".e"))
+			strcat(real, ".0");
+		snprintf(buf, EXPR_SIZE, signbit(f) ? "(%sf)" : "%sf", real);
+		break;
+	case lb_double:
+		memcpy(&d, bytes, sizeof(d));
+		if (!isfinite(d))
+		{
+			clazz->realHelpers[1] = 1;
+			memcpy(&l, bytes, sizeof(l));
+			snprintf(buf, EXPR_SIZE, "aot_real8(0x%016llXULL)", (lulong)l);
+			break;
+		}
+
+		snprintf(real, sizeof(real), "%.17g", d);
+		if (!strpbrk(real, ".e"))
+			strcat(real, ".0");
+		snprintf(buf, EXPR_SIZE, signbit(d) ? "(%s)" : "%s", real);
+		break;
+	default:
+		snprintf(buf, EXPR_SIZE, "0");
+		break;
+	}
+}
+
+const char *c_type(byte_t type)
+{
+	switch (type)
+	{
+	case lb_void:
+		return "void";
+	case lb_char:
+		return "lchar";
+	case lb_uchar:
+		return "luchar";
+	case lb_short:
+		return "lshort";
+	case lb_ushort:
+		return "lushort";
+	case lb_int:
+		return "lint";
+	case lb_uint:
+		return "luint";
+	case lb_long:
+		return "llong";
+	case lb_ulong:
+		return "lulong";
+	case lb_bool:
+		return "lbool";
+	case lb_float:
+		return "lfloat";
+	case lb_double:
+		return "ldouble";
+	default:
+		return "lobject";
+	}
+}
+
+const char *unsigned_c_type(byte_t type)
+{
+	return sizeof_type(type) > sizeof(luint) ? "lulong" : "luint";
+}
+
+char qualified_letter(byte_t type)
+{
+	switch (type)
+	{
+	case lb_char:
+		return 'C';
+	case lb_uchar:
+		return 'c';
+	case lb_short:
+		return 'S';
+	case lb_ushort:
+		return 's';
+	case lb_int:
+		return 'I';
+	case lb_uint:
+		return 'i';
+	case lb_long:
+		return 'Q';
+	case lb_ulong:
+		return 'q';
+	case lb_bool:
+		return 'B';
+	case lb_float:
+		return 'F';
+	case lb_double:
+		return 'D';
+	default:
+		return '?';
+	}
+}
+
+aot_function_t *find_function(aot_class_t *clazz, const char *qualifiedName)
+{
+	for (size_t i = 0; i < clazz->functionCount; i++)
+	{
+		if (clazz->functions[i].isStatic && !strcmp(clazz->functions[i].qualifiedName, qualifiedName))
+			return &clazz->functions[i];
+	}
+	return NULL;
+}
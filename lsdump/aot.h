@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdio.h>
+#include <internal/types.h>
+
+/*
+Translates the static functions of a class to C. Each function is exported under the name the VM
+looks up when started with -aot, so building the output into a library which the class loads
+runs the functions natively in place of their bytecode.
+
+Only functions working on primitive arguments and locals, and calling other translated functions
+of the same class, are translated. The rest are listed with the reason they were left to the
+interpreter.
+
+@param out The file to write the C source to.
+@param data The class.
+@param datalen The size of the class, in bytes.
+
+@return A dump error code.
+*/
+int aot_translate(FILE *out, byte_t *data, long datalen);
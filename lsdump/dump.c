@@ -1,4 +1,5 @@
 #include "dump.h"
+#include "aot.h"
 
 #include <stdlib.h>
 #include <assert.h>
@@ -9,16 +10,20 @@
 #define printbyte(out, byte) fprintf(out, "[0x%02hhX]", byte)
 #define printbytespc(out, byte) fprintf(out, "[0x%02hhX] ", byte)
 
+#define OPERAND_BUFFER_SIZE 256
+
 typedef struct disasm_state_s
 {
 	FILE *out;
 	byte_t *cursor;
 	const char *lastfunc;
+	unsigned int version;
+	const char **pool;
+	size_t poolsize;
 } disasm_state_t;
 
 static int disasm(FILE *out, byte_t *data, long datalen);
 static int expsyb(FILE *out, byte_t *data, long datalen);
-static const char *type_name(byte_t lb);
 
 static int determine_arg_count(const char *funcname);
 
@@ -27,14 +32,26 @@ Handles a generic function call. state->cursor should point to the function sign
 */
 static void print_function_call_generic(disasm_state_t *state);
 
+/*
+Prints the arguments of a call to funcname. state->cursor should point to the first argument.
+*/
+static void print_call_arguments(disasm_state_t *state, const char *funcname);
+
 static void print_absolute_value(disasm_state_t *state);
 
+/*
+Formats a variable operand into buf, which is either a name or a slot index followed by a
+field path. state->cursor is advanced past the operand.
+*/
+static const char *read_operand(disasm_state_t *state, char *buf, size_t size);
+
 static void print_function(disasm_state_t *state);
 static void print_global(disasm_state_t *state);
 static void print_valdef(disasm_state_t *state);
 static void print_setcmd(disasm_state_t *state);
 static void print_retcmd(disasm_state_t *state);
 static void handle_ifstyle(disasm_state_t *state);
+static void print_switch(disasm_state_t *state);
 static void print_castcmd(disasm_state_t *state);
 
 int dump_file(dump_options_t *dumpOptions)
@@ -80,6 +97,12 @@ int dump_file(dump_options_t *dumpOptions)
 		if (err) goto finalize;
 	}
 
+	if (dumpOptions->translate)
+	{
+		err = aot_translate(out, data, datalen);
+		if (err) goto finalize;
+	}
+
 finalize:
 
 	if (in) fclose(in);
@@ -96,10 +119,13 @@ int disasm(FILE *out, byte_t *data, long datalen)
 	size_t off;
 	unsigned int version;
 	char compressed;
+	char operand[OPERAND_BUFFER_SIZE];
 
 	state.out = out;
 	state.cursor = data;
 	state.lastfunc = NULL;
+	state.pool = NULL;
+	state.poolsize = 0;
 
 	end = data + datalen;
 
@@ -108,12 +134,27 @@ int disasm(FILE *out, byte_t *data, long datalen)
 	state.cursor++;
 
 	// version
-	version = *state.cursor;
+	version = *((unsigned int *)state.cursor);
 	state.cursor += sizeof(unsigned int);
+	state.version = version;
 
 	fprintf(out, "Bytecode version: %u\n", version);
 	fprintf(out, "Compressed: %s\n", compressed ? "true" : "false");
-	fprintf(out, "Size: %ld B\n\n", datalen);
+	fprintf(out, "Size: %ld B\n", datalen);
+
+	if (version >= LB_VERSION_POOL)
+	{
+		if (!read_pool(data, &end, &state.pool, &state.poolsize))
+		{
+			fprintf(out, "Bad constant pool\n");
+			return dump_no_error;
+		}
+
+		fprintf(out, "Constant pool: %zu entries\n", state.poolsize);
+		for (size_t i = 0; i < state.poolsize; i++)
+			fprintf(out, "  #%zu = %s\n", i, state.pool[i]);
+	}
+	fprintf(out, "\n");
 
 	while (state.cursor < end)
 	{
@@ -204,6 +245,8 @@ int disasm(FILE *out, byte_t *data, long datalen)
 		case lb_dynamic_call:
 			fprintf(state.out, "dynamic_call ");
 			state.cursor++;
+			if (state.version >= LB_VERSION_SLOTS)
+				fprintf(state.out, "%s.", read_operand(&state, operand, sizeof(operand)));
 			print_function_call_generic(&state);
 			break;
 		case lb_add:
@@ -246,10 +289,8 @@ int disasm(FILE *out, byte_t *data, long datalen)
 			cmdname = "rsh";
 		handle_math_cmd:
 			state.cursor++;
-			fprintf(state.out, "%s %s ", cmdname, state.cursor); // cmd dest
-			state.cursor += strlen(state.cursor) + 1;
-			fprintf(state.out, "%s ", state.cursor); // src
-			state.cursor += strlen(state.cursor) + 1;
+			fprintf(state.out, "%s %s ", cmdname, read_operand(&state, operand, sizeof(operand))); // cmd dest
+			fprintf(state.out, "%s ", read_operand(&state, operand, sizeof(operand))); // src
 			print_absolute_value(&state);
 			break;
 		case lb_neg:
@@ -259,10 +300,8 @@ int disasm(FILE *out, byte_t *data, long datalen)
 			cmdname = "not";
 		handle_unary_math_cmd:
 			state.cursor++;
-			fprintf(state.out, "%s %s ", cmdname, state.cursor); // cmd dest
-			state.cursor += strlen(state.cursor) + 1;
-			fprintf(state.out, "%s ", state.cursor); // src
-			state.cursor += strlen(state.cursor) + 1;
+			fprintf(state.out, "%s %s ", cmdname, read_operand(&state, operand, sizeof(operand))); // cmd dest
+			fprintf(state.out, "%s ", read_operand(&state, operand, sizeof(operand))); // src
 			break;
 		case lb_elif:
 			state.cursor++;
@@ -278,6 +317,19 @@ int disasm(FILE *out, byte_t *data, long datalen)
 		handle_if_style_cmd:
 			handle_ifstyle(&state);
 			break;
+		case lb_switch:
+			print_switch(&state);
+			state.lastfunc = NULL;
+			break;
+		case lb_case:
+			state.cursor++;
+			fprintf(state.out, "case %lld (0x%016llX)", *((llong *)(state.cursor + sizeof(qword_t))), *((qword_t *)state.cursor));
+			state.cursor += sizeof(qword_t) + sizeof(llong);
+			state.lastfunc = NULL;
+			break;
+		case lb_default:
+			cmdname = "default";
+			goto handle_end_style_cmd;
 		case lb_else:
 			cmdname = "else";
 			goto handle_end_style_cmd;
@@ -315,6 +367,8 @@ int disasm(FILE *out, byte_t *data, long datalen)
 		fprintf(out, "\n");
 	}
 
+	free((void *)state.pool);
+
 	return dump_no_error;
 }
 
@@ -394,6 +448,50 @@ const char *type_name(byte_t lb)
 	}
 }
 
+int read_pool(byte_t *data, byte_t **end, const char ***pool, size_t *poolsize)
+{
+	byte_t *cursor;
+	byte_t *poolEnd;
+	byte_t *nul;
+	dword_t poolOffset;
+	dword_t count;
+
+	if ((size_t)(*end - data) < 5 + 2 * sizeof(dword_t))
+		return 0;
+
+	poolEnd = *end - sizeof(dword_t);
+	poolOffset = *((dword_t *)poolEnd);
+	if (poolOffset < 5 || poolOffset + sizeof(dword_t) > (size_t)(poolEnd - data))
+		return 0;
+
+	cursor = data + poolOffset;
+	count = *((dword_t *)cursor);
+	cursor += sizeof(dword_t);
+	if (count > (size_t)(poolEnd - cursor))
+		return 0;
+
+	*pool = (const char **)malloc((count + 1) * sizeof(const char *));
+	if (!*pool)
+		return 0;
+
+	for (dword_t i = 0; i < count; i++)
+	{
+		nul = (byte_t *)memchr(cursor, 0, poolEnd - cursor);
+		if (!nul)
+		{
+			free((void *)*pool);
+			*pool = NULL;
+			return 0;
+		}
+		(*pool)[i] = (const char *)cursor;
+		cursor = nul + 1;
+	}
+	*poolsize = count;
+
+	*end = data + poolOffset;
+	return 1;
+}
+
 int determine_arg_count(const char *funcname)
 {
 	const char *cursor = funcname;
@@ -418,15 +516,37 @@ int determine_arg_count(const char *funcname)
 void print_function_call_generic(disasm_state_t *state)
 {
 	const char *funcname;
-	int i, argc;
-	byte_t datatype;
 
-	funcname = state->cursor;
+	if (state->version >= LB_VERSION_POOL)
+	{
+		word_t index = *((word_t *)state->cursor);
+		state->cursor += sizeof(word_t);
+		if (index >= state->poolsize)
+		{
+			fprintf(state->out, "#%hu <bad pool index>", index);
+			return;
+		}
+		funcname = state->pool[index];
+		fprintf(state->out, "#%hu ", index);
+	}
+	else
+	{
+		funcname = state->cursor;
+		state->cursor += strlen(funcname) + 1;
+	}
 
 	fprintf(state->out, "%s", funcname);
-	argc = determine_arg_count(state->cursor);
+	print_call_arguments(state, funcname);
+}
+
+void print_call_arguments(disasm_state_t *state, const char *funcname)
+{
+	int i, argc;
+	byte_t datatype;
+	char operand[OPERAND_BUFFER_SIZE];
+
+	argc = determine_arg_count(funcname);
 
-	state->cursor += strlen(state->cursor) + 1;
 	for (i = 0; i < argc; i++)
 	{
 		fputc(' ', state->out);
@@ -459,8 +579,7 @@ void print_function_call_generic(disasm_state_t *state)
 			state->cursor += sizeof(real8_t);
 			break;
 		case lb_value:
-			fprintf(state->out, "%s", state->cursor);
-			state->cursor += strlen(state->cursor) + 1;
+			fprintf(state->out, "%s", read_operand(state, operand, sizeof(operand)));
 			break;
 		case lb_string:
 			fprintf(state->out, "\"%s\"", state->cursor);
@@ -481,6 +600,8 @@ void print_function_call_generic(disasm_state_t *state)
 
 void print_absolute_value(disasm_state_t *state)
 {
+	char operand[OPERAND_BUFFER_SIZE];
+
 	byte_t argtype = *state->cursor;
 	state->cursor++;
 	switch (argtype)
@@ -530,8 +651,7 @@ void print_absolute_value(disasm_state_t *state)
 		state->cursor += sizeof(ldouble);
 		break;
 	case lb_value:
-		fprintf(state->out, "%s", state->cursor);
-		state->cursor += strlen(state->cursor) + 1;
+		fprintf(state->out, "%s", read_operand(state, operand, sizeof(operand)));
 		break;
 	}
 }
@@ -604,6 +724,32 @@ void print_function(disasm_state_t *state)
 	}
 
 	fprintf(state->out, ")");
+
+	if (state->version >= LB_VERSION_SLOTS)
+	{
+		argcount = *state->cursor;
+		state->cursor++;
+
+		fprintf(state->out, " locals(");
+		for (i = 0; i < argcount; i++)
+		{
+			dataTypeName = type_name(*state->cursor);
+			if (dataTypeName)
+				fprintf(state->out, "%s ", dataTypeName);
+			else
+				printbytespc(state->out, *state->cursor);
+			state->cursor++;
+
+			fprintf(state->out, "%s", state->cursor);
+			state->cursor += strlen(state->cursor) + 1;
+
+			if (i < argcount - 1)
+				fprintf(state->out, ", ");
+		}
+
+		fprintf(state->out, ") size(%u)", *((dword_t *)state->cursor));
+		state->cursor += sizeof(dword_t);
+	}
 }
 
 void print_global(disasm_state_t *state)
@@ -692,13 +838,13 @@ void print_global(disasm_state_t *state)
 void print_valdef(disasm_state_t *state)
 {
 	const char *typeName, *valName;
+	char operand[OPERAND_BUFFER_SIZE];
 
 	typeName = type_name(*state->cursor);
 	assert(typeName != NULL);
 	state->cursor++;
 
-	valName = state->cursor;
-	state->cursor += strlen(state->cursor) + 1;
+	valName = read_operand(state, operand, sizeof(operand));
 	
 	fprintf(state->out, "%s %s", typeName, valName);
 }
@@ -707,13 +853,13 @@ void print_setcmd(disasm_state_t *state)
 {
 	byte_t setcmd;
 	const char *destvar, *srcvar;
-	const char *arrtype;
+	const char *arrtype, *ctorname;
+	char destbuf[OPERAND_BUFFER_SIZE], srcbuf[OPERAND_BUFFER_SIZE];
 
 	setcmd = *state->cursor;
 
 	state->cursor++;
-	destvar = state->cursor;
-	state->cursor += strlen(state->cursor) + 1;
+	destvar = read_operand(state, destbuf, sizeof(destbuf));
 
 	switch (setcmd)
 	{
@@ -787,8 +933,7 @@ void print_setcmd(disasm_state_t *state)
 			{
 			case lb_value:
 				state->cursor++;
-				fprintf(state->out, "%s", state->cursor);
-				state->cursor += strlen(state->cursor) + 1;
+				fprintf(state->out, "%s", read_operand(state, srcbuf, sizeof(srcbuf)));
 				break;
 			case lb_dword:
 				state->cursor++;
@@ -806,7 +951,11 @@ void print_setcmd(disasm_state_t *state)
 			fprintf(state->out, "new %s ", state->cursor);
 			state->cursor += strlen(state->cursor) + 1;
 
-			print_function_call_generic(state);
+			// The constructor is always named inline, even in classes with a constant pool
+			ctorname = state->cursor;
+			fprintf(state->out, "%s", ctorname);
+			state->cursor += strlen(ctorname) + 1;
+			print_call_arguments(state, ctorname);
 			break;
 		case lb_string:
 			state->cursor++;
@@ -824,8 +973,7 @@ void print_setcmd(disasm_state_t *state)
 		}
 		break;
 	case lb_setv:
-		srcvar = state->cursor;
-		state->cursor += strlen(state->cursor) + 1;
+		srcvar = read_operand(state, srcbuf, sizeof(srcbuf));
 		fprintf(state->out, "setv %s %s", destvar, srcvar);
 		break;
 	case lb_setr:
@@ -837,6 +985,7 @@ void print_setcmd(disasm_state_t *state)
 void print_retcmd(disasm_state_t *state)
 {
 	byte_t retcmd;
+	char operand[OPERAND_BUFFER_SIZE];
 
 	retcmd = *state->cursor;
 	state->cursor++;
@@ -874,14 +1023,54 @@ void print_retcmd(disasm_state_t *state)
 		fprintf(state->out, "retr (%s))", state->lastfunc ? state->lastfunc : "???");
 		break;
 	case lb_retv:
-		fprintf(state->out, "retv %s", state->cursor);
-		state->cursor += strlen(state->cursor) + 1;
+		fprintf(state->out, "retv %s", read_operand(state, operand, sizeof(operand)));
 		break;
 	}
 
 	state->lastfunc = NULL;
 }
 
+void print_switch(disasm_state_t *state)
+{
+	char operand[OPERAND_BUFFER_SIZE];
+	byte_t tableType;
+	llong low = 0;
+	dword_t count;
+
+	state->cursor++;
+	fprintf(state->out, "switch %s ", read_operand(state, operand, sizeof(operand)));
+
+	tableType = *state->cursor;
+	state->cursor++;
+	if (tableType == lb_dense)
+	{
+		low = *((llong *)state->cursor);
+		state->cursor += sizeof(llong);
+	}
+	else if (tableType != lb_sparse)
+	{
+		fprintf(state->out, "? ");
+		return;
+	}
+
+	count = *((dword_t *)state->cursor);
+	state->cursor += sizeof(dword_t);
+	fprintf(state->out, "%s[%u] default (0x%016llX)", tableType == lb_dense ? "dense" : "sparse", count, *((qword_t *)state->cursor));
+	state->cursor += sizeof(qword_t);
+
+	for (dword_t i = 0; i < count; i++)
+	{
+		if (tableType == lb_dense)
+			fprintf(state->out, "\n\t%lld (0x%016llX)", low + (llong)i, *((qword_t *)state->cursor));
+		else
+		{
+			fprintf(state->out, "\n\t%lld (0x%016llX)", *((llong *)state->cursor), *((qword_t *)(state->cursor + sizeof(llong))));
+			state->cursor += sizeof(llong);
+		}
+		state->cursor += sizeof(qword_t);
+	}
+}
+
 void handle_ifstyle(disasm_state_t *state)
 {
 	byte_t count;
@@ -946,6 +1135,7 @@ void handle_ifstyle(disasm_state_t *state)
 void print_castcmd(disasm_state_t *state)
 {
 	byte_t cmd;
+	char operand[OPERAND_BUFFER_SIZE];
 
 	cmd = *state->cursor;
 	state->cursor++;
@@ -990,8 +1180,46 @@ void print_castcmd(disasm_state_t *state)
 		return;
 	}
 
-	fprintf(state->out, "%s ", state->cursor); // cmd dest
-	state->cursor += strlen(state->cursor) + 1;
-	fprintf(state->out, "%s ", state->cursor); // src
+	fprintf(state->out, "%s ", read_operand(state, operand, sizeof(operand))); // cmd dest
+	fprintf(state->out, "%s ", read_operand(state, operand, sizeof(operand))); // src
+}
+
+const char *read_operand(disasm_state_t *state, char *buf, size_t size)
+{
+	char index[128];
+	size_t len;
+
+	if (*state->cursor == lb_element)
+	{
+		state->cursor++;
+		read_operand(state, buf, size);
+		if (*state->cursor == lb_index)
+		{
+			state->cursor++;
+			snprintf(index, sizeof(index), "%u", *((dword_t *)state->cursor));
+			state->cursor += sizeof(dword_t);
+		}
+		else
+			read_operand(state, index, sizeof(index));
+		len = strlen(buf);
+		snprintf(buf + len, size - len, "[%s]", index);
+		return buf;
+	}
+
+	if (*state->cursor == lb_slot)
+	{
+		state->cursor++;
+		snprintf(buf, size, "slot[%hu]%s", *((word_t *)state->cursor), state->cursor + sizeof(word_t));
+		state->cursor += sizeof(word_t);
+	}
+	else if (*state->cursor == lb_static_slot)
+	{
+		state->cursor++;
+		snprintf(buf, size, "static[%hu]%s", *((word_t *)state->cursor), state->cursor + sizeof(word_t));
+		state->cursor += sizeof(word_t);
+	}
+	else
+		snprintf(buf, size, "%s", state->cursor);
 	state->cursor += strlen(state->cursor) + 1;
+	return buf;
 }
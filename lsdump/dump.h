@@ -1,12 +1,14 @@
 #pragma once
 
 #include <stdio.h>
+#include <internal/types.h>
 
 typedef struct dump_options_s
 {
 	const char *infile;		// The input file
 	const char *outfile;	// The output file, NULL writes to stdout
 	int disasm, symb;		// Disasemble and/or write symbols
+	int translate;			// Translate the class's static functions to C
 } dump_options_t;
 
 enum
@@ -22,4 +24,26 @@ enum
 * 
 * @param dumpOptions The options specifying how to dump.
 */
-int dump_file(dump_options_t *dumpOptions);
\ No newline at end of file
+int dump_file(dump_options_t *dumpOptions);
+
+/*
+Gets the name of a type as it is written in source.
+
+@param lb The type.
+
+@return The name, or NULL if lb is not a type.
+*/
+const char *type_name(byte_t lb);
+
+/*
+Reads the constant pool at the end of a version 3+ class. end is moved back to the start of the
+pool, so the pool is not read as code.
+
+@param data The start of the class.
+@param end A pointer to the end of the class.
+@param pool Set to an allocated array of the pool's entries, which point into data.
+@param poolsize Set to the number of entries in the pool.
+
+@return Nonzero if the pool was read.
+*/
+int read_pool(byte_t *data, byte_t **end, const char ***pool, size_t *poolsize);
\ No newline at end of file
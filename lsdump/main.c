@@ -53,6 +53,10 @@ int main(int argc, char *argv[])
 		{
 			options.symb = 1;
 		}
+		else if (str_equals_ignore_case(argv[i], "-c"))
+		{
+			options.translate = 1;
+		}
 		else
 		{
 			printf("Unknown switch: %s\n", argv[i]);
@@ -67,9 +71,9 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
-	if (!options.disasm && !options.symb)
+	if (!options.disasm && !options.symb && !options.translate)
 	{
-		printf("Must specify to disassemble and/or display symbols\n");
+		printf("Must specify to disassemble, display symbols and/or translate\n");
 		display_help();
 		return 0;
 	}
@@ -104,6 +108,8 @@ void display_help()
 	printf("               information will be written to stdout.\n");
 	printf("-d             Specifies to disassemble the input file.\n");
 	printf("-s             Specifies to display all public symbols in the input file.\n");
+	printf("-c             Specifies to translate the static functions of the input file\n");
+	printf("               to C, to be built into a library run by the VM under -aot.\n");
 	printf("and [file] is the file to operate on.");
 }
 